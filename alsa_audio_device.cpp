@@ -1,11 +1,18 @@
 // SPDX-License-Identifier: MIT
 
 #include "alsa_audio_device.h"
+#include "audio_sink.h"
 #include "conditions.h"
+#include <algorithm>
+#include <cerrno>
 #include <cstdint>
+#include <cstring>
+#include <poll.h>
 
 namespace plac {
 
+static_assert(AudioSink<AlsaAudioDevice>);
+
 namespace {
 
 void show_available_sample_formats(snd_pcm_t *handle_, snd_pcm_hw_params_t *params)
@@ -33,30 +40,95 @@ struct Logger {
   snd_output_t *log;
 };
 
-void Sleep(timespec &t) {
-    t.tv_sec += 1;
-    ::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, nullptr);
+// checks p against the configuration space of the device and logs the supported range on failure
+bool IsSupported(snd_pcm_t *handle_, snd_pcm_hw_params_t *params, const AlsaAudioDevice::Params &p) {
+    bool supported{true};
+    snd_pcm_uframes_t min{};
+    snd_pcm_uframes_t max{};
+    if (snd_pcm_hw_params_test_buffer_size(handle_, params, p.buffer_size) != 0) {
+        snd_pcm_hw_params_get_buffer_size_min(params, &min);
+        snd_pcm_hw_params_get_buffer_size_max(params, &max);
+        LOG_ERROR("buffer size {} not in [{}, {}]", p.buffer_size, min, max);
+        supported = false;
+    }
+    if (snd_pcm_hw_params_test_period_size(handle_, params, p.period_size, 0) != 0) {
+        snd_pcm_hw_params_get_period_size_min(params, &min, nullptr);
+        snd_pcm_hw_params_get_period_size_max(params, &max, nullptr);
+        LOG_ERROR("period size {} not in [{}, {}]", p.period_size, min, max);
+        supported = false;
+    }
+    if (snd_pcm_hw_params_test_periods(handle_, params, p.periods, 0) != 0) {
+        unsigned int min_periods{};
+        unsigned int max_periods{};
+        snd_pcm_hw_params_get_periods_min(params, &min_periods, nullptr);
+        snd_pcm_hw_params_get_periods_max(params, &max_periods, nullptr);
+        LOG_ERROR("periods {} not in [{}, {}]", p.periods, min_periods, max_periods);
+        supported = false;
+    }
+    return supported;
 }
 
-void CopyAudio16Bit(const int *const left, const int *const right,
-                    snd_pcm_uframes_t frames, uint8_t *data) {
-    for (int i{0}; i < frames; ++i) {
-        std::uint32_t interleaved{static_cast<std::uint32_t>(right[i])};
-        interleaved <<= 16;
-        interleaved |= static_cast<std::uint32_t>(left[i]) & 0xFFFF;
-        __builtin_memcpy(data, &interleaved, 4);
-        data += 4;
+// implements
+// https://github.com/alsa-project/alsa-lib/blob/5f524e300409f0a7b54c5fe9ee194bad1fc39516/test/pcm.c#L401
+// blocks until avail_min frames are free, i.e. until the next period boundary
+int WaitForPoll(snd_pcm_t *handle_, std::vector<pollfd> &fds) {
+    while (true) {
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        unsigned short revents{};
+        const int r{snd_pcm_poll_descriptors_revents(handle_, fds.data(), fds.size(), &revents)};
+        if (r < 0) {
+            return r;
+        }
+        if ((revents & POLLERR) != 0) {
+            switch (snd_pcm_state(handle_)) {
+            case SND_PCM_STATE_XRUN:
+                return -EPIPE;
+            case SND_PCM_STATE_SUSPENDED:
+                return -ESTRPIPE;
+            default:
+                return -EIO;
+            }
+        }
+        if ((revents & POLLOUT) != 0) {
+            return 0;
+        }
     }
 }
 
-void CopyAudio24Bit(const int *const left, const int *const right,
-                    snd_pcm_uframes_t frames, uint8_t *data) {
-    for (int i{0}; i < frames; ++i) {
-        std::uint64_t interleaved{static_cast<std::uint32_t>(right[i])};
-        interleaved <<= 24;
-        interleaved |= static_cast<std::uint64_t>(left[i]) & 0xFFFFFF;
-        __builtin_memcpy(data, &interleaved, 6);
-        data += 6;
+int64_t AsNanoseconds(const timespec &t) {
+    return static_cast<int64_t>(t.tv_sec) * 1'000'000'000 + t.tv_nsec;
+}
+
+// avail frames were free when poll() returned
+void RecordWakeup(const AlsaAudioDevice &dev, const snd_pcm_uframes_t avail) {
+    const AlsaAudioDevice::Params &p{dev.params_};
+    const snd_pcm_uframes_t queued{p.buffer_size - std::min(avail, p.buffer_size)};
+    dev.metrics_->fill_percent_.Add(queued * 100 / p.buffer_size);
+
+    // poll() is due once avail_min frames are free, i.e. when all but
+    // buffer_size - avail_min of the committed frames have been played since timer_
+    const int64_t played{static_cast<int64_t>(dev.committed_)
+                         - static_cast<int64_t>(p.buffer_size - p.avail_min)};
+    const int64_t due{AsNanoseconds(dev.timer_) + played * 1'000'000'000 / dev.format_.rate};
+    timespec now{};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t late{AsNanoseconds(now) - due};
+    dev.metrics_->lateness_us_.Add((late > 0) ? static_cast<uint64_t>(late / 1'000) : 0);
+}
+
+void Start(AlsaAudioDevice &dev) {
+    const int r{snd_pcm_start(dev.handle_)};
+    ENSURES(r == 0, "cannot start stream: {}", snd_strerror(r));
+    ::clock_gettime(CLOCK_MONOTONIC, &dev.timer_);
+    if (dev.metrics_ != nullptr) {
+        const int64_t latency{AsNanoseconds(dev.timer_) - AsNanoseconds(dev.prepared_)};
+        dev.metrics_->start_latency_us_.Add(static_cast<uint64_t>(std::max<int64_t>(latency, 0))
+                                            / 1'000);
     }
 }
 
@@ -64,28 +136,46 @@ void CopyAudio24Bit(const int *const left, const int *const right,
 // https://github.com/alsa-project/alsa-lib/blob/5f524e300409f0a7b54c5fe9ee194bad1fc39516/test/pcm.c#L600
 // recovery is factored out to avoid repeating it in this function. instead
 // function retruns
-ssize_t Copy(snd_pcm_t *handle_, const AudioFormat format,
-             const int *const left, const int *const right, const size_t count,
-             timespec &timer) {
+template <typename Format>
+ssize_t Copy(AlsaAudioDevice &dev, const Format format, const u_char *const data,
+             const size_t count) {
+    snd_pcm_t *const handle_{dev.handle_};
+    const AlsaAudioDevice::Params &params{dev.params_};
+    timespec &timer{dev.timer_};
     const snd_pcm_sframes_t avail{snd_pcm_avail_update(handle_)};
     if (avail < 0) {
         return avail;
     }
 
-    if (static_cast<size_t>(avail) < count) {
-        if (timer.tv_sec == 0) {
-            const int r{snd_pcm_start(handle_)};
-            ENSURES(r == 0, "cannot start stream: {}", snd_strerror(r));
-            ::clock_gettime(CLOCK_MONOTONIC, &timer);
-            return 0L;
-        } else {
-            Sleep(timer);
-            const snd_pcm_sframes_t r{snd_pcm_avail(handle_)};
-            if (r < format.rate) {
-                LOG_ERROR("low hardware buffer {}\n", r);
+    // the stream starts once the buffer is full, or before at the start threshold
+    const bool full{static_cast<size_t>(avail) < count};
+    if (timer.tv_sec == 0) {
+        const snd_pcm_uframes_t free{std::min(static_cast<snd_pcm_uframes_t>(avail),
+                                              params.buffer_size)};
+        if (full || ((params.buffer_size - free) >= params.start_threshold)) {
+            Start(dev);
+            if (full) {
+                return 0L;
             }
-            return std::min(r, 0L);
         }
+    } else if (full) {
+        const int err{WaitForPoll(handle_, dev.fds_)};
+        if (err < 0) {
+            return err;
+        }
+        const snd_pcm_sframes_t r{snd_pcm_avail(handle_)};
+        if (r < 0) {
+            return r;
+        }
+        if (dev.metrics_ != nullptr) {
+            RecordWakeup(dev, static_cast<snd_pcm_uframes_t>(r));
+        }
+        // poll() returns once avail_min (one period) is free. anything beyond
+        // half a period more is a late wakeup which eats into the queued audio.
+        if (static_cast<snd_pcm_uframes_t>(r) > (params.period_size + params.period_size / 2)) {
+            LOG_ERROR("low hardware buffer {}", r);
+        }
+        return 0L;
     }
 
     const snd_pcm_channel_area_t *areas{nullptr};
@@ -98,27 +188,55 @@ ssize_t Copy(snd_pcm_t *handle_, const AudioFormat format,
 
     ENSURES(areas[0].first == 0, "");
     ENSURES(areas[0].step == format.bits * format.channels, "mismatch in step size");
-    uint8_t *data = static_cast<uint8_t *>(areas[0].addr) + AsBytes(format, offset);
-
-    if (format.bits == 16) {
-        CopyAudio16Bit(left, right, frames, data);
-    } else if (format.bits == 24) {
-        CopyAudio24Bit(left, right, frames, data);
+    uint8_t *dst = static_cast<uint8_t *>(areas[0].addr) + AsBytes(format, offset);
+    // frames are already interleaved and packed by AudioBuffer::Write
+    std::memcpy(dst, data, AsBytes(format, frames));
+
+    const snd_pcm_sframes_t committed{snd_pcm_mmap_commit(handle_, offset, frames)};
+    if (committed > 0) {
+        if ((dev.startup_ != nullptr) && (dev.committed_ == 0)) {
+            dev.startup_->Mark(StartupTrace::Phase::first_frame);
+        }
+        dev.committed_ += static_cast<uint64_t>(committed);
+        if (dev.metrics_ != nullptr) {
+            dev.metrics_->frames_.fetch_add(static_cast<uint64_t>(committed),
+                                            std::memory_order_relaxed);
+        }
     }
+    return committed;
+}
 
-    return snd_pcm_mmap_commit(handle_, offset, frames);
+// writes silence to the whole mmap area, so that the RT thread does not fault
+// on its pages when it fills the buffer. snd_pcm_mmap_begin() is deliberately
+// not followed by snd_pcm_mmap_commit(): nothing is queued for playback. the
+// access is MMAP_INTERLEAVED, so areas[0] holds all channels.
+void PrefaultArea(snd_pcm_t *handle_, const AudioFormat format, snd_pcm_uframes_t frames)
+{
+    const snd_pcm_channel_area_t *areas{nullptr};
+    snd_pcm_uframes_t offset{};
+    const int r{snd_pcm_mmap_begin(handle_, &areas, &offset, &frames)};
+    if (r != 0) {
+        LOG_ERROR("cannot prefault mmap area: {}", snd_strerror(r));
+        return;
+    }
+    std::memset(static_cast<uint8_t *>(areas[0].addr) + AsBytes(format, offset), 0,
+                AsBytes(format, frames));
 }
 
 } // namespace
 
-AlsaAudioDevice::AlsaAudioDevice(const Output out)
-    : handle_{nullptr}, format_{}, params_{}, timer_{} {
+AlsaAudioDevice::AlsaAudioDevice(const Output out, AudioBuffer<65536> &audio_buffer,
+                                 FlowControl &flow)
+    : handle_{nullptr}, format_{}, params_{}, prepared_{}, timer_{}, committed_{0}, fds_{},
+      audio_buffer_{audio_buffer},
+      flow_{flow} {
     int open_mode = 0;
     open_mode |= SND_PCM_NO_AUTO_RESAMPLE;
     // open_mode |= SND_PCM_NO_AUTO_CHANNELS;
     // open_mode |= SND_PCM_NO_AUTO_FORMAT;
     open_mode |= SND_PCM_NO_SOFTVOL;
-    // open_mode |= SND_PCM_NONBLOCK;
+    // waiting is done with poll() in Copy()
+    open_mode |= SND_PCM_NONBLOCK;
 
     const char *name{};
     switch (out) {
@@ -138,7 +256,47 @@ AlsaAudioDevice::AlsaAudioDevice(const Output out)
 
 AlsaAudioDevice::~AlsaAudioDevice() noexcept { snd_pcm_close(handle_); }
 
-void AlsaAudioDevice::Init(const AudioFormat f, const LogLevel log_level) {
+AlsaAudioDevice::Params AlsaAudioDevice::MakeParams(const Profile profile, const unsigned int rate,
+                                                    const Start start) {
+  unsigned int buffer_time_us{};
+  unsigned int periods{};
+  switch (profile) {
+  case Profile::power_save:
+    buffer_time_us = 2'000'000;
+    periods = 2;
+    break;
+  case Profile::ms100:
+    buffer_time_us = 100'000;
+    periods = 4;
+    break;
+  case Profile::ms20:
+    buffer_time_us = 20'000;
+    periods = 4;
+    break;
+  case Profile::ms5:
+    buffer_time_us = 5'000;
+    periods = 2;
+    break;
+  default:
+    ENSURES(false, "unknown profile");
+    break;
+  }
+
+  Params p{};
+  p.periods = periods;
+  p.period_size = static_cast<snd_pcm_uframes_t>(rate) * buffer_time_us / 1'000'000 / periods;
+  p.buffer_size = p.period_size * periods;
+  p.avail_min = p.period_size;
+  p.start_threshold = p.buffer_size;
+  if (start == Start::fast) {
+    const snd_pcm_uframes_t limit{static_cast<snd_pcm_uframes_t>(rate) * kFastStartUs / 1'000'000};
+    p.start_threshold = std::min(p.period_size, limit);
+  }
+  return p;
+}
+
+void AlsaAudioDevice::Init(const AudioFormat f, const LogLevel log_level, const Profile profile,
+                           const Start start) {
   AudioFormat info = f;
   Logger log;
 
@@ -183,16 +341,17 @@ void AlsaAudioDevice::Init(const AudioFormat f, const LogLevel log_level) {
   ENSURES(err >= 0, "cannot set rate near");
   ENSURES(rate == info.rate, "rate modified");
 
-  Params p{};
-  p.buffer_size = f.rate * 2; // 2s buffer
-  const unsigned buffer_period_ratio{2};
-  p.period_size = p.buffer_size / buffer_period_ratio;
+  const Params p{MakeParams(profile, f.rate, start)};
+  if (!IsSupported(handle_, params, p)) {
+    LOG_ERROR("profile not supported by device");
+    exit(EXIT_FAILURE);
+  }
 
   err = snd_pcm_hw_params_set_buffer_size(handle_, params, p.buffer_size);
   ENSURES(err >= 0, "cannot set buffer size");
   err = snd_pcm_hw_params_set_period_size(handle_, params, p.period_size, 0);
   ENSURES(err >= 0, "cannot set period size");
-  err = snd_pcm_hw_params_set_periods(handle_, params, buffer_period_ratio, 0);
+  err = snd_pcm_hw_params_set_periods(handle_, params, p.periods, 0);
   ENSURES(err >= 0, "cannot set buffer/period ratio");
 
   err = snd_pcm_hw_params(handle_, params);
@@ -207,13 +366,13 @@ void AlsaAudioDevice::Init(const AudioFormat f, const LogLevel log_level) {
   err = snd_pcm_sw_params_current(handle_, swparams);
   ENSURES(err >= 0, "unable to get current sw params");
 
-  err = snd_pcm_sw_params_set_avail_min(handle_, swparams, p.period_size);
+  err = snd_pcm_sw_params_set_avail_min(handle_, swparams, p.avail_min);
   ENSURES(err >= 0, "cannot set avail min");
   // not needed. api for read/write but not mmap
   err = snd_pcm_sw_params_set_stop_threshold(handle_, swparams, p.buffer_size);
   ENSURES(err >= 0, "cannot set stop threshold");
   // not needed. api for read/write but not mmap
-  err = snd_pcm_sw_params_set_start_threshold(handle_, swparams, p.buffer_size);
+  err = snd_pcm_sw_params_set_start_threshold(handle_, swparams, p.start_threshold);
   ENSURES(err >= 0, "cannot set start threshold");
   err = snd_pcm_sw_params_set_tstamp_mode(handle_, swparams, SND_PCM_TSTAMP_NONE);
   ENSURES(err >= 0, "cannot set tstamp mode");
@@ -237,26 +396,60 @@ void AlsaAudioDevice::Init(const AudioFormat f, const LogLevel log_level) {
   EXPECTS(info == f, "");
   EXPECTS(format_ == f, "");
 
+  if (metrics_ != nullptr) {
+    metrics_->rate_.store(format_.rate, std::memory_order_relaxed);
+  }
+
+  params_ = p;
   snd_pcm_hw_params_get_period_size(params, &params_.period_size, nullptr);
   EXPECTS(p.period_size == params_.period_size, "");
   snd_pcm_hw_params_get_buffer_size(params, &params_.buffer_size);
   EXPECTS(p.buffer_size == params_.buffer_size, "");
+  snd_pcm_hw_params_get_periods(params, &params_.periods, nullptr);
+  EXPECTS(p.periods == params_.periods, "");
+
+  // an ioplug PCM may set up its descriptors only once the params are installed
+  const int count{snd_pcm_poll_descriptors_count(handle_)};
+  ENSURES(count > 0, "invalid poll descriptors count");
+  fds_.resize(static_cast<size_t>(count));
+  const int r{snd_pcm_poll_descriptors(handle_, fds_.data(), fds_.size())};
+  ENSURES(r >= 0, "unable to obtain poll descriptors: {}", snd_strerror(r));
+
+  PrefaultArea(handle_, format_, params_.buffer_size);
+  ::clock_gettime(CLOCK_MONOTONIC, &prepared_);
 }
 
-void AlsaAudioDevice::Play(const int *left, size_t length, const int *right, AudioFormat format)
+template <typename Format>
+ssize_t AlsaAudioDevice::Write(const Format format, const u_char *const data, const size_t count)
 {
-    while (length != 0) {
-        ssize_t n = Copy(handle_, format, left, right, length, timer_);
-        if (n < 0) {
-            n = snd_pcm_recover(handle_, n, 0);
-            ENSURES(n == 0, "write error: {}", snd_strerror(n));
-            timer_ = {};
+    ssize_t n = Copy(*this, format, data, count);
+    if (n < 0) {
+        if (metrics_ != nullptr) {
+            metrics_->recovers_.fetch_add(1, std::memory_order_relaxed);
+            if (n == -EPIPE) {
+                metrics_->xruns_.fetch_add(1, std::memory_order_relaxed);
+            }
         }
-
-        length -= n;
-        left += n;
-        right += n;
+        n = snd_pcm_recover(handle_, n, 0);
+        ENSURES(n == 0, "write error: {}", snd_strerror(n));
+        ::clock_gettime(CLOCK_MONOTONIC, &prepared_);
+        timer_ = {};
+        committed_ = 0;
     }
+    return n;
+}
+
+template ssize_t AlsaAudioDevice::Write(AudioFormat, const u_char *, size_t);
+template ssize_t AlsaAudioDevice::Write(FixedFormat<16, 2>, const u_char *, size_t);
+template ssize_t AlsaAudioDevice::Write(FixedFormat<24, 2>, const u_char *, size_t);
+
+void AlsaAudioDevice::Playback()
+{
+    // the loop and Copy() are specialized for the format of the stream
+    const bool supported{WithFixedFormat(format_, [this](const auto format) {
+        ::plac::Playback(*this, audio_buffer_, flow_, format, params_.period_size);
+    })};
+    ENSURES(supported, "unsupported format");
 }
 
 void AlsaAudioDevice::Drain() {
@@ -3,8 +3,15 @@
 #ifndef ALSA_AUDIO_DEVICE_H
 #define ALSA_AUDIO_DEVICE_H
 
+#include "audio_buffer.h"
 #include "audio_format.h"
+#include "flow_control.h"
+#include "metrics.h"
+#include "startup_trace.h"
 #include <alsa/asoundlib.h>
+#include <cstdint>
+#include <poll.h>
+#include <vector>
 
 namespace plac {
 
@@ -34,27 +41,64 @@ struct AlsaAudioDevice {
     snd_pcm_uframes_t period_size;
     // buffer size in # frames
     snd_pcm_uframes_t buffer_size;
+    // buffer_size / period_size
+    unsigned int periods;
+    // poll() wakes up once this many frames are free
+    snd_pcm_uframes_t avail_min;
+    // # frames queued before the stream is started
+    snd_pcm_uframes_t start_threshold;
   };
 
+  // buffer size and number of periods
+  //  - power_save: 2s, 2 periods of 1s
+  //  - ms100: 100ms, 4 periods of 25ms
+  //  - ms20: 20ms, 4 periods of 5ms
+  //  - ms5: 5ms, 2 periods of 2.5ms
+  enum class Profile { power_save, ms100, ms20, ms5 };
+  // full_buffer starts the stream once the hardware buffer is full. fast starts
+  // it once one period, at most kFastStartUs, is queued and the rest of the
+  // buffer is filled while playing.
+  enum class Start { full_buffer, fast };
+  static constexpr unsigned int kFastStartUs{50'000};
   enum class LogLevel { verbose, non_verbose };
   enum class Output { file, uln2 };
 
-  AlsaAudioDevice(const Output out);
+  AlsaAudioDevice(const Output out, AudioBuffer<65536> &audio_buffer, FlowControl &flow);
   AlsaAudioDevice(const AlsaAudioDevice &) = delete;
   AlsaAudioDevice(AlsaAudioDevice &&) = delete;
   AlsaAudioDevice &operator=(const AlsaAudioDevice &) = delete;
   AlsaAudioDevice &operator=(AlsaAudioDevice &&) = delete;
   ~AlsaAudioDevice() noexcept;
 
-  void Init(const AudioFormat format, const LogLevel log_level);
-  void Play(const int *left, size_t length, const int *right, AudioFormat format);
+  static Params MakeParams(const Profile profile, const unsigned int rate,
+                           const Start start = Start::full_buffer);
+
+  void Init(const AudioFormat format, const LogLevel log_level,
+            const Profile profile = Profile::power_save, const Start start = Start::full_buffer);
+  // Format is AudioFormat, FixedFormat<16, 2> or FixedFormat<24, 2>
+  template <typename Format> ssize_t Write(const Format format, const u_char *data, size_t count);
+  // consumes audio_buffer_ until the producer closes flow_. runs on the RT thread.
+  void Playback();
   void Drain();
 
   snd_pcm_t *handle_;
   AudioFormat format_;
   Params params_;
 
+  // stream prepared, by Init() or a recovery. start latency is measured from it
+  timespec prepared_;
+  // start of the stream
   timespec timer_;
+  // frames committed since the stream was prepared
+  uint64_t committed_;
+  // of the PCM, fetched by Init()
+  std::vector<pollfd> fds_;
+  AudioBuffer<65536> &audio_buffer_;
+  FlowControl &flow_;
+  // optional
+  PlaybackMetrics *metrics_{nullptr};
+  // optional. marks the first committed frame
+  StartupTrace *startup_{nullptr};
 };
 
 } // namespace plac
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: MIT
+
+#include "alsa_audio_device.h"
+#include <gtest/gtest.h>
+
+namespace plac {
+namespace {
+
+class ProfileTest : public ::testing::TestWithParam<AlsaAudioDevice::Profile> {};
+
+TEST_P(ProfileTest, Consistent) {
+  for (const unsigned int rate : {44100U, 48000U, 88200U, 96000U, 176400U, 192000U}) {
+    const AlsaAudioDevice::Params p{AlsaAudioDevice::MakeParams(GetParam(), rate)};
+
+    EXPECT_GT(p.period_size, 0) << rate;
+    EXPECT_EQ(p.buffer_size, p.period_size * p.periods) << rate;
+    EXPECT_EQ(p.avail_min, p.period_size) << rate;
+    EXPECT_LE(p.start_threshold, p.buffer_size) << rate;
+    EXPECT_GE(p.periods, 2) << rate;
+
+    const AlsaAudioDevice::Params fast{
+        AlsaAudioDevice::MakeParams(GetParam(), rate, AlsaAudioDevice::Start::fast)};
+    EXPECT_GT(fast.start_threshold, 0) << rate;
+    EXPECT_LE(fast.start_threshold, p.period_size) << rate;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(AllProfiles, ProfileTest,
+                         ::testing::Values(AlsaAudioDevice::Profile::power_save,
+                                           AlsaAudioDevice::Profile::ms100,
+                                           AlsaAudioDevice::Profile::ms20,
+                                           AlsaAudioDevice::Profile::ms5));
+
+TEST(AlsaParamsTest, PowerSave) {
+  const AlsaAudioDevice::Params p{
+      AlsaAudioDevice::MakeParams(AlsaAudioDevice::Profile::power_save, 44100)};
+  EXPECT_EQ(88200, p.buffer_size);
+  EXPECT_EQ(44100, p.period_size);
+  EXPECT_EQ(2, p.periods);
+  EXPECT_EQ(88200, p.start_threshold);
+}
+
+TEST(AlsaParamsTest, FastStart) {
+  // one period, at most 50ms
+  EXPECT_EQ(2205, AlsaAudioDevice::MakeParams(AlsaAudioDevice::Profile::power_save, 44100,
+                                              AlsaAudioDevice::Start::fast)
+                      .start_threshold);
+  EXPECT_EQ(1200, AlsaAudioDevice::MakeParams(AlsaAudioDevice::Profile::ms100, 48000,
+                                              AlsaAudioDevice::Start::fast)
+                      .start_threshold);
+  EXPECT_EQ(120, AlsaAudioDevice::MakeParams(AlsaAudioDevice::Profile::ms5, 48000,
+                                             AlsaAudioDevice::Start::fast)
+                     .start_threshold);
+}
+
+TEST(AlsaParamsTest, LowLatency) {
+  const AlsaAudioDevice::Params p{
+      AlsaAudioDevice::MakeParams(AlsaAudioDevice::Profile::ms20, 192000)};
+  EXPECT_EQ(3840, p.buffer_size);
+  EXPECT_EQ(960, p.period_size);
+  EXPECT_EQ(4, p.periods);
+}
+
+} // namespace
+} // namespace plac
@@ -3,83 +3,139 @@
 #ifndef AUDIO_BUFFER_H
 #define AUDIO_BUFFER_H
 
-#include "as_const.h"
 #include "audio_format.h"
 #include "conditions.h"
+#include "interleave.h"
+#include "ring_memory.h"
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
+#include <span>
 #include <sys/types.h>
+#include <utility>
 
 namespace plac {
 
+// Single-producer single-consumer ring of interleaved frames.
+//
+// N is the capacity in frames and a power of two, so the free running indices
+// wrap with a mask. Each index is stored by one side only. It shares a cache
+// line with that side's copy of the other index, which is refreshed only when
+// the copy suggests that the buffer is full (producer) or empty (consumer).
+// The stores release the frames, the loads of the other index acquire them.
+//
+// The storage is a RingMemory. Where it is mirrored, spans never split at the
+// end of the ring and a sink gets a whole period with one call.
+//
+// Format is AudioFormat, or FixedFormat for arithmetic folded at compile time.
+// The format must not change while frames are buffered.
 template <unsigned int N> class AudioBuffer {
 public:
-    float GetFillLevel() const { return static_cast<float>(size_) / static_cast<float>(N); }
-    bool IsEmpty() const { return size_ == 0; }
+    // 24 bits, 2 channels
+    static constexpr size_t kMaxFrameBytes{RingMemory::kMaxFrameBytes};
 
-    ssize_t Write(const AudioFormat format,
-                  const int *const left,
-                  const int *const right,
-                  const size_t count)
+    float GetFillLevel() const { return static_cast<float>(Size()) / static_cast<float>(N); }
+    bool IsEmpty() const { return Size() == 0; }
+    template<typename Format>
+    size_t GetFrames(const Format) const
     {
-        const size_t result{std::min(count, AsFrames(format, N - size_))};
-
-        if (format.bits == 16) {
-            for (int i{0}; i < result; ++i) {
-                std::uint32_t interleaved{static_cast<std::uint32_t>(right[i])};
-                interleaved <<= 16;
-                interleaved |= static_cast<std::uint32_t>(left[i]) & 0xFFFF;
-                __builtin_memcpy(&data_[in_], &interleaved, 4);
-
-                in_ += 4;
-                if (in_ == N) {
-                    in_ = 0;
-                }
-            }
-        } else if (format.bits == 24) {
-            for (int i{0}; i < result; ++i) {
-                std::uint64_t interleaved{static_cast<std::uint32_t>(right[i])};
-                interleaved <<= 24;
-                interleaved |= static_cast<std::uint64_t>(left[i]) & 0xFFFFFF;
-                __builtin_memcpy(&data_[in_], &interleaved, 6);
-
-                in_ += 6;
-                if (in_ == N) {
-                    in_ = 0;
-                }
-            }
+        return Size();
+    }
+
+    // producer: free frames, which may wrap around the end of the ring
+    template<typename Format>
+    size_t GetFreeFrames(const Format) const
+    {
+        return N - Size();
+    }
+
+    // producer: contiguous free space for at most count frames, empty if full
+    template<typename Format>
+    std::span<u_char> GetWriteSpan(const Format format, const size_t count)
+    {
+        const size_t in{producer_.index_.load(std::memory_order_relaxed)};
+        if (N - (in - producer_.other_) < count) {
+            producer_.other_ = consumer_.index_.load(std::memory_order_acquire);
         }
-        size_ += AsBytes(format, result);
+        const RingMemory::View view{memory_.Get(AsBytes(format, 1))};
+        const size_t frames{std::min({count, N - (in - producer_.other_), Contiguous(view, in)})};
+        return {&view.data_[AsBytes(format, in & kMask)], AsBytes(format, frames)};
+    }
 
-        return result;
+    // producer: publishes frames written to the span of GetWriteSpan()
+    void CommitWrite(const size_t frames)
+    {
+        producer_.index_.store(producer_.index_.load(std::memory_order_relaxed) + frames,
+                               std::memory_order_release);
     }
 
-    template<typename T>
-    ssize_t Read(const AudioFormat format, const size_t count, T &&pipe)
+    // consumer: contiguous buffered frames, at most count. empty if none
+    template<typename Format>
+    std::span<const u_char> GetReadSpan(const Format format, const size_t count)
     {
-        if (size_ < AsBytes(format, count)) {
-            return 0;
+        const size_t out{consumer_.index_.load(std::memory_order_relaxed)};
+        if ((consumer_.other_ - out) < count) {
+            consumer_.other_ = producer_.index_.load(std::memory_order_acquire);
         }
+        const RingMemory::View view{memory_.Get(AsBytes(format, 1))};
+        const size_t frames{std::min({count, consumer_.other_ - out, Contiguous(view, out)})};
+        return {&view.data_[AsBytes(format, out & kMask)], AsBytes(format, frames)};
+    }
+
+    // consumer: releases frames of the span of GetReadSpan()
+    void CommitRead(const size_t frames)
+    {
+        consumer_.index_.store(consumer_.index_.load(std::memory_order_relaxed) + frames,
+                               std::memory_order_release);
+    }
 
-        ssize_t result{0};
+    template<typename Format>
+    ssize_t Write(const Format format,
+                  const int *const left,
+                  const int *const right,
+                  const size_t count)
+    {
+        // the free space is contiguous, or wraps once if the ring is not mirrored
+        size_t done{0};
+        for (int part{0}; (part < 2) && (done < count); ++part) {
+            const std::span<u_char> span{GetWriteSpan(format, count - done)};
+            if (span.empty()) {
+                break;
+            }
+            const size_t frames{AsFrames(format, span.size())};
+            Interleave(format, &left[done], &right[done], frames, span.data());
+            CommitWrite(frames);
+            done += frames;
+        }
+        return static_cast<ssize_t>(done);
+    }
 
-        if ((out_ + AsBytes(format, count)) <= N) {
-            result = std::forward<T>(pipe)(format, &AsConst(*this).data_[out_], count);
-        } else {
-            const size_t rest{AsFrames(format, (out_ + AsBytes(format, count)) % N)};
-            result = std::forward<T>(pipe)(format, &AsConst(*this).data_[out_], (count - rest));
+    // calls pipe once with the contiguous part of count frames, i.e. all of them
+    // if the ring is mirrored. nothing is read if fewer than count frames are
+    // buffered.
+    template<typename Format, typename T>
+    ssize_t Read(const Format format, const size_t count, T &&pipe)
+    {
+        const size_t out{consumer_.index_.load(std::memory_order_relaxed)};
+        if ((consumer_.other_ - out) < count) {
+            consumer_.other_ = producer_.index_.load(std::memory_order_acquire);
+            if ((consumer_.other_ - out) < count) {
+                return 0;
+            }
         }
 
+        const std::span<const u_char> span{GetReadSpan(format, count)};
+        const ssize_t result
+            = std::forward<T>(pipe)(format, span.data(), AsFrames(format, span.size()));
         if (result >= 0) {
-            out_ = (out_ + AsBytes(format, result)) % N;
-            size_ -= AsBytes(format, result);
+            CommitRead(static_cast<size_t>(result));
         }
 
         return result;
     }
 
-  template <typename F> ssize_t Drain(const AudioFormat format, F &&Write) {
-    size_t count{AsFrames(format, size_)};
+  template <typename Format, typename F> ssize_t Drain(const Format format, F &&Write) {
+    size_t count{GetFrames(format)};
     while (count != 0) {
       const ssize_t n{Read(format, count, std::forward<F>(Write))};
       if (n < 0) {
@@ -91,13 +147,37 @@ public:
     return 0;
   }
 
+    // maps every page of the storage for all formats, so that neither side
+    // faults later. call before the producer and the consumer start
+    void Prefault() { memory_.Prefault(); }
+
 private:
-    static_assert((N % 4) == 0, "16bps with channels does not fit evenly into data_.");
-    static_assert((N % 6) == 0, "24bps with channels does not fit evenly into data_.");
-    unsigned char data_[N];
-    std::atomic<unsigned int> size_{0};
-    unsigned int in_{0};
-    unsigned int out_{0};
+    static_assert((N >= 2) && ((N & (N - 1)) == 0), "N must be a power of two.");
+    static constexpr size_t kMask{N - 1};
+    static constexpr size_t kCacheLine{64};
+
+    // the consumer index is loaded first. it never passes the producer index.
+    size_t Size() const
+    {
+        const size_t out{consumer_.index_.load(std::memory_order_acquire)};
+        return producer_.index_.load(std::memory_order_acquire) - out;
+    }
+
+    // frames from index up to the end of the ring, or N if it is mirrored
+    static size_t Contiguous(const RingMemory::View view, const size_t index)
+    {
+        return view.mirrored_ ? N : N - (index & kMask);
+    }
+
+    struct alignas(kCacheLine) Side {
+        std::atomic<size_t> index_{0};
+        // last seen index of the other side
+        size_t other_{0};
+    };
+
+    Side producer_;
+    Side consumer_;
+    RingMemory memory_{N};
 };
 
 } // namespace plac
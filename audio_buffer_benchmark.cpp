@@ -1,15 +1,22 @@
 // SPDX-License-Identifier: MIT
 
 #include "audio_buffer.h"
+#include "interleave.h"
+#include <atomic>
 #include <benchmark/benchmark.h>
+#include <memory>
+#include <thread>
 #include <vector>
 
 namespace {
 
+// holds the 57000 frames written per iteration
+constexpr unsigned int kFrames{65536};
+
 void Write16Bit(benchmark::State &state) {
   constexpr plac::AudioFormat format{16, 2, 96000};
   constexpr std::size_t size{57000};
-  plac::AudioBuffer<AsBytes(format, size)> b;
+  plac::AudioBuffer<kFrames> b;
   std::vector<int> left;
   std::vector<int> right;
   left.resize(size);
@@ -26,7 +33,7 @@ void Write16Bit(benchmark::State &state) {
 void Write24Bit(benchmark::State &state) {
   constexpr plac::AudioFormat format{24, 2, 96000};
   constexpr std::size_t size{57000};
-  plac::AudioBuffer<AsBytes(format, size)> b;
+  plac::AudioBuffer<kFrames> b;
   std::vector<int> left;
   std::vector<int> right;
   left.resize(size);
@@ -40,8 +47,153 @@ void Write24Bit(benchmark::State &state) {
   }
 }
 
+// Write and Drain with the frame size fixed at compile time, see plac::WithFixedFormat()
+template <unsigned int Bits> void WriteFixed(benchmark::State &state) {
+  constexpr plac::FixedFormat<Bits, 2> format{96000};
+  constexpr std::size_t size{57000};
+  plac::AudioBuffer<kFrames> b;
+  std::vector<int> left;
+  std::vector<int> right;
+  left.resize(size);
+  right.resize(size);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(b.Write(format, left.data(), right.data(), size));
+    benchmark::ClobberMemory();
+
+    b.Drain(format, [](plac::AudioFormat, const u_char *, const size_t count) { return count; });
+  }
+}
+
+// many short writes, where the frame arithmetic around the kernel dominates
+template <typename Format, unsigned int Bits> void WriteChunks(benchmark::State &state) {
+  constexpr std::size_t size{57000};
+  constexpr std::size_t chunk{32};
+  Format format = plac::FixedFormat<Bits, 2>{96000};
+  // a runtime format must not be constant propagated
+  benchmark::DoNotOptimize(format);
+  plac::AudioBuffer<kFrames> b;
+  std::vector<int> left;
+  std::vector<int> right;
+  left.resize(chunk);
+  right.resize(chunk);
+
+  for (auto _ : state) {
+    for (std::size_t i{0}; i < size / chunk; ++i) {
+      benchmark::DoNotOptimize(b.Write(format, left.data(), right.data(), chunk));
+    }
+    benchmark::ClobberMemory();
+
+    b.Drain(format, [](plac::AudioFormat, const u_char *, const size_t count) { return count; });
+  }
+  state.SetItemsProcessed(state.iterations() * (size / chunk) * chunk);
+}
+
+// frames per second through the buffer with the producer and the consumer on
+// their own threads, in chunks of state.range(0) frames
+void Throughput(benchmark::State &state) {
+  constexpr plac::FixedFormat<16, 2> format{96000};
+  const auto chunk{static_cast<std::size_t>(state.range(0))};
+  auto b{std::make_unique<plac::AudioBuffer<4096>>()};
+  std::atomic<bool> stop{false};
+  std::thread producer{[&b, &stop, chunk, format]() {
+    const std::vector<int> left(chunk);
+    const std::vector<int> right(chunk);
+    while (!stop.load(std::memory_order_relaxed)) {
+      if (b->Write(format, left.data(), right.data(), chunk) == 0) {
+        std::this_thread::yield();
+      }
+    }
+  }};
+
+  auto reader = [](auto, const u_char *data, const std::size_t count) {
+    benchmark::DoNotOptimize(data[0]);
+    return static_cast<ssize_t>(count);
+  };
+  std::size_t frames{0};
+  for (auto _ : state) {
+    // the contiguous part of a chunk may be shorter where the ring wraps
+    ssize_t n{0};
+    while ((n = b->Read(format, chunk, reader)) == 0) {
+      std::this_thread::yield();
+    }
+    frames += static_cast<std::size_t>(n);
+  }
+  stop.store(true, std::memory_order_relaxed);
+  producer.join();
+  state.SetItemsProcessed(static_cast<int64_t>(frames));
+}
+
+// round trip of a single frame through two buffers between two threads, i.e.
+// twice the latency from Write() until the frame is visible to Read()
+void Latency(benchmark::State &state) {
+  constexpr plac::FixedFormat<16, 2> format{96000};
+  auto ping{std::make_unique<plac::AudioBuffer<64>>()};
+  auto pong{std::make_unique<plac::AudioBuffer<64>>()};
+  std::atomic<bool> stop{false};
+  auto forward = [](auto, const u_char *, const std::size_t count) {
+    return static_cast<ssize_t>(count);
+  };
+  std::thread echo{[&ping, &pong, &stop, &forward, format]() {
+    const int sample{0};
+    while (!stop.load(std::memory_order_relaxed)) {
+      if (ping->Read(format, 1, forward) == 1) {
+        pong->Write(format, &sample, &sample, 1);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }};
+
+  const int sample{0};
+  for (auto _ : state) {
+    ping->Write(format, &sample, &sample, 1);
+    while (pong->Read(format, 1, forward) != 1) {
+      std::this_thread::yield();
+    }
+  }
+  stop.store(true, std::memory_order_relaxed);
+  echo.join();
+}
+
+template <plac::InterleaveFn plac::InterleaveKernels::*Kernel, unsigned int Bits>
+void Interleave(benchmark::State &state) {
+  constexpr plac::AudioFormat format{Bits, 2, 96000};
+  constexpr std::size_t size{4096};
+  const plac::InterleaveKernels &kernels{plac::GetAvailableInterleaveKernels()[state.range(0)]};
+  std::vector<int> left;
+  std::vector<int> right;
+  std::vector<u_char> data;
+  left.resize(size);
+  right.resize(size);
+  data.resize(AsBytes(format, size));
+
+  for (auto _ : state) {
+    (kernels.*Kernel)(left.data(), right.data(), size, data.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetLabel(kernels.name);
+  state.SetItemsProcessed(state.iterations() * size);
+}
+
+void AllKernels(benchmark::internal::Benchmark *b) {
+  for (size_t i{0}; i < plac::GetAvailableInterleaveKernels().size(); ++i) {
+    b->Arg(static_cast<int64_t>(i));
+  }
+}
+
 BENCHMARK(Write16Bit);
 BENCHMARK(Write24Bit);
+BENCHMARK(WriteFixed<16>);
+BENCHMARK(WriteFixed<24>);
+BENCHMARK(WriteChunks<plac::AudioFormat, 16>);
+BENCHMARK(WriteChunks<plac::FixedFormat<16, 2>, 16>);
+BENCHMARK(WriteChunks<plac::AudioFormat, 24>);
+BENCHMARK(WriteChunks<plac::FixedFormat<24, 2>, 24>);
+BENCHMARK(Throughput)->Arg(32)->Arg(480)->Arg(1024)->UseRealTime();
+BENCHMARK(Latency)->UseRealTime();
+BENCHMARK(Interleave<&plac::InterleaveKernels::s16, 16>)->Apply(AllKernels);
+BENCHMARK(Interleave<&plac::InterleaveKernels::s24, 24>)->Apply(AllKernels);
 
 } // namespace
 
@@ -5,7 +5,10 @@
 #include <array>
 #include <cstring>
 #include <gtest/gtest.h>
+#include <memory>
 #include <numeric>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace plac {
@@ -70,22 +73,28 @@ protected:
     ASSERT_FLOAT_EQ(last / static_cast<float>(NumberOfSamplesPerStride()), buffer_.GetFillLevel());
   }
 
-  // 16bps: 4 Bytes per sample, 192 Bytes have 48 samples, 5 write with 8
-  // samples per call/stride 24bps: 6 Bytes per sample, 192 Bytes have 32
-  // samples, 4 write with 8 samples per call/stride 32bps: 8 Bytes per sample,
-  // 192 Bytes have 24 samples, 3 write with 8 samples per call/stride
-  size_t NumberOfSamplesPerStride() const { return AsFrames(format_, 192) / 8; }
+  // the capacity is in frames: 32 frames are 4 writes with 8 frames per
+  // call/stride, whatever the sample size
+  size_t NumberOfSamplesPerStride() const { return kFrames / 8; }
+
+  static constexpr unsigned int kFrames{32};
 
   std::array<int, 16> left_;
   std::array<int, 16> right_;
-  AudioFormat format_{T(), 2, 44100};
+  std::remove_const_t<decltype(T::kFormat)> format_{T::kFormat};
   Reader reader_;
 
-  AudioBuffer<192> buffer_;
+  AudioBuffer<kFrames> buffer_;
+};
+
+template <unsigned int Bits> struct Runtime {
+  static constexpr AudioFormat kFormat{Bits, 2, 44100};
+};
+template <unsigned int Bits> struct Fixed {
+  static constexpr FixedFormat<Bits, 2> kFormat{44100};
 };
 
-using MyTypes
-    = ::testing::Types<std::integral_constant<unsigned, 16>, std::integral_constant<unsigned, 24>>;
+using MyTypes = ::testing::Types<Runtime<16>, Runtime<24>, Fixed<16>, Fixed<24>>;
 TYPED_TEST_SUITE(AudioBufferTest, MyTypes);
 
 TYPED_TEST(AudioBufferTest, Construct) {
@@ -186,6 +195,27 @@ TYPED_TEST(AudioBufferTest, ReadWhenWrapAroundWithRest) {
             (std::vector<int>{16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1}));
 }
 
+TYPED_TEST(AudioBufferTest, ReadWhenWrapAroundMirrored) {
+  // large enough for a page aligned ring, whose spans do not split at the end,
+  // unless pages are larger or memfd_create() is not available
+  if (!RingMemory{2048}.Get(AsBytes(this->format_, 1)).mirrored_) {
+    GTEST_SKIP() << "no mirrored ring";
+  }
+  auto buffer{std::make_unique<AudioBuffer<2048>>()};
+  for (int i{0}; i < 255; ++i) {
+    ASSERT_EQ(8, buffer->Write(this->format_, this->left_.cbegin(), this->right_.cbegin(), 8));
+  }
+  ASSERT_EQ(0, buffer->Drain(this->format_, this->reader_));
+  this->reader_.Flush();
+  EXPECT_EQ(16, buffer->Write(this->format_, this->left_.cbegin(), this->right_.cbegin(), 16));
+
+  EXPECT_EQ(16, buffer->Read(this->format_, 16, this->reader_));
+  EXPECT_EQ(this->reader_.left_,
+            (std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16}));
+  EXPECT_EQ(this->reader_.right_,
+            (std::vector<int>{16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1}));
+}
+
 TYPED_TEST(AudioBufferTest, ReadWhenError) {
   this->reader_.do_error_injection_ = true;
   this->FillBuffer();
@@ -212,8 +242,8 @@ TYPED_TEST(AudioBufferTest, DrainWhenFull) {
 
   EXPECT_EQ(0, this->buffer_.Drain(this->format_, this->reader_));
   EXPECT_TRUE(this->buffer_.IsEmpty());
-  EXPECT_EQ(AsFrames(this->format_, 192), this->reader_.left_.size());
-  EXPECT_EQ(AsFrames(this->format_, 192), this->reader_.right_.size());
+  EXPECT_EQ(this->kFrames, this->reader_.left_.size());
+  EXPECT_EQ(this->kFrames, this->reader_.right_.size());
 }
 
 TYPED_TEST(AudioBufferTest, DrainWhenError) {
@@ -225,5 +255,45 @@ TYPED_TEST(AudioBufferTest, DrainWhenError) {
   EXPECT_EQ(0, this->reader_.right_.size());
 }
 
+// a producer and a consumer thread hammer a small buffer, wrapping it many
+// times with odd write and read sizes. meant to be run with ThreadSanitizer too.
+TEST(AudioBufferConcurrencyTest, ProducerConsumer) {
+  constexpr AudioFormat kFormat{24, 2, 44100};
+  constexpr int kCount{200000};
+  auto buffer{std::make_unique<AudioBuffer<64>>()};
+
+  std::thread producer{[&buffer]() {
+    std::vector<int> left(kCount);
+    std::iota(left.begin(), left.end(), 0);
+    std::vector<int> right(kCount);
+    std::transform(left.cbegin(), left.cend(), right.begin(), std::negate<int>{});
+    size_t done{0};
+    size_t stride{1};
+    while (done < left.size()) {
+      const size_t count{std::min(stride, left.size() - done)};
+      done += static_cast<size_t>(buffer->Write(kFormat, &left[done], &right[done], count));
+      stride = (stride % 37) + 1;
+      std::this_thread::yield();
+    }
+  }};
+
+  Reader reader{};
+  size_t stride{1};
+  while (reader.left_.size() < kCount) {
+    const size_t count{std::min(stride, kCount - reader.left_.size())};
+    if (buffer->Read(kFormat, count, reader) == 0) {
+      std::this_thread::yield();
+    }
+    stride = (stride % 23) + 1;
+  }
+  producer.join();
+
+  EXPECT_TRUE(buffer->IsEmpty());
+  for (int i{0}; i < kCount; ++i) {
+    ASSERT_EQ(i, reader.left_[static_cast<size_t>(i)]);
+    ASSERT_EQ(-i, reader.right_[static_cast<size_t>(i)]);
+  }
+}
+
 } // namespace
 } // namespace plac
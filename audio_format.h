@@ -28,6 +28,45 @@ constexpr size_t AsFrames(AudioFormat format, size_t bytes) {
     return bytes * 8 / format.bits / format.channels;
 }
 
+// AudioFormat with bits and channels fixed at compile time. Code which is
+// generic over the format type folds the frame size into constants, e.g. the
+// division in AsFrames() becomes a multiplication. Converts to AudioFormat.
+template <unsigned int Bits, unsigned int Channels> struct FixedFormat {
+  static constexpr unsigned int bits{Bits};
+  static constexpr unsigned int channels{Channels};
+  unsigned int rate;
+
+  constexpr operator AudioFormat() const { return AudioFormat{Bits, Channels, rate}; }
+};
+
+template <unsigned int Bits, unsigned int Channels>
+constexpr size_t AsBytes(FixedFormat<Bits, Channels>, size_t frames) {
+    return frames * (Bits * Channels / 8);
+}
+template <unsigned int Bits, unsigned int Channels>
+constexpr size_t AsFrames(FixedFormat<Bits, Channels>, size_t bytes) {
+    return bytes / (Bits * Channels / 8);
+}
+
+// Calls f with the FixedFormat equal to format. Returns false without calling
+// f if the format is not supported by the pipeline. Meant to be called once per
+// track, so that everything below f is specialized for the format.
+template <typename F> bool WithFixedFormat(const AudioFormat format, F &&f) {
+    if (format.channels != 2) {
+        return false;
+    }
+    switch (format.bits) {
+    case 16:
+        f(FixedFormat<16, 2>{format.rate});
+        return true;
+    case 24:
+        f(FixedFormat<24, 2>{format.rate});
+        return true;
+    default:
+        return false;
+    }
+}
+
 } // namespace plac
 
 #endif
@@ -20,5 +20,30 @@ TEST(AudioFormatTest, AsFrames) {
     EXPECT_EQ(1, AsFrames(AudioFormat{24, 2, 1}, 6));
 }
 
+TEST(AudioFormatTest, FixedFormat) {
+    EXPECT_EQ((AudioFormat{24, 2, 44100}), (FixedFormat<24, 2>{44100}));
+    EXPECT_EQ(6, AsBytes(FixedFormat<24, 2>{1}, 1));
+    EXPECT_EQ(1, AsFrames(FixedFormat<24, 2>{1}, 6));
+    EXPECT_EQ(4, AsBytes(FixedFormat<16, 2>{1}, 1));
+    EXPECT_EQ(1, AsFrames(FixedFormat<16, 2>{1}, 4));
+}
+
+TEST(AudioFormatTest, WithFixedFormat) {
+    unsigned int bits{0};
+    unsigned int rate{0};
+    auto f = [&bits, &rate](const auto format) {
+        bits = format.bits;
+        rate = format.rate;
+    };
+    EXPECT_TRUE(WithFixedFormat(AudioFormat{16, 2, 44100}, f));
+    EXPECT_EQ(16, bits);
+    EXPECT_EQ(44100, rate);
+    EXPECT_TRUE(WithFixedFormat(AudioFormat{24, 2, 96000}, f));
+    EXPECT_EQ(24, bits);
+    EXPECT_EQ(96000, rate);
+    EXPECT_FALSE(WithFixedFormat(AudioFormat{32, 2, 96000}, f));
+    EXPECT_FALSE(WithFixedFormat(AudioFormat{16, 1, 96000}, f));
+}
+
 } // namespace
 } // namespace plac
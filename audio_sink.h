@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef AUDIO_SINK_H
+#define AUDIO_SINK_H
+
+#include "audio_buffer.h"
+#include "audio_format.h"
+#include "flow_control.h"
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <sys/types.h>
+
+namespace plac {
+
+// Consumer of interleaved frames, e.g. AlsaAudioDevice, RawFileSink or
+// FakeAudioDevice. Resolved at compile time so that the ALSA path has no
+// virtual calls.
+//
+// Write() consumes up to count frames and returns the number of frames
+// consumed, 0 to be called again, or a negative error. Drain() blocks until
+// all consumed frames have been played.
+template <typename T>
+concept AudioSink = requires(T &sink, const AudioFormat format, const u_char *data, size_t count) {
+  { sink.Write(format, data, count) } -> std::same_as<ssize_t>;
+  sink.Drain();
+};
+
+// Moves frames from audio_buffer to sink until the producer closes flow and
+// the buffer is empty, in chunks of at most period frames. Format is
+// AudioFormat or a FixedFormat, see WithFixedFormat().
+template <AudioSink Sink, unsigned int N, typename Format>
+void Playback(Sink &sink, AudioBuffer<N> &audio_buffer, FlowControl &flow, const Format format,
+              const size_t period) {
+  auto writer = [&sink](const Format f, const u_char *const data, const size_t count) {
+    return sink.Write(f, data, count);
+  };
+
+  while (true) {
+    // snapshot before looking at the buffer so that no notification is lost
+    const unsigned int sequence{flow.Sequence()};
+    const bool closed{flow.IsClosed()};
+
+    const size_t count{std::min(audio_buffer.GetFrames(format), period)};
+    if (count == 0) {
+      if (closed) {
+        break;
+      }
+      flow.Wait(sequence);
+      continue;
+    }
+
+    if (audio_buffer.Read(format, count, writer) > 0) {
+      flow.Notify();
+    }
+  }
+
+  sink.Drain();
+}
+
+} // namespace plac
+
+#endif
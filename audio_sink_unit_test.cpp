@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: MIT
+
+#include "audio_sink.h"
+#include "fake_audio_device.h"
+#include "raw_file_sink.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace plac {
+namespace {
+
+static_assert(AudioSink<FakeAudioDevice>);
+static_assert(AudioSink<RawFileSink>);
+
+constexpr AudioFormat kFormat{16, 2, 48000};
+
+// writes count frames with sample values 0, 1, 2, ... into b from a producer thread
+template <unsigned int N>
+std::thread Produce(AudioBuffer<N> &b, FlowControl &flow, const int count) {
+  return std::thread{[&b, &flow, count]() {
+    std::vector<int> samples(static_cast<size_t>(count));
+    for (int i{0}; i < count; ++i) {
+      samples[static_cast<size_t>(i)] = i;
+    }
+    size_t done{0};
+    while (done < samples.size()) {
+      const unsigned int sequence{flow.Sequence()};
+      const ssize_t n{b.Write(kFormat, &samples[done], &samples[done], samples.size() - done)};
+      if (n == 0) {
+        flow.Wait(sequence);
+        continue;
+      }
+      flow.Notify();
+      done += static_cast<size_t>(n);
+    }
+    flow.Close();
+  }};
+}
+
+TEST(AudioSinkTest, PlaybackToNullSink) {
+  FlowControl flow{};
+  auto b{std::make_unique<AudioBuffer<4096>>()};
+  FakeAudioDevice device{kFormat.rate, 480, 0.0};
+
+  std::thread producer{Produce(*b, flow, 100000)};
+  Playback(device, *b, flow, kFormat, 480);
+  producer.join();
+
+  EXPECT_EQ(100000U, device.frames_);
+  EXPECT_EQ(0U, device.xruns_);
+}
+
+TEST(AudioSinkTest, PlaybackToRawFile) {
+  constexpr const char *kName{"audio_sink_unit_test.raw"};
+  {
+    FlowControl flow{};
+    auto b{std::make_unique<AudioBuffer<4096>>()};
+    RawFileSink sink{kName};
+
+    std::thread producer{Produce(*b, flow, 10000)};
+    Playback(sink, *b, flow, kFormat, 480);
+    producer.join();
+  }
+
+  std::ifstream file{kName, std::ios::binary};
+  const std::vector<u_char> content{std::istreambuf_iterator<char>{file},
+                                    std::istreambuf_iterator<char>{}};
+  ASSERT_EQ(AsBytes(kFormat, 10000), content.size());
+  for (size_t i{0}; i < 10000; ++i) {
+    const u_char lo{static_cast<u_char>(i & 0xFFU)};
+    const u_char hi{static_cast<u_char>((i >> 8U) & 0xFFU)};
+    ASSERT_EQ(lo, content[4 * i]) << i;
+    ASSERT_EQ(hi, content[4 * i + 1]) << i;
+    ASSERT_EQ(lo, content[4 * i + 2]) << i;
+    ASSERT_EQ(hi, content[4 * i + 3]) << i;
+  }
+  std::remove(kName);
+}
+
+TEST(FakeAudioDeviceTest, PlaysInRealTime) {
+  // 4800 frames at 48kHz played in 100ms
+  FakeAudioDevice device{kFormat.rate, 480};
+  const std::vector<u_char> data(AsBytes(kFormat, 4800));
+
+  const auto begin{std::chrono::steady_clock::now()};
+  size_t done{0};
+  while (done < 4800) {
+    const ssize_t n{device.Write(kFormat, &data[AsBytes(kFormat, done)], 4800 - done)};
+    ASSERT_GE(n, 0);
+    done += static_cast<size_t>(n);
+  }
+  device.Drain();
+  const auto elapsed{std::chrono::steady_clock::now() - begin};
+
+  // sleeping never returns early, but may return late on a loaded machine
+  EXPECT_GE(elapsed, std::chrono::milliseconds{99});
+  EXPECT_EQ(4800U, device.frames_);
+  EXPECT_EQ(0U, device.xruns_);
+}
+
+TEST(FakeAudioDeviceTest, BufferFull) {
+  FakeAudioDevice device{kFormat.rate, 480};
+  const std::vector<u_char> data(AsBytes(kFormat, 960));
+  EXPECT_EQ(480, device.Write(kFormat, data.data(), 960));
+}
+
+TEST(FakeAudioDeviceTest, Underrun) {
+  FakeAudioDevice device{kFormat.rate, 480};
+  const std::vector<u_char> data(AsBytes(kFormat, 480));
+  EXPECT_EQ(480, device.Write(kFormat, data.data(), 480));
+  // the 10ms buffer runs empty
+  std::this_thread::sleep_for(std::chrono::milliseconds{20});
+  EXPECT_EQ(480, device.Write(kFormat, data.data(), 480));
+  EXPECT_EQ(1U, device.xruns_);
+}
+
+} // namespace
+} // namespace plac
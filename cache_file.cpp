@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: MIT
+
+#include "cache_file.h"
+#include "conditions.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace plac {
+
+bool WriteFileAtomically(const std::string &path,
+                         const std::initializer_list<std::span<const std::byte>> parts) {
+  const std::string tmp{path + ".tmp"};
+  FILE *f{std::fopen(tmp.c_str(), "wb")};
+  if (f == nullptr) {
+    LOG_ERROR("cannot open {}: {}", tmp, ::strerror(errno));
+    return false;
+  }
+  bool written{true};
+  for (const std::span<const std::byte> part : parts) {
+    // an empty part may have no data pointer at all
+    written = written
+              && (part.empty() || (std::fwrite(part.data(), 1, part.size(), f) == part.size()));
+  }
+  if ((std::fclose(f) != 0) || !written) {
+    LOG_ERROR("cannot write {}", tmp);
+    std::remove(tmp.c_str());
+    return false;
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    LOG_ERROR("cannot rename {}: {}", tmp, ::strerror(errno));
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+std::string CacheDir() {
+  if (const char *cache{std::getenv("XDG_CACHE_HOME")}; (cache != nullptr) && (*cache != '\0')) {
+    return std::string{cache} + "/plac";
+  }
+  if (const char *home{std::getenv("HOME")}; (home != nullptr) && (*home != '\0')) {
+    return std::string{home} + "/.cache/plac";
+  }
+  return {};
+}
+
+} // namespace plac
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef CACHE_FILE_H
+#define CACHE_FILE_H
+
+#include <cstddef>
+#include <initializer_list>
+#include <span>
+#include <string>
+
+namespace plac {
+
+// writes parts one after another to path.tmp which is then renamed to path,
+// so readers see the old or the new file but never a partial one. false on
+// failure, which is logged, and path is left as it was
+bool WriteFileAtomically(const std::string &path,
+                         std::initializer_list<std::span<const std::byte>> parts);
+
+// $XDG_CACHE_HOME/plac, or ~/.cache/plac. empty if neither is set
+std::string CacheDir();
+
+} // namespace plac
+
+#endif
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: MIT
+
+#include "cache_file.h"
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <optional>
+#include <string>
+
+namespace plac {
+namespace {
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream in{path, std::ios::binary};
+  return {std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+}
+
+TEST(CacheFileTest, WriteParts) {
+  constexpr const char *kPath{"cache_file_unit_test.bin"};
+  const std::string text{"abc"};
+  const std::array<char, 2> more{'d', '\0'};
+  ASSERT_TRUE(WriteFileAtomically(
+      kPath, {std::as_bytes(std::span{text}), {}, std::as_bytes(std::span{more})}));
+  EXPECT_EQ(std::string("abcd\0", 5), ReadFile(kPath));
+  EXPECT_FALSE(std::filesystem::exists(std::string{kPath} + ".tmp"));
+
+  // replaces the previous file as a whole
+  ASSERT_TRUE(WriteFileAtomically(kPath, {std::as_bytes(std::span{text})}));
+  EXPECT_EQ("abc", ReadFile(kPath));
+  std::remove(kPath);
+}
+
+TEST(CacheFileTest, MissingDirectory) {
+  const std::string text{"abc"};
+  EXPECT_FALSE(
+      WriteFileAtomically("cache_file_unit_test_missing/a", {std::as_bytes(std::span{text})}));
+}
+
+TEST(CacheFileTest, CacheDir) {
+  const char *const previous{std::getenv("XDG_CACHE_HOME")};
+  const std::optional<std::string> xdg{previous ? std::optional<std::string>{previous}
+                                                : std::nullopt};
+  const char *const home{std::getenv("HOME")};
+  ASSERT_EQ(0, ::setenv("XDG_CACHE_HOME", "/tmp/xdg", 1));
+  EXPECT_EQ("/tmp/xdg/plac", CacheDir());
+  ASSERT_EQ(0, ::setenv("XDG_CACHE_HOME", "", 1));
+  if (home != nullptr) {
+    EXPECT_EQ(std::string{home} + "/.cache/plac", CacheDir());
+  }
+  if (xdg) {
+    ::setenv("XDG_CACHE_HOME", xdg->c_str(), 1);
+  } else {
+    ::unsetenv("XDG_CACHE_HOME");
+  }
+}
+
+} // namespace
+} // namespace plac
@@ -3,6 +3,8 @@
 #ifndef CONDITIONS_H
 #define CONDITIONS_H
 
+#include "log.h"
+
 #include <cstdlib>
 #include <format>
 #include <iostream>
@@ -12,14 +14,26 @@ namespace plac {
 
 class Printer {
 public:
-    Printer(const std::string_view file, const int line, const std::string_view func)
+    Printer(const std::string_view file,
+            const int line,
+            const std::string_view func,
+            const Severity severity = Severity::error)
         : file_{file}
         , func_{func}
         , line_{line}
+        , severity_{severity}
     {}
 
+    // queues the message for the background log thread. safe on the real-time thread.
     template<typename... Ts>
     void operator()(const std::format_string<Ts...> s, Ts &&...v) const
+    {
+        AsyncLog::Instance().Push(severity_, file_, line_, func_, s.get(), v...);
+    }
+
+    // formats and writes the message from the calling thread
+    template<typename... Ts>
+    void Sync(const std::format_string<Ts...> s, Ts &&...v) const
     {
         std::cerr << std::format("flacplayer [{}:{} ({})] ", file_, line_, func_);
         std::cerr << std::format(s, std::forward<Ts>(v)...);
@@ -30,6 +44,7 @@ private:
   std::string_view file_;
   std::string_view func_;
   int line_;
+  Severity severity_;
 };
 
 class Conditions {
@@ -42,7 +57,9 @@ public:
     void operator()(const bool condition, const std::format_string<Ts...> s, Ts &&...v) const
     {
         if (!condition) {
-            p_(s, std::forward<Ts>(v)...);
+            // pending messages come first, and the last one must not get lost in the queue
+            AsyncLog::Instance().Flush();
+            p_.Sync(s, std::forward<Ts>(v)...);
             std::abort();
         }
   }
@@ -56,5 +73,6 @@ private:
 #define EXPECTS (::plac::Conditions{__FILE__, __LINE__, __func__})
 #define ENSURES (::plac::Conditions{__FILE__, __LINE__, __func__})
 #define LOG_ERROR (::plac::Printer{__FILE__, __LINE__, __func__})
+#define LOG_INFO (::plac::Printer{__FILE__, __LINE__, __func__, ::plac::Severity::info})
 
 #endif
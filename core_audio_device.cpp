@@ -236,7 +236,7 @@ AudioFormat SetStreamFormat(const AudioObjectID id, const AudioFormat format) {
 
 } // namespace
 
-CoreAudioDevice::CoreAudioDevice(AudioBuffer<228000> &audio_buffer, FlowControl &flow)
+CoreAudioDevice::CoreAudioDevice(AudioBuffer<65536> &audio_buffer, FlowControl &flow)
     : uln2_{}, proc_id_{}, format_{}, audio_buffer_{audio_buffer}, flow_{flow} {}
 
 CoreAudioDevice::~CoreAudioDevice() {
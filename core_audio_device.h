@@ -11,7 +11,7 @@
 namespace plac {
 
 struct CoreAudioDevice {
-  CoreAudioDevice(AudioBuffer<228000> &audio_buffer, FlowControl &flow);
+  CoreAudioDevice(AudioBuffer<65536> &audio_buffer, FlowControl &flow);
   CoreAudioDevice(CoreAudioDevice &) = delete;
   CoreAudioDevice(CoreAudioDevice &&) = delete;
   CoreAudioDevice &operator=(CoreAudioDevice &) = delete;
@@ -24,7 +24,7 @@ struct CoreAudioDevice {
   AudioObjectID uln2_;
   AudioDeviceIOProcID proc_id_;
   AudioFormat format_;
-  AudioBuffer<228000> &audio_buffer_;
+  AudioBuffer<65536> &audio_buffer_;
   FlowControl &flow_;
 };
 
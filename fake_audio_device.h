@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FAKE_AUDIO_DEVICE_H
+#define FAKE_AUDIO_DEVICE_H
+
+#include "audio_format.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <thread>
+
+namespace plac {
+
+// AudioSink which simulates a sound card. Its hardware buffer of buffer_size
+// frames starts playing once it is full and is then played at rate * speed
+// frames per second of the steady clock. Write() sleeps until space is free,
+// like poll() on a real device. The frames are discarded.
+//
+// speed 0 plays without delay, which makes the device a null sink.
+class FakeAudioDevice {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  FakeAudioDevice(const unsigned int rate, const size_t buffer_size, const double speed = 1.0)
+      : rate_{rate * speed}, buffer_size_{buffer_size} {}
+  FakeAudioDevice(const FakeAudioDevice &) = delete;
+  FakeAudioDevice(FakeAudioDevice &&) = delete;
+  FakeAudioDevice &operator=(const FakeAudioDevice &) = delete;
+  FakeAudioDevice &operator=(FakeAudioDevice &&) = delete;
+  ~FakeAudioDevice() noexcept = default;
+
+  ssize_t Write(const AudioFormat, const u_char *const, const size_t count) {
+    if (rate_ <= 0.0) {
+      frames_ += count;
+      return static_cast<ssize_t>(count);
+    }
+
+    if (started_) {
+      const uint64_t played{Played(Clock::now())};
+      if (played >= written_) {
+        // the buffer ran empty. restart like snd_pcm_recover() followed by a refill
+        ++xruns_;
+        started_ = false;
+        written_ = 0;
+      } else {
+        // wait until the frames to write fit or the buffer has room for no more
+        const size_t wanted{std::min(count, buffer_size_)};
+        if (buffer_size_ - (written_ - played) < wanted) {
+          std::this_thread::sleep_until(TimeOf(written_ + wanted - buffer_size_));
+        }
+      }
+    }
+
+    const uint64_t played{started_ ? Played(Clock::now()) : 0};
+    const size_t free{buffer_size_ - static_cast<size_t>(written_ - std::min(played, written_))};
+    const size_t n{std::min(count, free)};
+    written_ += n;
+    frames_ += n;
+    if (!started_ && (written_ >= buffer_size_)) {
+      Start();
+    }
+    return static_cast<ssize_t>(n);
+  }
+
+  // sleeps until every written frame has been played
+  void Drain() {
+    if (rate_ <= 0.0) {
+      return;
+    }
+    if (!started_ && (written_ != 0)) {
+      Start();
+    }
+    if (started_) {
+      std::this_thread::sleep_until(TimeOf(written_));
+    }
+    started_ = false;
+    written_ = 0;
+  }
+
+  // frames consumed and buffer underruns since construction
+  uint64_t frames_{0};
+  uint64_t xruns_{0};
+
+private:
+  void Start() {
+    started_ = true;
+    start_ = Clock::now();
+  }
+
+  // frames played until t since the start
+  uint64_t Played(const Clock::time_point t) const {
+    return static_cast<uint64_t>(std::chrono::duration<double>(t - start_).count() * rate_);
+  }
+
+  // time at which frames have been played since the start
+  Clock::time_point TimeOf(const uint64_t frames) const {
+    return start_
+           + std::chrono::duration_cast<Clock::duration>(
+               std::chrono::duration<double>(static_cast<double>(frames) / rate_));
+  }
+
+  const double rate_;
+  const size_t buffer_size_;
+  bool started_{false};
+  Clock::time_point start_{};
+  // frames written since the start
+  uint64_t written_{0};
+};
+
+} // namespace plac
+
+#endif
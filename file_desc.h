@@ -15,6 +15,7 @@ namespace plac {
 struct FileDesc {
   FileDesc() = default;
   FileDesc(const char *name) : fd_{open(name, O_RDONLY, 0)} {}
+  FileDesc(const char *name, const int flags, const mode_t mode) : fd_{open(name, flags, mode)} {}
   FileDesc(const FileDesc &) = delete;
   FileDesc(FileDesc &&other) noexcept : fd_{other.fd_} { other.fd_ = -1; }
   FileDesc &operator=(const FileDesc &) = delete;
@@ -16,6 +16,11 @@ TEST(FileDescTest, Constructor) {
   EXPECT_TRUE(f.IsValid());
 }
 
+TEST(FileDescTest, ConstructorWithFlags) {
+  FileDesc f{"/dev/null", O_WRONLY, 0};
+  EXPECT_TRUE(f.IsValid());
+}
+
 TEST(FileDescTest, MoveConstructor) {
   FileDesc f1{"/dev/null"};
   EXPECT_TRUE(f1.IsValid());
@@ -1,45 +1,89 @@
 // SPDX-License-Identifier: MIT
 
+#include "alsa_audio_device.h"
+#include "file_desc.h"
+#include "frame_decoder.h"
+#include "gapless.h"
+#include "mapped_file.h"
+#include "parallel_decoder.h"
+#include "playback_verifier.h"
 #include "stream.h"
+#include "verifier.h"
+#include <FLAC/stream_encoder.h>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace plac {
 namespace {
 
 class FlacDecodeTest : public ::testing::Test {
 protected:
-};
-
-TEST_F(FlacDecodeTest, Play16Bps) {
-    Stream stream{plac::AlsaAudioDevice::Output::file};
-
+  // decodes gapless and checks that the hand-over between tracks is negligible
+  // compared to the audio which is queued in audio_buffer_
+  void Play(const std::initializer_list<const char *> names) {
     bool first{true};
-    for (const char *name : {
-             "../assets/16bps_part0.flac",
-             "../assets/16bps_part1.flac",
-             "../assets/16bps_part2.flac",
-             "../assets/16bps_part3.flac",
-             "../assets/16bps_part4.flac",
-             "../assets/16bps_part5.flac",
-             "../assets/16bps_part6.flac",
-             "../assets/16bps_part7.flac",
-             "../assets/16bps_part8.flac",
-             "../assets/16bps_part9.flac",
-             "../assets/16bps_part10.flac",
-             "../assets/16bps_part11.flac",
-             "../assets/16bps_part12.flac",
-             "../assets/16bps_part13.flac",
-             "../assets/16bps_part14.flac",
-         }) {
-        ASSERT_TRUE(stream.Reset(name));
-        if (first) {
+    const GaplessStats stats{PlayGapless(
+        stream1_, stream2_, std::span<const char *const>{names.begin(), names.size()},
+        [this, &first](const Stream &stream) {
+          if (first) {
             first = false;
-            stream.device_.Init(stream.format_, ::plac::AlsaAudioDevice::LogLevel::verbose);
-        }
-        stream.Decode();
+            device_.Init(stream.format_, ::plac::AlsaAudioDevice::LogLevel::verbose);
+            output_ = std::thread{[this]() { device_.Playback(); }};
+          }
+          return true;
+        })};
+
+    EXPECT_EQ(names.size(), stats.tracks);
+    EXPECT_LT(stats.max_handover, std::chrono::milliseconds{10});
+  }
+
+  // closes the stream and waits until the output thread drained the device
+  void Stop() {
+    flow_.Close();
+    if (output_.joinable()) {
+      output_.join();
     }
-    stream.device_.Drain();
+  }
+
+  void TearDown() override { Stop(); }
+
+  FlowControl flow_{};
+  AudioBuffer<65536> audio_buffer_{};
+  Stream stream1_{audio_buffer_, flow_};
+  Stream stream2_{audio_buffer_, flow_};
+  AlsaAudioDevice device_{plac::AlsaAudioDevice::Output::file, audio_buffer_, flow_};
+  std::thread output_{};
+};
+
+TEST_F(FlacDecodeTest, Play16Bps) {
+    Play({
+        "../assets/16bps_part0.flac",
+        "../assets/16bps_part1.flac",
+        "../assets/16bps_part2.flac",
+        "../assets/16bps_part3.flac",
+        "../assets/16bps_part4.flac",
+        "../assets/16bps_part5.flac",
+        "../assets/16bps_part6.flac",
+        "../assets/16bps_part7.flac",
+        "../assets/16bps_part8.flac",
+        "../assets/16bps_part9.flac",
+        "../assets/16bps_part10.flac",
+        "../assets/16bps_part11.flac",
+        "../assets/16bps_part12.flac",
+        "../assets/16bps_part13.flac",
+        "../assets/16bps_part14.flac",
+    });
+    Stop();
 
     std::ifstream file("uln2-raw-S16_LE-44100-2.raw", std::ios::binary);
     ASSERT_TRUE(file.is_open());
@@ -61,34 +105,24 @@ TEST_F(FlacDecodeTest, Play16Bps) {
 }
 
 TEST_F(FlacDecodeTest, Play24Bps) {
-  Stream stream{plac::AlsaAudioDevice::Output::file};
-
-  bool first{true};
-  for (const char *name : {
-           "../assets/24bps_part0.flac",
-           "../assets/24bps_part1.flac",
-           "../assets/24bps_part2.flac",
-           "../assets/24bps_part3.flac",
-           "../assets/24bps_part4.flac",
-           "../assets/24bps_part5.flac",
-           "../assets/24bps_part6.flac",
-           "../assets/24bps_part7.flac",
-           "../assets/24bps_part8.flac",
-           "../assets/24bps_part9.flac",
-           "../assets/24bps_part10.flac",
-           "../assets/24bps_part11.flac",
-           "../assets/24bps_part12.flac",
-           "../assets/24bps_part13.flac",
-           "../assets/24bps_part14.flac",
-       }) {
-    ASSERT_TRUE(stream.Reset(name));
-    if (first) {
-        first = false;
-        stream.device_.Init(stream.format_, ::plac::AlsaAudioDevice::LogLevel::verbose);
-    }
-    stream.Decode();
-  }
-  stream.device_.Drain();
+  Play({
+      "../assets/24bps_part0.flac",
+      "../assets/24bps_part1.flac",
+      "../assets/24bps_part2.flac",
+      "../assets/24bps_part3.flac",
+      "../assets/24bps_part4.flac",
+      "../assets/24bps_part5.flac",
+      "../assets/24bps_part6.flac",
+      "../assets/24bps_part7.flac",
+      "../assets/24bps_part8.flac",
+      "../assets/24bps_part9.flac",
+      "../assets/24bps_part10.flac",
+      "../assets/24bps_part11.flac",
+      "../assets/24bps_part12.flac",
+      "../assets/24bps_part13.flac",
+      "../assets/24bps_part14.flac",
+  });
+  Stop();
 
   std::ifstream file("uln2-raw-S24_3LE-44100-2.raw", std::ios::binary);
   ASSERT_TRUE(file.is_open());
@@ -111,5 +145,353 @@ TEST_F(FlacDecodeTest, Play24Bps) {
   EXPECT_EQ(150000, total);
 }
 
+class FlacSeekTest : public ::testing::Test {
+protected:
+  void TearDown() override { std::filesystem::remove_all(kIndexDir); }
+
+  // decodes the rest of the stream and returns the left channel, which counts
+  // the frames of the 16 bps assets
+  std::vector<size_t> Decode() {
+    stream_.Decode();
+    std::vector<size_t> values{};
+    audio_buffer_.Drain(stream_.format_, [&values](const AudioFormat, const u_char *const data,
+                                                   const size_t count) {
+      for (size_t i{0}; i < count; ++i) {
+        values.push_back(data[4 * i] | (data[4 * i + 1] << 8U) | (data[4 * i + 2] << 16U));
+      }
+      return static_cast<ssize_t>(count);
+    });
+    return values;
+  }
+
+  static constexpr const char *kIndexDir{"flac_seek_test_index"};
+  static constexpr const char *kName{"../assets/16bps_part0.flac"};
+  FlowControl flow_{};
+  // holds a whole part, so decoding never waits for a consumer
+  AudioBuffer<65536> audio_buffer_{};
+  Stream stream_{audio_buffer_, flow_};
+};
+
+TEST_F(FlacSeekTest, Seek) {
+  ASSERT_TRUE(stream_.Reset(kName));
+  ASSERT_TRUE(stream_.Seek(1234));
+
+  const std::vector<size_t> values{Decode()};
+  ASSERT_EQ(10000 - 1234, values.size());
+  EXPECT_EQ(1234, values.front());
+  EXPECT_EQ(9999, values.back());
+}
+
+TEST_F(FlacSeekTest, SeekWithCachedIndex) {
+  stream_.index_dir_ = kIndexDir;
+  ASSERT_TRUE(stream_.Reset(kName));
+  EXPECT_FALSE(stream_.index_.complete_);
+  EXPECT_EQ(10000, Decode().size());
+
+  // the first play recorded every frame
+  ASSERT_TRUE(stream_.Reset(kName));
+  EXPECT_TRUE(stream_.index_.complete_);
+  ASSERT_TRUE(stream_.Seek(5000));
+  const std::vector<size_t> values{Decode()};
+  ASSERT_EQ(5000, values.size());
+  EXPECT_EQ(5000, values.front());
+}
+
+TEST_F(FlacSeekTest, SeekBeyondEnd) {
+  ASSERT_TRUE(stream_.Reset(kName));
+  EXPECT_FALSE(stream_.Seek(10000));
+}
+
+// small chunks, so that the assets are split several times
+class FlacParallelTest : public ::testing::Test {
+protected:
+  static constexpr size_t kChunkBytes{4096};
+  ParallelDecoder decoder_{4, kChunkBytes};
+};
+
+TEST_F(FlacParallelTest, DecodeInOrder) {
+  std::vector<size_t> values{};
+  ASSERT_TRUE(decoder_.Decode("../assets/16bps_part3.flac",
+                              [&values](const AudioFormat format, std::span<const u_char> data) {
+                                EXPECT_EQ((AudioFormat{16, 2, 44100}), format);
+                                for (size_t i{0}; i + 4 <= data.size(); i += 4) {
+                                  values.push_back(data[i] | (data[i + 1] << 8U)
+                                                   | (data[i + 2] << 16U));
+                                }
+                                return true;
+                              }));
+
+  EXPECT_LT(1, decoder_.stats_.chunks_);
+  EXPECT_FALSE(decoder_.stats_.fallback_);
+  ASSERT_EQ(10000, values.size());
+  for (size_t i{0}; i < values.size(); ++i) {
+    ASSERT_EQ(30000 + i, values[i]) << i;
+  }
+}
+
+TEST_F(FlacParallelTest, StopWhenWriteFails) {
+  size_t writes{0};
+  EXPECT_FALSE(decoder_.Decode("../assets/24bps_part0.flac",
+                               [&writes](const AudioFormat, std::span<const u_char>) {
+                                 ++writes;
+                                 return false;
+                               }));
+  EXPECT_EQ(1, writes);
+}
+
+TEST_F(FlacParallelTest, RejectMissingFile) {
+  EXPECT_FALSE(decoder_.Decode("../assets/missing.flac",
+                               [](const AudioFormat, std::span<const u_char>) { return true; }));
+}
+
+// the native engine against libFLAC, sample by sample
+class FlacNativeTest : public ::testing::Test {
+protected:
+  void TearDown() override {
+    std::remove(kName);
+    std::filesystem::remove_all(kIndexDir);
+  }
+
+  // the whole stream or the rest of it after a seek
+  std::vector<u_char> Decode(const Stream::Engine engine, const char *name, const uint64_t seek = 0,
+                             const std::string &index_dir = {}) {
+    FlowControl flow{};
+    auto audio_buffer{std::make_unique<AudioBuffer<65536>>()};
+    Stream stream{*audio_buffer, flow, Stream::Input::mmap, Stream::kDefaultMemoryLimit, engine};
+    stream.index_dir_ = index_dir;
+    EXPECT_TRUE(stream.Reset(name));
+    if (seek != 0) {
+      EXPECT_TRUE(stream.Seek(seek));
+    }
+    // Seek() continues natively from an indexed frame only
+    EXPECT_EQ(engine == Stream::Engine::native, stream.native_);
+    stream.Decode();
+    std::vector<u_char> pcm{};
+    audio_buffer->Drain(stream.format_, [&pcm](const AudioFormat format, const u_char *const data,
+                                               const size_t count) {
+      pcm.insert(pcm.end(), data, data + AsBytes(format, count));
+      return static_cast<ssize_t>(count);
+    });
+    return pcm;
+  }
+
+  static constexpr const char *kName{"flac_native_test.flac"};
+  static constexpr const char *kIndexDir{"flac_native_test_index"};
+};
+
+TEST_F(FlacNativeTest, Assets) {
+  for (const char *name : {"../assets/16bps_part0.flac", "../assets/16bps_part7.flac",
+                           "../assets/24bps_part0.flac", "../assets/24bps_part14.flac"}) {
+    SCOPED_TRACE(name);
+    const std::vector<u_char> expected{Decode(Stream::Engine::libflac, name)};
+    ASSERT_FALSE(expected.empty());
+    EXPECT_EQ(expected, Decode(Stream::Engine::native, name));
+  }
+}
+
+TEST_F(FlacNativeTest, SeekWithIndex) {
+  const char *const name{"../assets/16bps_part0.flac"};
+  // the first play records the index
+  Decode(Stream::Engine::libflac, name, 0, kIndexDir);
+  EXPECT_EQ(Decode(Stream::Engine::libflac, name, 4321),
+            Decode(Stream::Engine::native, name, 4321, kIndexDir));
+}
+
+// FrameDecoder on what the libFLAC encoder produces at
+// several compression levels, which covers fixed and LPC subframes, the
+// stereo modes and partitioned residuals
+TEST_F(FlacNativeTest, EncodedSignals) {
+  struct Case {
+    unsigned int bits;
+    unsigned int channels;
+    unsigned int level;
+    unsigned int blocksize;
+  };
+  for (const Case c : {Case{16, 1, 0, 1152}, Case{16, 2, 5, 4096}, Case{16, 2, 8, 4608},
+                       Case{24, 2, 5, 4096}, Case{24, 2, 8, 1152}, Case{24, 6, 5, 4096},
+                       Case{16, 6, 8, 2048}}) {
+    SCOPED_TRACE(::testing::Message() << c.bits << " bits, " << c.channels << " channels, level "
+                                      << c.level << ", blocksize " << c.blocksize);
+    // tones with a little noise, differently per channel
+    constexpr size_t kFrames{30000};
+    std::vector<FLAC__int32> samples(kFrames * c.channels);
+    uint32_t lcg{1};
+    const double amplitude{std::ldexp(0.4, static_cast<int>(c.bits) - 1)};
+    for (size_t i{0}; i < kFrames; ++i) {
+      for (size_t ch{0}; ch < c.channels; ++ch) {
+        lcg = lcg * 1664525U + 1013904223U;
+        const double tone{std::sin(static_cast<double>(i) * 0.01 * static_cast<double>(ch + 1))};
+        samples[i * c.channels + ch] = static_cast<FLAC__int32>(amplitude * tone)
+                                       + static_cast<FLAC__int32>(lcg >> 24U) - 128;
+      }
+    }
+    FLAC__StreamEncoder *encoder{FLAC__stream_encoder_new()};
+    ASSERT_NE(nullptr, encoder);
+    FLAC__stream_encoder_set_channels(encoder, c.channels);
+    FLAC__stream_encoder_set_bits_per_sample(encoder, c.bits);
+    FLAC__stream_encoder_set_sample_rate(encoder, 48000);
+    FLAC__stream_encoder_set_compression_level(encoder, c.level);
+    FLAC__stream_encoder_set_blocksize(encoder, c.blocksize);
+    ASSERT_EQ(FLAC__STREAM_ENCODER_INIT_STATUS_OK,
+              FLAC__stream_encoder_init_file(encoder, kName, nullptr, nullptr));
+    ASSERT_TRUE(FLAC__stream_encoder_process_interleaved(encoder, samples.data(), kFrames));
+    ASSERT_TRUE(FLAC__stream_encoder_finish(encoder));
+    FLAC__stream_encoder_delete(encoder);
+
+    // FLAC is lossless, so the encoder input is the reference
+    std::vector<u_char> expected{};
+    for (const FLAC__int32 s : samples) {
+      for (unsigned int b{0}; b < c.bits; b += 8) {
+        expected.push_back(static_cast<u_char>(static_cast<uint32_t>(s) >> b));
+      }
+    }
+
+    const FileDesc desc{kName};
+    const MappedFile map{desc};
+    ASSERT_TRUE(map.IsValid());
+    const std::span<const u_char> data{map.data_, map.size_};
+    const std::optional<StreamLayout> layout{ParseStreamLayout(data)};
+    ASSERT_TRUE(layout);
+    FrameDecoder decoder{};
+    ASSERT_TRUE(decoder.Reset(layout->info_));
+    std::vector<u_char> pcm(kFrames * decoder.FrameBytes());
+    size_t offset{layout->audio_start_};
+    size_t frames{0};
+    while (offset < data.size()) {
+      const std::optional<FrameHeader> header{
+          ParseFrameHeader(data.subspan(offset), layout->info_)};
+      ASSERT_TRUE(header) << offset;
+      ASSERT_EQ(frames, header->first_sample_);
+      const size_t size{
+          decoder.Decode(data.subspan(offset), *header, &pcm[frames * decoder.FrameBytes()])};
+      ASSERT_NE(0, size) << offset;
+      offset += size;
+      frames += header->blocksize_;
+    }
+    EXPECT_EQ(kFrames, frames);
+    EXPECT_EQ(expected, pcm);
+  }
+}
+
+class FlacVerifyTest : public ::testing::TestWithParam<Stream::Engine> {
+protected:
+  void TearDown() override { std::remove(kCorrupt); }
+
+  // a copy of name with a bit flipped at offset, by default in the middle of the audio
+  static void Corrupt(const char *name, std::optional<size_t> offset = std::nullopt) {
+    std::ifstream in{name, std::ios::binary};
+    std::vector<char> data{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    ASSERT_FALSE(data.empty());
+    data[offset.value_or(data.size() / 2)] ^= 0x01;
+    std::ofstream out{kCorrupt, std::ios::binary};
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+  }
+
+  static constexpr const char *kCorrupt{"flac_verify_test.flac"};
+};
+
+TEST_P(FlacVerifyTest, Assets) {
+  const std::vector<std::string> names{"../assets/16bps_part0.flac", "../assets/16bps_part1.flac",
+                                       "../assets/24bps_part0.flac", "../assets/24bps_part1.flac"};
+  const Verifier verifier{2, 1, GetParam()};
+  std::vector<VerifyResult> results{};
+  EXPECT_EQ(0, verifier.Verify(names, [&results](const VerifyResult &result) {
+    results.push_back(result);
+  }));
+  ASSERT_EQ(names.size(), results.size());
+  for (const VerifyResult &result : results) {
+    EXPECT_EQ(VerifyResult::Status::ok, result.status_) << result.name_;
+    EXPECT_EQ(10000, result.samples_);
+    EXPECT_EQ(0, result.frame_errors_);
+  }
+}
+
+TEST_P(FlacVerifyTest, CorruptFrame) {
+  Corrupt("../assets/24bps_part3.flac");
+  const VerifyResult result{Verifier{1, 1, GetParam()}.Verify(kCorrupt)};
+  EXPECT_TRUE(result.Failed());
+  EXPECT_EQ(VerifyResult::Status::frame_errors, result.status_);
+  EXPECT_LT(0, result.frame_errors_);
+}
+
+TEST_P(FlacVerifyTest, Md5Mismatch) {
+  // the MD5 is the last field of STREAMINFO, behind "fLaC", the block header and 18 bytes
+  Corrupt("../assets/16bps_part3.flac", 4 + 4 + 18);
+  const VerifyResult result{Verifier{1, 1, GetParam()}.Verify(kCorrupt)};
+  EXPECT_EQ(VerifyResult::Status::md5_mismatch, result.status_);
+  EXPECT_EQ(0, result.frame_errors_);
+}
+
+TEST_P(FlacVerifyTest, DecodeFailed) {
+  if (GetParam() != Stream::Engine::libflac) {
+    GTEST_SKIP() << "only libFLAC gives up on a stream";
+  }
+  // the rate of STREAMINFO, from byte 10 on, no longer matches the frames, which
+  // write_callback rejects
+  Corrupt("../assets/16bps_part3.flac", 4 + 4 + 10);
+  const VerifyResult result{Verifier{1, 1, GetParam()}.Verify(kCorrupt)};
+  EXPECT_TRUE(result.Failed());
+  EXPECT_EQ(VerifyResult::Status::decode_failed, result.status_);
+}
+
+TEST_P(FlacVerifyTest, MissingFile) {
+  const VerifyResult result{Verifier{1, 1, GetParam()}.Verify("../assets/missing.flac")};
+  EXPECT_EQ(VerifyResult::Status::unreadable, result.status_);
+}
+
+TEST_P(FlacVerifyTest, Report) {
+  VerifyResult result{Verifier{1, 1, GetParam()}.Verify("../assets/16bps_part2.flac")};
+  result.name_ = "name with spaces.flac";
+  const std::optional<VerifyResult> parsed{ParseVerifyResult(FormatVerifyResult(result))};
+  ASSERT_TRUE(parsed);
+  EXPECT_EQ(result.status_, parsed->status_);
+  EXPECT_EQ(result.samples_, parsed->samples_);
+  EXPECT_EQ(result.md5_, parsed->md5_);
+  EXPECT_EQ(result.name_, parsed->name_);
+}
+
+TEST_P(FlacVerifyTest, DuringPlayback) {
+  // holds a whole part, so decoding never waits for a consumer
+  FlowControl flow{};
+  auto audio_buffer{std::make_unique<AudioBuffer<65536>>()};
+  Stream stream{*audio_buffer, flow, Stream::Input::mmap, Stream::kDefaultMemoryLimit, GetParam()};
+  PlaybackVerifier verifier{};
+  stream.verifier_ = &verifier;
+  for (const char *name : {"../assets/16bps_part4.flac", "../assets/24bps_part4.flac"}) {
+    ASSERT_TRUE(stream.Reset(name));
+    stream.Decode();
+    audio_buffer->Drain(stream.format_, [](const AudioFormat, const u_char *, const size_t count) {
+      return static_cast<ssize_t>(count);
+    });
+  }
+  verifier.Drain();
+  EXPECT_EQ(2, verifier.stats_.verified_);
+  EXPECT_EQ(0, verifier.stats_.mismatched_);
+  EXPECT_EQ(0, verifier.stats_.dropped_);
+}
+
+TEST_P(FlacVerifyTest, WarmUp) {
+  // the dropped first frame is decoded again, so the MD5 of the track matches
+  FlowControl flow{};
+  auto audio_buffer{std::make_unique<AudioBuffer<65536>>()};
+  Stream stream{*audio_buffer, flow, Stream::Input::mmap, Stream::kDefaultMemoryLimit, GetParam()};
+  PlaybackVerifier verifier{};
+  stream.verifier_ = &verifier;
+  ASSERT_TRUE(stream.Reset("../assets/24bps_part4.flac"));
+  ASSERT_TRUE(stream.WarmUp());
+  EXPECT_TRUE(audio_buffer->IsEmpty());
+  stream.Decode();
+  audio_buffer->Drain(stream.format_, [](const AudioFormat, const u_char *, const size_t count) {
+    return static_cast<ssize_t>(count);
+  });
+  verifier.Drain();
+  EXPECT_EQ(1, verifier.stats_.verified_);
+  EXPECT_EQ(0, verifier.stats_.mismatched_);
+  EXPECT_EQ(0, verifier.stats_.incomplete_);
+}
+
+INSTANTIATE_TEST_SUITE_P(Engines, FlacVerifyTest,
+                         ::testing::Values(Stream::Engine::libflac, Stream::Engine::native));
+
 } // namespace
 } // namespace plac
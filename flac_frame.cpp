@@ -0,0 +1,331 @@
+// SPDX-License-Identifier: MIT
+
+#include "flac_frame.h"
+#include <algorithm>
+#include <cstring>
+
+namespace plac {
+
+namespace {
+
+constexpr size_t kStreamInfoSize{34};
+
+constexpr std::array<uint8_t, 256> MakeCrc8Table() {
+  std::array<uint8_t, 256> table{};
+  for (unsigned int i{0}; i < 256; ++i) {
+    unsigned int crc{i};
+    for (int bit{0}; bit < 8; ++bit) {
+      crc = ((crc & 0x80U) != 0) ? ((crc << 1U) ^ 0x07U) : (crc << 1U);
+    }
+    table[i] = static_cast<uint8_t>(crc);
+  }
+  return table;
+}
+
+constexpr std::array<uint8_t, 256> kCrc8Table{MakeCrc8Table()};
+
+constexpr std::array<uint16_t, 256> MakeCrc16Table() {
+  std::array<uint16_t, 256> table{};
+  for (unsigned int i{0}; i < 256; ++i) {
+    unsigned int crc{i << 8U};
+    for (int bit{0}; bit < 8; ++bit) {
+      crc = ((crc & 0x8000U) != 0) ? ((crc << 1U) ^ 0x8005U) : (crc << 1U);
+    }
+    table[i] = static_cast<uint16_t>(crc);
+  }
+  return table;
+}
+
+constexpr std::array<uint16_t, 256> kCrc16Table{MakeCrc16Table()};
+
+// the "UTF-8" coded frame or sample number. false if malformed
+bool ReadNumber(const std::span<const u_char> data, size_t &pos, uint64_t &number) {
+  if (pos >= data.size()) {
+    return false;
+  }
+  const u_char first{data[pos++]};
+  size_t more{0};
+  if ((first & 0x80U) == 0) {
+    number = first;
+    return true;
+  } else if ((first & 0xE0U) == 0xC0U) {
+    number = first & 0x1FU;
+    more = 1;
+  } else if ((first & 0xF0U) == 0xE0U) {
+    number = first & 0x0FU;
+    more = 2;
+  } else if ((first & 0xF8U) == 0xF0U) {
+    number = first & 0x07U;
+    more = 3;
+  } else if ((first & 0xFCU) == 0xF8U) {
+    number = first & 0x03U;
+    more = 4;
+  } else if ((first & 0xFEU) == 0xFCU) {
+    number = first & 0x01U;
+    more = 5;
+  } else if (first == 0xFEU) {
+    number = 0;
+    more = 6;
+  } else {
+    return false;
+  }
+  if (data.size() - pos < more) {
+    return false;
+  }
+  for (size_t i{0}; i < more; ++i) {
+    const u_char c{data[pos++]};
+    if ((c & 0xC0U) != 0x80U) {
+      return false;
+    }
+    number = (number << 6U) | (c & 0x3FU);
+  }
+  return true;
+}
+
+} // namespace
+
+std::optional<StreamInfo> ParseStreamInfo(const std::span<const u_char> data) {
+  if (data.size() < kStreamInfoSize) {
+    return std::nullopt;
+  }
+  const u_char *const b{data.data()};
+  StreamInfo info{};
+  info.min_blocksize_ = (uint32_t{b[0]} << 8U) | b[1];
+  info.max_blocksize_ = (uint32_t{b[2]} << 8U) | b[3];
+  info.rate_ = (uint32_t{b[10]} << 12U) | (uint32_t{b[11]} << 4U) | (b[12] >> 4U);
+  info.channels_ = ((b[12] >> 1U) & 0x07U) + 1;
+  info.bits_ = (((b[12] & 0x01U) << 4U) | (b[13] >> 4U)) + 1;
+  info.total_samples_ = (uint64_t{b[13] & 0x0FU} << 32U) | (uint64_t{b[14]} << 24U)
+                        | (uint64_t{b[15]} << 16U) | (uint64_t{b[16]} << 8U) | b[17];
+  std::copy_n(&b[18], info.md5_.size(), info.md5_.begin());
+  return info;
+}
+
+std::optional<StreamLayout> ParseStreamLayout(const std::span<const u_char> data) {
+  if ((data.size() < 8 + kStreamInfoSize) || (std::memcmp(data.data(), "fLaC", 4) != 0)
+      || ((data[4] & 0x7FU) != 0)
+      || (((size_t{data[5]} << 16U) | (size_t{data[6]} << 8U) | data[7]) != kStreamInfoSize)) {
+    return std::nullopt;
+  }
+
+  StreamLayout layout{};
+  layout.info_ = *ParseStreamInfo(data.subspan(8));
+  layout.info_block_ = data.subspan(4, 4 + kStreamInfoSize);
+
+  size_t pos{4};
+  while (true) {
+    if (data.size() - pos < 4) {
+      return std::nullopt;
+    }
+    const bool last{(data[pos] & 0x80U) != 0};
+    const size_t length{(size_t{data[pos + 1]} << 16U) | (size_t{data[pos + 2]} << 8U)
+                        | data[pos + 3]};
+    pos += 4;
+    if (data.size() - pos < length) {
+      return std::nullopt;
+    }
+    pos += length;
+    if (last) {
+      break;
+    }
+  }
+  layout.audio_start_ = pos;
+  return layout;
+}
+
+uint8_t Crc8(const std::span<const u_char> data) {
+  uint8_t crc{0};
+  for (const u_char c : data) {
+    crc = kCrc8Table[crc ^ c];
+  }
+  return crc;
+}
+
+uint16_t Crc16(const std::span<const u_char> data) {
+  unsigned int crc{0};
+  for (const u_char c : data) {
+    crc = ((crc << 8U) ^ kCrc16Table[((crc >> 8U) ^ c) & 0xFFU]) & 0xFFFFU;
+  }
+  return static_cast<uint16_t>(crc);
+}
+
+std::optional<FrameHeader> ParseFrameHeader(const std::span<const u_char> data,
+                                            const StreamInfo &info) {
+  // sync code, reserved bit and the fixed part up to the number
+  if ((data.size() < 6) || (data[0] != 0xFFU) || ((data[1] & 0xFEU) != 0xF8U)
+      || ((data[3] & 0x01U) != 0)) {
+    return std::nullopt;
+  }
+  FrameHeader header{};
+  header.variable_blocksize_ = (data[1] & 0x01U) != 0;
+  const unsigned int blocksize_code{static_cast<unsigned int>(data[2]) >> 4U};
+  const unsigned int rate_code{data[2] & 0x0FU};
+  const unsigned int channel_code{static_cast<unsigned int>(data[3]) >> 4U};
+  const unsigned int bits_code{(data[3] >> 1U) & 0x07U};
+
+  size_t pos{4};
+  if (!ReadNumber(data, pos, header.number_)) {
+    return std::nullopt;
+  }
+
+  if (blocksize_code == 0) {
+    return std::nullopt;
+  } else if (blocksize_code == 1) {
+    header.blocksize_ = 192;
+  } else if (blocksize_code <= 5) {
+    header.blocksize_ = 576U << (blocksize_code - 2);
+  } else if (blocksize_code == 6) {
+    if (pos + 1 > data.size()) {
+      return std::nullopt;
+    }
+    header.blocksize_ = uint32_t{data[pos]} + 1;
+    pos += 1;
+  } else if (blocksize_code == 7) {
+    if (pos + 2 > data.size()) {
+      return std::nullopt;
+    }
+    header.blocksize_ = ((uint32_t{data[pos]} << 8U) | data[pos + 1]) + 1;
+    pos += 2;
+  } else {
+    header.blocksize_ = 256U << (blocksize_code - 8);
+  }
+
+  static constexpr std::array<uint32_t, 12> kRates{
+      0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+  if (rate_code == 0) {
+    header.rate_ = info.rate_;
+  } else if (rate_code < kRates.size()) {
+    header.rate_ = kRates[rate_code];
+  } else if (rate_code == 12) {
+    if (pos + 1 > data.size()) {
+      return std::nullopt;
+    }
+    header.rate_ = uint32_t{data[pos]} * 1000;
+    pos += 1;
+  } else if (rate_code <= 14) {
+    if (pos + 2 > data.size()) {
+      return std::nullopt;
+    }
+    header.rate_ = (uint32_t{data[pos]} << 8U) | data[pos + 1];
+    header.rate_ *= (rate_code == 14) ? 10 : 1;
+    pos += 2;
+  } else {
+    return std::nullopt;
+  }
+
+  if (channel_code < 8) {
+    header.channels_ = channel_code + 1;
+    header.channel_assignment_ = 0;
+  } else if (channel_code <= 10) {
+    header.channels_ = 2;
+    header.channel_assignment_ = channel_code;
+  } else {
+    return std::nullopt;
+  }
+
+  static constexpr std::array<uint32_t, 8> kBits{0, 8, 12, 0, 16, 20, 24, 32};
+  if (bits_code == 3) {
+    return std::nullopt;
+  }
+  header.bits_ = (bits_code == 0) ? info.bits_ : kBits[bits_code];
+
+  if ((pos >= data.size()) || (Crc8(data.first(pos)) != data[pos])) {
+    return std::nullopt;
+  }
+  header.size_ = pos + 1;
+
+  // all but the last frame of a fixed blocksize stream have the maximum size
+  header.first_sample_ = header.variable_blocksize_
+                             ? header.number_
+                             : header.number_ * uint64_t{info.max_blocksize_};
+
+  // a frame of this stream, not just 15 bits which happen to match
+  if ((header.rate_ != info.rate_) || (header.channels_ != info.channels_)
+      || (header.bits_ != info.bits_) || (header.blocksize_ > info.max_blocksize_)
+      || ((info.total_samples_ != 0) && (header.first_sample_ >= info.total_samples_))) {
+    return std::nullopt;
+  }
+  return header;
+}
+
+size_t FindFrameHeader(const std::span<const u_char> data, size_t from, const StreamInfo &info) {
+  while (from < data.size()) {
+    const void *sync{std::memchr(&data[from], 0xFF, data.size() - from)};
+    if (sync == nullptr) {
+      break;
+    }
+    from = static_cast<size_t>(static_cast<const u_char *>(sync) - data.data());
+    if (ParseFrameHeader(data.subspan(from), info)) {
+      return from;
+    }
+    ++from;
+  }
+  return data.size();
+}
+
+std::optional<Tag> MatchTag(const std::string_view comment, std::string_view &value) {
+  const size_t eq{comment.find('=')};
+  if (eq == std::string_view::npos) {
+    return std::nullopt;
+  }
+  const std::string_view name{comment.substr(0, eq)};
+  for (size_t i{0}; i < kTagCount; ++i) {
+    // field names are ASCII, see the Vorbis comment spec
+    if (std::equal(name.begin(), name.end(), kTagNames[i].begin(), kTagNames[i].end(),
+                   [](const char a, const char b) {
+                     return ((a >= 'a') && (a <= 'z') ? static_cast<char>(a - 'a' + 'A') : a)
+                            == b;
+                   })) {
+      value = comment.substr(eq + 1);
+      return static_cast<Tag>(i);
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<Tags> ParseVorbisComment(const std::span<const u_char> data) {
+  size_t pos{0};
+  // unlike the rest of FLAC the fields are little endian
+  const auto read_u32{[&data, &pos]() -> std::optional<size_t> {
+    if (data.size() - pos < 4) {
+      return std::nullopt;
+    }
+    const size_t value{size_t{data[pos]} | (size_t{data[pos + 1]} << 8U)
+                       | (size_t{data[pos + 2]} << 16U) | (size_t{data[pos + 3]} << 24U)};
+    pos += 4;
+    return value;
+  }};
+  const auto read_string{[&data, &pos, &read_u32]() -> std::optional<std::string_view> {
+    const std::optional<size_t> length{read_u32()};
+    if (!length || (data.size() - pos < *length)) {
+      return std::nullopt;
+    }
+    const std::string_view s{reinterpret_cast<const char *>(data.data() + pos), *length};
+    pos += *length;
+    return s;
+  }};
+
+  // vendor string
+  if (!read_string()) {
+    return std::nullopt;
+  }
+  const std::optional<size_t> count{read_u32()};
+  if (!count) {
+    return std::nullopt;
+  }
+  Tags tags{};
+  for (size_t i{0}; i < *count; ++i) {
+    const std::optional<std::string_view> comment{read_string()};
+    if (!comment) {
+      return std::nullopt;
+    }
+    std::string_view value{};
+    if (const std::optional<Tag> tag{MatchTag(*comment, value)};
+        tag && tags[static_cast<size_t>(*tag)].empty()) {
+      tags[static_cast<size_t>(*tag)] = value;
+    }
+  }
+  return tags;
+}
+
+} // namespace plac
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FLAC_FRAME_H
+#define FLAC_FRAME_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <sys/types.h>
+
+namespace plac {
+
+// Parsers for the parts of the FLAC format which are needed without a
+// decoder, see https://xiph.org/flac/format.html
+
+struct StreamInfo {
+  uint32_t min_blocksize_;
+  uint32_t max_blocksize_;
+  uint32_t rate_;
+  uint32_t channels_;
+  uint32_t bits_;
+  // 0 if unknown
+  uint64_t total_samples_;
+  std::array<u_char, 16> md5_;
+};
+
+struct StreamLayout {
+  StreamInfo info_;
+  // the STREAMINFO block including its header, i.e. the bytes at [4, 42)
+  std::span<const u_char> info_block_;
+  // byte offset of the first frame
+  size_t audio_start_;
+};
+
+// body of a STREAMINFO block, i.e. without the block header. empty if it is
+// too short
+std::optional<StreamInfo> ParseStreamInfo(std::span<const u_char> data);
+
+// data starts with "fLaC" and STREAMINFO. empty if the metadata is malformed
+std::optional<StreamLayout> ParseStreamLayout(std::span<const u_char> data);
+
+struct FrameHeader {
+  uint32_t blocksize_;
+  uint32_t rate_;
+  uint32_t channels_;
+  // 0 independent, 8 left/side, 9 side/right, 10 mid/side, see the format spec
+  uint32_t channel_assignment_;
+  uint32_t bits_;
+  bool variable_blocksize_;
+  // frame number, or sample number if variable_blocksize_
+  uint64_t number_;
+  // sample number of the first sample in the frame
+  uint64_t first_sample_;
+  // bytes including the CRC-8
+  size_t size_;
+};
+
+// CRC-8 with polynomial x^8 + x^2 + x + 1 as used for frame headers
+uint8_t Crc8(std::span<const u_char> data);
+// CRC-16 with polynomial x^16 + x^15 + x^2 + 1 as used for whole frames
+uint16_t Crc16(std::span<const u_char> data);
+
+// frame header at the start of data, with fields which refer to STREAMINFO
+// resolved against info. empty if there is none or it does not fit info
+std::optional<FrameHeader> ParseFrameHeader(std::span<const u_char> data, const StreamInfo &info);
+
+// offset of the first frame header at or after from, data.size() if none
+size_t FindFrameHeader(std::span<const u_char> data, size_t from, const StreamInfo &info);
+
+// Vorbis comments which are shown by the player and kept in the library index
+enum class Tag : size_t { tracknumber, tracktotal, title, artist, album, date, genre, count };
+
+constexpr size_t kTagCount{static_cast<size_t>(Tag::count)};
+constexpr std::array<std::string_view, kTagCount> kTagNames{
+    "TRACKNUMBER", "TRACKTOTAL", "TITLE", "ARTIST", "ALBUM", "DATE", "GENRE"};
+
+// first value of each tag, empty if the tag is missing
+using Tags = std::array<std::string_view, kTagCount>;
+
+// comment is "NAME=value", the name is compared case-insensitively. empty if
+// the name is not one of Tag, otherwise value is set
+std::optional<Tag> MatchTag(std::string_view comment, std::string_view &value);
+
+// body of a VORBIS_COMMENT block, i.e. without the block header. values are
+// views into data. empty if the block is malformed
+std::optional<Tags> ParseVorbisComment(std::span<const u_char> data);
+
+} // namespace plac
+
+#endif
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: MIT
+
+#include "flac_frame.h"
+#include <gtest/gtest.h>
+#include <string_view>
+#include <vector>
+
+namespace plac {
+namespace {
+
+// 4096 samples per frame, 44.1 kHz, stereo, 16 bits, 100000 samples
+constexpr std::array<u_char, 34> kStreamInfo{
+    0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0xC4,
+    0x42, 0xF0, 0x00, 0x01, 0x86, 0xA0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+std::vector<u_char> MakeFile() {
+  std::vector<u_char> file{'f', 'L', 'a', 'C', 0x00, 0x00, 0x00, 34};
+  file.insert(file.end(), kStreamInfo.begin(), kStreamInfo.end());
+  // last block, PADDING of 10 bytes
+  file.insert(file.end(), {0x81, 0x00, 0x00, 10});
+  file.resize(file.size() + 10);
+  return file;
+}
+
+// appends the CRC-8
+std::vector<u_char> WithCrc(std::vector<u_char> header) {
+  header.push_back(Crc8(header));
+  return header;
+}
+
+StreamInfo Info() {
+  const std::vector<u_char> file{MakeFile()};
+  return ParseStreamLayout(file)->info_;
+}
+
+TEST(FlacFrameTest, Crc8) {
+  constexpr std::string_view kCheck{"123456789"};
+  EXPECT_EQ(0xF4, Crc8({reinterpret_cast<const u_char *>(kCheck.data()), kCheck.size()}));
+}
+
+TEST(FlacFrameTest, Crc16) {
+  constexpr std::string_view kCheck{"123456789"};
+  EXPECT_EQ(0xFEE8, Crc16({reinterpret_cast<const u_char *>(kCheck.data()), kCheck.size()}));
+}
+
+TEST(FlacFrameTest, ParseStreamLayout) {
+  const std::vector<u_char> file{MakeFile()};
+  const std::optional<StreamLayout> layout{ParseStreamLayout(file)};
+  ASSERT_TRUE(layout);
+  EXPECT_EQ(4096, layout->info_.min_blocksize_);
+  EXPECT_EQ(4096, layout->info_.max_blocksize_);
+  EXPECT_EQ(44100, layout->info_.rate_);
+  EXPECT_EQ(2, layout->info_.channels_);
+  EXPECT_EQ(16, layout->info_.bits_);
+  EXPECT_EQ(100000, layout->info_.total_samples_);
+  EXPECT_EQ(0x01, layout->info_.md5_.back());
+  EXPECT_EQ(38, layout->info_block_.size());
+  EXPECT_EQ(file.size(), layout->audio_start_);
+
+  EXPECT_FALSE(ParseStreamLayout(std::span<const u_char>{file}.first(50)));
+  std::vector<u_char> not_flac{file};
+  not_flac[0] = 'F';
+  EXPECT_FALSE(ParseStreamLayout(not_flac));
+}
+
+TEST(FlacFrameTest, ParseFrameHeader) {
+  const StreamInfo info{Info()};
+  // fixed blocksize, 4096 samples, 44.1 kHz, stereo, 16 bits, frame 3
+  const std::vector<u_char> header{WithCrc({0xFF, 0xF8, 0xC9, 0x18, 0x03})};
+  const std::optional<FrameHeader> parsed{ParseFrameHeader(header, info)};
+  ASSERT_TRUE(parsed);
+  EXPECT_FALSE(parsed->variable_blocksize_);
+  EXPECT_EQ(4096, parsed->blocksize_);
+  EXPECT_EQ(44100, parsed->rate_);
+  EXPECT_EQ(2, parsed->channels_);
+  EXPECT_EQ(0, parsed->channel_assignment_);
+  EXPECT_EQ(16, parsed->bits_);
+  EXPECT_EQ(3, parsed->number_);
+  EXPECT_EQ(3 * 4096, parsed->first_sample_);
+  EXPECT_EQ(6, parsed->size_);
+
+  // variable blocksize, 1000 samples from STREAMINFO rate and bits, mid/side, sample 1000
+  const std::vector<u_char> variable{WithCrc({0xFF, 0xF9, 0x70, 0xA0, 0xCF, 0xA8, 0x03, 0xE7})};
+  const std::optional<FrameHeader> parsed_variable{ParseFrameHeader(variable, info)};
+  ASSERT_TRUE(parsed_variable);
+  EXPECT_TRUE(parsed_variable->variable_blocksize_);
+  EXPECT_EQ(1000, parsed_variable->blocksize_);
+  EXPECT_EQ(44100, parsed_variable->rate_);
+  EXPECT_EQ(10, parsed_variable->channel_assignment_);
+  EXPECT_EQ(1000, parsed_variable->number_);
+  EXPECT_EQ(1000, parsed_variable->first_sample_);
+  EXPECT_EQ(9, parsed_variable->size_);
+}
+
+TEST(FlacFrameTest, RejectFrameHeader) {
+  const StreamInfo info{Info()};
+  std::vector<u_char> bad_crc{WithCrc({0xFF, 0xF8, 0xC9, 0x18, 0x03})};
+  bad_crc.back() ^= 0x01U;
+  EXPECT_FALSE(ParseFrameHeader(bad_crc, info));
+  // 24 bits
+  EXPECT_FALSE(ParseFrameHeader(WithCrc({0xFF, 0xF8, 0xC9, 0x1C, 0x03}), info));
+  // 48 kHz
+  EXPECT_FALSE(ParseFrameHeader(WithCrc({0xFF, 0xF8, 0xCA, 0x18, 0x03}), info));
+  // frame 30 starts behind the last sample
+  EXPECT_FALSE(ParseFrameHeader(WithCrc({0xFF, 0xF8, 0xC9, 0x18, 0x1E}), info));
+  // reserved bit
+  EXPECT_FALSE(ParseFrameHeader(WithCrc({0xFF, 0xF8, 0xC9, 0x19, 0x03}), info));
+  // truncated
+  EXPECT_FALSE(ParseFrameHeader(std::vector<u_char>{0xFF, 0xF8, 0xC9, 0x18, 0x03}, info));
+}
+
+TEST(FlacFrameTest, FindFrameHeader) {
+  const StreamInfo info{Info()};
+  std::vector<u_char> data(100, 0xFF);
+  data[50] = 0xF8;
+  const std::vector<u_char> header{WithCrc({0xFF, 0xF8, 0xC9, 0x18, 0x03})};
+  data.insert(data.end(), header.begin(), header.end());
+  data.resize(data.size() + 20);
+
+  EXPECT_EQ(100, FindFrameHeader(data, 0, info));
+  EXPECT_EQ(100, FindFrameHeader(data, 100, info));
+  EXPECT_EQ(data.size(), FindFrameHeader(data, 101, info));
+}
+
+// little endian length followed by the bytes
+void AppendString(std::vector<u_char> &data, const std::string_view s) {
+  for (unsigned int shift{0}; shift < 32; shift += 8) {
+    data.push_back(static_cast<u_char>(s.size() >> shift));
+  }
+  data.insert(data.end(), s.begin(), s.end());
+}
+
+std::vector<u_char> MakeVorbisComment(const std::vector<std::string_view> &comments) {
+  std::vector<u_char> data{};
+  AppendString(data, "reference libFLAC 1.4.3");
+  data.insert(data.end(), {static_cast<u_char>(comments.size()), 0, 0, 0});
+  for (const std::string_view comment : comments) {
+    AppendString(data, comment);
+  }
+  return data;
+}
+
+TEST(FlacFrameTest, MatchTag) {
+  std::string_view value{};
+  EXPECT_EQ(Tag::title, MatchTag("Title=a=b", value));
+  EXPECT_EQ("a=b", value);
+  EXPECT_EQ(Tag::tracknumber, MatchTag("TRACKNUMBER=", value));
+  EXPECT_EQ("", value);
+  EXPECT_FALSE(MatchTag("TITLE", value));
+  EXPECT_FALSE(MatchTag("TITL=a", value));
+  EXPECT_FALSE(MatchTag("ALBUMARTIST=a", value));
+}
+
+TEST(FlacFrameTest, ParseVorbisComment) {
+  const std::vector<u_char> data{
+      MakeVorbisComment({"ARTIST=a", "album=b", "COMMENT=c", "ARTIST=d", "genre=e"})};
+  const std::optional<Tags> tags{ParseVorbisComment(data)};
+  ASSERT_TRUE(tags);
+  EXPECT_EQ("a", (*tags)[static_cast<size_t>(Tag::artist)]);
+  EXPECT_EQ("b", (*tags)[static_cast<size_t>(Tag::album)]);
+  EXPECT_EQ("e", (*tags)[static_cast<size_t>(Tag::genre)]);
+  EXPECT_EQ("", (*tags)[static_cast<size_t>(Tag::title)]);
+
+  for (size_t size{0}; size < data.size(); ++size) {
+    EXPECT_FALSE(ParseVorbisComment(std::span{data}.first(size))) << size;
+  }
+}
+
+} // namespace
+} // namespace plac
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: MIT
+
+// Keeps an index of the metadata of a music library, see LibraryIndex.
+//
+// usage: flaclibrary [--index=<path>] [--jobs=<n>] [<dir>...]
+//
+// With directories the index is brought up to date with the FLAC files below
+// them, reading only files which are new or changed. The counts go to stderr.
+// Without directories the index is listed, one line per track:
+// `<rate> <bits> <channels> <samples> <bytes> <path>`.
+
+#include "conditions.h"
+#include "library_index.h"
+#include "log.h"
+#include "parse_number.h"
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::string index{::plac::DefaultLibraryIndexPath()};
+  // 0 for one per core
+  unsigned int jobs{0};
+};
+
+Options ParseOptions(int argc, char *argv[]) {
+  const option long_options[]{
+      {"index", required_argument, nullptr, 'i'},
+      {"jobs", required_argument, nullptr, 'j'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  Options options{};
+  int c{};
+  while ((c = ::getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+    switch (c) {
+    case 'i':
+      options.index = optarg;
+      break;
+    case 'j': {
+      const std::optional<uint64_t> jobs{::plac::ParseNumber(optarg, UINT_MAX)};
+      ENSURES(jobs.has_value(), "invalid number of jobs: {}", optarg);
+      options.jobs = static_cast<unsigned int>(*jobs);
+      break;
+    }
+    default:
+      ENSURES(false, "unknown option");
+      break;
+    }
+  }
+  ENSURES(!options.index.empty(), "no index, set --index, XDG_CACHE_HOME or HOME");
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  ::plac::AsyncLog::Instance();
+  const Options options{ParseOptions(argc, argv)};
+
+  const std::vector<std::string> roots{argv + optind, argv + argc};
+  if (!roots.empty()) {
+    const std::optional<::plac::LibraryScanStats> stats{
+        ::plac::UpdateLibraryIndex(options.index, roots, options.jobs)};
+    if (!stats) {
+      std::fprintf(stderr, "cannot update %s\n", options.index.c_str());
+      return EXIT_FAILURE;
+    }
+    std::fprintf(stderr, "%zu tracks, %zu scanned, %zu reused, %zu failed\n", stats->tracks_,
+                 stats->scanned_, stats->reused_, stats->failed_);
+    return EXIT_SUCCESS;
+  }
+
+  const std::optional<::plac::LibraryIndex> index{::plac::LibraryIndex::Open(options.index)};
+  if (!index) {
+    std::fprintf(stderr, "cannot open %s\n", options.index.c_str());
+    return EXIT_FAILURE;
+  }
+  for (const ::plac::LibraryIndex::Track &track : index->Tracks()) {
+    const std::string_view path{index->Path(track)};
+    std::printf("%u %u %u %llu %llu %.*s\n", track.rate_, unsigned{track.bits_},
+                unsigned{track.channels_}, static_cast<unsigned long long>(track.total_samples_),
+                static_cast<unsigned long long>(track.key_.size_), static_cast<int>(path.size()),
+                path.data());
+  }
+  return EXIT_SUCCESS;
+}
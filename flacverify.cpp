@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: MIT
+
+// Verifies FLAC files like `flac -t`, on all cores and with the decoder of
+// the player.
+//
+// usage: flacverify [--jobs=<n>] [--queue-depth=<n>] [--decoder=libflac|native]
+//                   [--report=<path>] [<file>...]
+//
+// Without files the names are read from stdin, one per line, e.g. from
+// `find -name '*.flac'`. The report has one line per file in the order of
+// completion, see FormatVerifyResult(), and goes to stdout without --report.
+// Failed files are counted on stderr, the exit status is 1 if there are any.
+
+#include "log.h"
+#include "parse_number.h"
+#include "verifier.h"
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+struct Options {
+  // threads which decode or hash, 0 for one per core
+  unsigned int jobs{0};
+  unsigned int queue_depth{::plac::Verifier::kQueueDepth};
+  ::plac::Stream::Engine engine{::plac::Stream::Engine::native};
+  // empty for stdout
+  std::string report{};
+};
+
+Options ParseOptions(int argc, char *argv[]) {
+  const option long_options[]{
+      {"jobs", required_argument, nullptr, 'j'},
+      {"queue-depth", required_argument, nullptr, 'q'},
+      {"decoder", required_argument, nullptr, 'e'},
+      {"report", required_argument, nullptr, 'r'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  Options options{};
+  int c{};
+  while ((c = ::getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+    switch (c) {
+    case 'j': {
+      const std::optional<uint64_t> jobs{::plac::ParseNumber(optarg, UINT_MAX)};
+      ENSURES(jobs.has_value(), "invalid number of jobs: {}", optarg);
+      options.jobs = static_cast<unsigned int>(*jobs);
+      break;
+    }
+    case 'q': {
+      const std::optional<uint64_t> depth{::plac::ParseNumber(optarg, UINT_MAX)};
+      ENSURES(depth.has_value() && (*depth > 0), "invalid queue depth: {}", optarg);
+      options.queue_depth = static_cast<unsigned int>(*depth);
+      break;
+    }
+    case 'e': {
+      const std::string_view engine{optarg};
+      if (engine == "libflac") {
+        options.engine = ::plac::Stream::Engine::libflac;
+      } else if (engine == "native") {
+        options.engine = ::plac::Stream::Engine::native;
+      } else {
+        ENSURES(false, "unknown decoder: {}", optarg);
+      }
+      break;
+    }
+    case 'r':
+      options.report = optarg;
+      break;
+    default:
+      ENSURES(false, "unknown option");
+      break;
+    }
+  }
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  ::plac::AsyncLog::Instance();
+  const Options options{ParseOptions(argc, argv)};
+
+  std::vector<std::string> names{argv + optind, argv + argc};
+  if (names.empty()) {
+    for (std::string line{}; std::getline(std::cin, line);) {
+      if (!line.empty()) {
+        names.push_back(line);
+      }
+    }
+  }
+
+  FILE *report{stdout};
+  if (!options.report.empty()) {
+    report = std::fopen(options.report.c_str(), "w");
+    if (report == nullptr) {
+      std::fprintf(stderr, "cannot open %s: %s\n", options.report.c_str(), ::strerror(errno));
+      return EXIT_FAILURE;
+    }
+  }
+
+  const ::plac::Verifier verifier{options.jobs, options.queue_depth, options.engine};
+  // flushed per file, so that an interrupted run still reports what it checked
+  const size_t failed{verifier.Verify(names, [report](const ::plac::VerifyResult &result) {
+    std::fputs(::plac::FormatVerifyResult(result).c_str(), report);
+    std::fflush(report);
+  })};
+  if ((report != stdout) && (std::fclose(report) != 0)) {
+    std::fprintf(stderr, "cannot write %s\n", options.report.c_str());
+    return EXIT_FAILURE;
+  }
+
+  std::fprintf(stderr, "%zu files, %zu failed\n", names.size(), failed);
+  return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
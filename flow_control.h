@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FLOW_CONTROL_H
+#define FLOW_CONTROL_H
+
+#include <atomic>
+
+namespace plac {
+
+// Signals progress between the producer and the consumer of an AudioBuffer.
+//
+// Each side notifies after it has moved data and waits on the sequence number
+// it observed before it found the buffer full (producer) or empty (consumer).
+// A notification in between is never lost since the wait returns as soon as
+// the sequence number differs. Built on futex based atomic waits, so Notify()
+// neither allocates nor takes a lock and is safe to call from the RT thread.
+class FlowControl {
+public:
+    unsigned int Sequence() const { return sequence_.load(std::memory_order_acquire); }
+
+    void Wait(const unsigned int sequence) const
+    {
+        sequence_.wait(sequence, std::memory_order_acquire);
+    }
+
+    void Notify()
+    {
+        sequence_.fetch_add(1U, std::memory_order_release);
+        sequence_.notify_all();
+    }
+
+    // producer has written its last frame
+    void Close()
+    {
+        closed_.store(true, std::memory_order_release);
+        Notify();
+    }
+    bool IsClosed() const { return closed_.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<unsigned int> sequence_{0};
+    std::atomic<bool> closed_{false};
+};
+
+} // namespace plac
+
+#endif
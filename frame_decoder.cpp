@@ -0,0 +1,398 @@
+// SPDX-License-Identifier: MIT
+
+#include "frame_decoder.h"
+#include "interleave.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <utility>
+
+namespace plac {
+
+namespace {
+
+// MSB first reader over a frame
+class BitReader {
+public:
+  BitReader(const std::span<const u_char> data, const size_t byte)
+      : data_{data}, position_{byte * 8} {}
+
+  // the next 64 bits, of which at least 57 are valid. zeros behind the end of data
+  uint64_t Peek() const {
+    const size_t byte{position_ >> 3U};
+    uint64_t word{0};
+    if (byte + sizeof(word) <= data_.size()) {
+      std::memcpy(&word, &data_[byte], sizeof(word));
+      if constexpr (std::endian::native == std::endian::little) {
+        word = __builtin_bswap64(word);
+      }
+    } else {
+      for (size_t i{byte}; i < byte + sizeof(word); ++i) {
+        word = (word << 8U) | ((i < data_.size()) ? data_[i] : 0U);
+      }
+    }
+    return word << (position_ & 7U);
+  }
+
+  void Skip(const size_t bits) { position_ += bits; }
+
+  // bits <= 32
+  uint32_t Read(const unsigned int bits) {
+    if (bits == 0) {
+      return 0;
+    }
+    const uint32_t value{static_cast<uint32_t>(Peek() >> (64U - bits))};
+    position_ += bits;
+    return value;
+  }
+
+  // two's complement, bits <= 32
+  int32_t ReadSigned(const unsigned int bits) {
+    if (bits == 0) {
+      return 0;
+    }
+    const int32_t value{static_cast<int32_t>(static_cast<int64_t>(Peek()) >> (64U - bits))};
+    position_ += bits;
+    return value;
+  }
+
+  // zeros up to the next one, which is consumed
+  uint32_t ReadUnary() {
+    uint32_t zeros{0};
+    while (!Overrun()) {
+      const unsigned int n{static_cast<unsigned int>(std::countl_zero(Peek()))};
+      if (n < 57) {
+        position_ += n + 1;
+        return zeros + n;
+      }
+      position_ += 56;
+      zeros += 56;
+    }
+    return zeros;
+  }
+
+  void Align() { position_ = (position_ + 7) & ~size_t{7}; }
+  size_t Byte() const { return position_ >> 3U; }
+  bool Overrun() const { return position_ > data_.size() * 8; }
+
+private:
+  std::span<const u_char> data_;
+  size_t position_;
+};
+
+int32_t Wrap(const uint32_t value) { return static_cast<int32_t>(value); }
+uint32_t Unwrap(const int32_t value) { return static_cast<uint32_t>(value); }
+
+// count values with Rice parameter k. one load and one count of leading zeros
+// per value unless the quotient is unusually long
+void ReadRice(BitReader &reader, const unsigned int k, int32_t *const out, const size_t count) {
+  for (size_t i{0}; i < count; ++i) {
+    const uint64_t word{reader.Peek()};
+    const unsigned int q{static_cast<unsigned int>(std::countl_zero(word))};
+    uint32_t u{0};
+    if (q + 1 + k <= 57) {
+      u = (q << k) | static_cast<uint32_t>(((word << (q + 1)) >> (63U - k)) >> 1U);
+      reader.Skip(q + 1 + k);
+    } else {
+      u = (reader.ReadUnary() << k) | reader.Read(k);
+    }
+    out[i] = Wrap((u >> 1U) ^ (0U - (u & 1U)));
+  }
+}
+
+// residual of the samples behind the warm-up samples
+bool ReadResidual(BitReader &reader, const size_t count, const size_t order, int32_t *out) {
+  const uint32_t method{reader.Read(2)};
+  if (method > 1) {
+    return false;
+  }
+  const unsigned int parameter_bits{(method == 0) ? 4U : 5U};
+  const uint32_t escape{(1U << parameter_bits) - 1};
+  const unsigned int partition_order{reader.Read(4)};
+  const size_t partition_samples{count >> partition_order};
+  if (((partition_samples << partition_order) != count) || (partition_samples < order)) {
+    return false;
+  }
+
+  for (size_t p{0}; p < (size_t{1} << partition_order); ++p) {
+    const size_t n{(p == 0) ? partition_samples - order : partition_samples};
+    const uint32_t parameter{reader.Read(parameter_bits)};
+    if (parameter == escape) {
+      const unsigned int bits{reader.Read(5)};
+      for (size_t i{0}; i < n; ++i) {
+        out[i] = reader.ReadSigned(bits);
+      }
+    } else {
+      ReadRice(reader, parameter, out, n);
+    }
+    out += n;
+    if (reader.Overrun()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+using RestoreLpcFn = void (*)(int32_t *samples, size_t count, const int32_t *coefficients,
+                              int shift);
+
+// Wide accumulates in 64 bits, otherwise the sum is known to fit into 32 bits.
+// the arithmetic wraps like libFLAC's on corrupt frames, which fail the CRC
+template <bool Wide, size_t Order>
+void RestoreLpc(int32_t *const samples, const size_t count, const int32_t *const coefficients,
+                const int shift) {
+  std::array<int32_t, Order> c{};
+  std::copy_n(coefficients, Order, c.begin());
+  for (size_t i{Order}; i < count; ++i) {
+    int32_t prediction{0};
+    if constexpr (Wide) {
+      int64_t sum{0};
+      for (size_t j{0}; j < Order; ++j) {
+        sum += int64_t{c[j]} * samples[i - 1 - j];
+      }
+      prediction = static_cast<int32_t>(sum >> shift);
+    } else {
+      uint32_t sum{0};
+      for (size_t j{0}; j < Order; ++j) {
+        sum += Unwrap(c[j]) * Unwrap(samples[i - 1 - j]);
+      }
+      prediction = Wrap(sum) >> shift;
+    }
+    samples[i] = Wrap(Unwrap(samples[i]) + Unwrap(prediction));
+  }
+}
+
+template <bool Wide, size_t... Orders>
+constexpr std::array<RestoreLpcFn, sizeof...(Orders)> MakeRestoreLpc(std::index_sequence<Orders...>) {
+  return {&RestoreLpc<Wide, Orders + 1>...};
+}
+
+// indexed by order - 1
+constexpr std::array<RestoreLpcFn, 32> kRestoreLpc{
+    MakeRestoreLpc<false>(std::make_index_sequence<32>{})};
+constexpr std::array<RestoreLpcFn, 32> kRestoreLpcWide{
+    MakeRestoreLpc<true>(std::make_index_sequence<32>{})};
+
+template <size_t Order> void RestoreFixed(int32_t *const samples, const size_t count) {
+  for (size_t i{Order}; i < count; ++i) {
+    uint32_t prediction{0};
+    if constexpr (Order == 1) {
+      prediction = Unwrap(samples[i - 1]);
+    } else if constexpr (Order == 2) {
+      prediction = 2 * Unwrap(samples[i - 1]) - Unwrap(samples[i - 2]);
+    } else if constexpr (Order == 3) {
+      prediction = 3 * Unwrap(samples[i - 1]) - 3 * Unwrap(samples[i - 2]) + Unwrap(samples[i - 3]);
+    } else if constexpr (Order == 4) {
+      prediction = 4 * Unwrap(samples[i - 1]) - 6 * Unwrap(samples[i - 2])
+                   + 4 * Unwrap(samples[i - 3]) - Unwrap(samples[i - 4]);
+    }
+    samples[i] = Wrap(Unwrap(samples[i]) + prediction);
+  }
+}
+
+void RestoreFixed(const size_t order, int32_t *const samples, const size_t count) {
+  switch (order) {
+  case 1:
+    RestoreFixed<1>(samples, count);
+    break;
+  case 2:
+    RestoreFixed<2>(samples, count);
+    break;
+  case 3:
+    RestoreFixed<3>(samples, count);
+    break;
+  case 4:
+    RestoreFixed<4>(samples, count);
+    break;
+  default:
+    break;
+  }
+}
+
+bool ReadSubframe(BitReader &reader, unsigned int bits, const size_t count, int32_t *const samples) {
+  if (reader.Read(1) != 0) {
+    return false;
+  }
+  const uint32_t type{reader.Read(6)};
+  unsigned int wasted{0};
+  if (reader.Read(1) != 0) {
+    wasted = reader.ReadUnary() + 1;
+    if (wasted >= bits) {
+      return false;
+    }
+    bits -= wasted;
+  }
+
+  if (type == 0) {
+    std::fill_n(samples, count, reader.ReadSigned(bits));
+  } else if (type == 1) {
+    for (size_t i{0}; i < count; ++i) {
+      samples[i] = reader.ReadSigned(bits);
+    }
+  } else if ((type >= 8) && (type <= 12)) {
+    const size_t order{type - 8};
+    if (order > count) {
+      return false;
+    }
+    for (size_t i{0}; i < order; ++i) {
+      samples[i] = reader.ReadSigned(bits);
+    }
+    if (!ReadResidual(reader, count, order, samples + order)) {
+      return false;
+    }
+    RestoreFixed(order, samples, count);
+  } else if (type >= 32) {
+    const size_t order{type - 31};
+    if (order > count) {
+      return false;
+    }
+    for (size_t i{0}; i < order; ++i) {
+      samples[i] = reader.ReadSigned(bits);
+    }
+    const unsigned int precision{reader.Read(4) + 1};
+    const int shift{reader.ReadSigned(5)};
+    if ((precision == 16) || (shift < 0)) {
+      return false;
+    }
+    std::array<int32_t, 32> coefficients{};
+    for (size_t i{0}; i < order; ++i) {
+      coefficients[i] = reader.ReadSigned(precision);
+    }
+    if (!ReadResidual(reader, count, order, samples + order)) {
+      return false;
+    }
+    // |sum| < order * 2^(bits - 1) * 2^(precision - 1)
+    const bool wide{bits + precision + static_cast<unsigned int>(std::bit_width(order)) - 1 > 32};
+    (wide ? kRestoreLpcWide : kRestoreLpc)[order - 1](samples, count, coefficients.data(), shift);
+  } else {
+    return false;
+  }
+
+  if (wasted != 0) {
+    for (size_t i{0}; i < count; ++i) {
+      samples[i] = Wrap(Unwrap(samples[i]) << wasted);
+    }
+  }
+  return !reader.Overrun();
+}
+
+template <size_t Bytes> void Store(u_char *const out, const int32_t value) {
+  const uint32_t v{Unwrap(value)};
+  out[0] = static_cast<u_char>(v);
+  out[1] = static_cast<u_char>(v >> 8U);
+  if constexpr (Bytes == 3) {
+    out[2] = static_cast<u_char>(v >> 16U);
+  }
+}
+
+// undoes the channel decorrelation while the samples are written out
+template <size_t Bytes, uint32_t Assignment>
+void PackStereo(const int32_t *const a, const int32_t *const b, const size_t count, u_char *out) {
+  for (size_t i{0}; i < count; ++i) {
+    int32_t left{0};
+    int32_t right{0};
+    if constexpr (Assignment == 8) {
+      // left, side
+      left = a[i];
+      right = a[i] - b[i];
+    } else if constexpr (Assignment == 9) {
+      // side, right
+      left = a[i] + b[i];
+      right = b[i];
+    } else {
+      // mid, side. the lowest bit of mid was dropped and equals the one of side
+      const int32_t side{b[i]};
+      const int32_t mid{Wrap((Unwrap(a[i]) << 1U) | (Unwrap(side) & 1U))};
+      left = (mid + side) >> 1;
+      right = (mid - side) >> 1;
+    }
+    Store<Bytes>(out, left);
+    Store<Bytes>(out + Bytes, right);
+    out += 2 * Bytes;
+  }
+}
+
+template <size_t Bytes>
+void Pack(const uint32_t assignment, const int32_t *const rows, const size_t stride,
+          const unsigned int channels, const size_t count, u_char *out) {
+  switch (assignment) {
+  case 8:
+    PackStereo<Bytes, 8>(rows, rows + stride, count, out);
+    return;
+  case 9:
+    PackStereo<Bytes, 9>(rows, rows + stride, count, out);
+    return;
+  case 10:
+    PackStereo<Bytes, 10>(rows, rows + stride, count, out);
+    return;
+  default:
+    break;
+  }
+  if (channels == 2) {
+    // independent stereo is what the interleave kernels are for
+    Interleave(AudioFormat{Bytes * 8, 2, 0}, rows, rows + stride, count, out);
+    return;
+  }
+  for (size_t i{0}; i < count; ++i) {
+    for (unsigned int c{0}; c < channels; ++c) {
+      Store<Bytes>(out, rows[c * stride + i]);
+      out += Bytes;
+    }
+  }
+}
+
+} // namespace
+
+bool FrameDecoder::Supports(const StreamInfo &info) {
+  return ((info.bits_ == 16) || (info.bits_ == 24)) && (info.channels_ >= 1)
+         && (info.channels_ <= 8) && (info.max_blocksize_ >= 16);
+}
+
+bool FrameDecoder::Reset(const StreamInfo &info) {
+  if (!Supports(info)) {
+    return false;
+  }
+  info_ = info;
+  frame_bytes_ = size_t{info.bits_ / 8} * info.channels_;
+  rows_.resize(size_t{info.max_blocksize_} * info.channels_);
+  return true;
+}
+
+size_t FrameDecoder::Decode(const std::span<const u_char> data, const FrameHeader &header,
+                            u_char *const out) {
+  const size_t count{header.blocksize_};
+  const size_t stride{info_.max_blocksize_};
+  if ((header.bits_ != info_.bits_) || (header.channels_ != info_.channels_) || (count > stride)) {
+    return 0;
+  }
+
+  BitReader reader{data, header.size_};
+  for (unsigned int c{0}; c < info_.channels_; ++c) {
+    // the side channel has one more bit
+    const bool side{((header.channel_assignment_ == 8) && (c == 1))
+                    || ((header.channel_assignment_ == 9) && (c == 0))
+                    || ((header.channel_assignment_ == 10) && (c == 1))};
+    if (!ReadSubframe(reader, info_.bits_ + (side ? 1 : 0), count, &rows_[c * stride])) {
+      return 0;
+    }
+  }
+  reader.Align();
+  const size_t end{reader.Byte()};
+  if (end + 2 > data.size()) {
+    return 0;
+  }
+  const uint16_t crc{static_cast<uint16_t>((data[end] << 8U) | data[end + 1])};
+  if (Crc16(data.first(end)) != crc) {
+    return 0;
+  }
+
+  if (info_.bits_ == 16) {
+    Pack<2>(header.channel_assignment_, rows_.data(), stride, info_.channels_, count, out);
+  } else {
+    Pack<3>(header.channel_assignment_, rows_.data(), stride, info_.channels_, count, out);
+  }
+  return end + 2;
+}
+
+} // namespace plac
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FRAME_DECODER_H
+#define FRAME_DECODER_H
+
+#include "flac_frame.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <sys/types.h>
+#include <vector>
+
+namespace plac {
+
+// Decodes FLAC frames of 16 and 24 bits streams with 1 to 8 channels into
+// interleaved little endian samples, i.e. S16_LE or S24_3LE.
+//
+// Subframes are restored into one int32 row per channel, since the predictors
+// need the previous samples. Decorrelation of the stereo modes is fused with
+// the packing into the output, so there is no separate repacking pass like
+// behind libFLAC.
+class FrameDecoder {
+public:
+  // false if the stream has a format which is not supported
+  static bool Supports(const StreamInfo &info);
+
+  // sizes the rows for the frames of a stream. false if it is not supported
+  bool Reset(const StreamInfo &info);
+
+  // decodes the frame which starts with header at the start of data into
+  // header.blocksize_ frames at out. returns the size of the frame including
+  // its CRC-16, 0 if it is corrupt or truncated
+  size_t Decode(std::span<const u_char> data, const FrameHeader &header, u_char *out);
+
+  // of the last Reset()
+  const StreamInfo &Info() const { return info_; }
+  // bytes per interleaved frame of the output
+  size_t FrameBytes() const { return frame_bytes_; }
+
+private:
+  StreamInfo info_{};
+  size_t frame_bytes_{0};
+  // channel c at [c * info_.max_blocksize_, (c + 1) * info_.max_blocksize_)
+  std::vector<int32_t> rows_{};
+};
+
+} // namespace plac
+
+#endif
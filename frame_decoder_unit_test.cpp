@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: MIT
+
+#include "frame_decoder.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace plac {
+namespace {
+
+// MSB first writer, the counterpart of the decoder's reader
+class BitWriter {
+public:
+  void Write(const uint64_t value, const unsigned int bits) {
+    for (unsigned int i{bits}; i > 0; --i) {
+      Bit(((value >> (i - 1)) & 1U) != 0);
+    }
+  }
+  void WriteSigned(const int64_t value, const unsigned int bits) {
+    Write(static_cast<uint64_t>(value), bits);
+  }
+  void WriteRice(const int32_t value, const unsigned int k) {
+    const uint32_t u{(static_cast<uint32_t>(value) << 1U) ^ static_cast<uint32_t>(value >> 31)};
+    for (uint32_t q{u >> k}; q > 0; --q) {
+      Bit(false);
+    }
+    Bit(true);
+    Write(u, k);
+  }
+  void Align() {
+    while (bits_ != 0) {
+      Bit(false);
+    }
+  }
+
+  std::vector<u_char> bytes_{};
+
+private:
+  void Bit(const bool bit) {
+    if (bits_ == 0) {
+      bytes_.push_back(0);
+    }
+    bytes_.back() |= static_cast<u_char>(bit ? (0x80U >> bits_) : 0U);
+    bits_ = (bits_ + 1) % 8;
+  }
+
+  unsigned int bits_{0};
+};
+
+StreamInfo Info(const unsigned int bits, const unsigned int channels) {
+  return StreamInfo{16, 4096, 44100, channels, bits, 0, {}};
+}
+
+// residual with one Rice parameter per partition, or escaped to raw bits
+void WriteResidual(BitWriter &w, const std::vector<int32_t> &residual, const size_t order,
+                   const unsigned int partition_order, const unsigned int parameter,
+                   const unsigned int escape_bits = 0) {
+  w.Write(1, 2);
+  w.Write(partition_order, 4);
+  const size_t count{residual.size() + order};
+  size_t i{0};
+  for (size_t p{0}; p < (size_t{1} << partition_order); ++p) {
+    const size_t n{(count >> partition_order) - ((p == 0) ? order : 0)};
+    if (escape_bits != 0) {
+      w.Write(31, 5);
+      w.Write(escape_bits, 5);
+      for (size_t j{0}; j < n; ++j) {
+        w.WriteSigned(residual[i++], escape_bits);
+      }
+    } else {
+      w.Write(parameter, 5);
+      for (size_t j{0}; j < n; ++j) {
+        w.WriteRice(residual[i++], parameter);
+      }
+    }
+  }
+}
+
+using SubframeWriter = std::function<void(BitWriter &, const std::vector<int32_t> &, unsigned int)>;
+
+void Verbatim(BitWriter &w, const std::vector<int32_t> &samples, const unsigned int bits) {
+  w.Write(0x02, 8);
+  for (const int32_t s : samples) {
+    w.WriteSigned(s, bits);
+  }
+}
+
+SubframeWriter Fixed(const size_t order, const unsigned int partition_order,
+                     const unsigned int escape_bits = 0) {
+  return [=](BitWriter &w, const std::vector<int32_t> &s, const unsigned int bits) {
+    w.Write((0x08 + order) << 1U, 8);
+    std::vector<int32_t> residual{};
+    for (size_t i{0}; i < s.size(); ++i) {
+      if (i < order) {
+        w.WriteSigned(s[i], bits);
+        continue;
+      }
+      // coefficients of the fixed predictors by order
+      constexpr int64_t kFixed[5][4]{{}, {1}, {2, -1}, {3, -3, 1}, {4, -6, 4, -1}};
+      int64_t prediction{0};
+      for (size_t j{0}; j < order; ++j) {
+        prediction += kFixed[order][j] * s[i - 1 - j];
+      }
+      residual.push_back(static_cast<int32_t>(s[i] - prediction));
+    }
+    WriteResidual(w, residual, order, partition_order, 14, escape_bits);
+  };
+}
+
+SubframeWriter Lpc(const std::vector<int32_t> &coefficients, const unsigned int precision,
+                   const int shift) {
+  return [=](BitWriter &w, const std::vector<int32_t> &s, const unsigned int bits) {
+    const size_t order{coefficients.size()};
+    w.Write((0x20 + order - 1) << 1U, 8);
+    for (size_t i{0}; i < order; ++i) {
+      w.WriteSigned(s[i], bits);
+    }
+    w.Write(precision - 1, 4);
+    w.WriteSigned(shift, 5);
+    for (const int32_t c : coefficients) {
+      w.WriteSigned(c, precision);
+    }
+    std::vector<int32_t> residual{};
+    for (size_t i{order}; i < s.size(); ++i) {
+      int64_t sum{0};
+      for (size_t j{0}; j < order; ++j) {
+        sum += int64_t{coefficients[j]} * s[i - 1 - j];
+      }
+      residual.push_back(static_cast<int32_t>(s[i] - (sum >> shift)));
+    }
+    WriteResidual(w, residual, order, 2, 20);
+  };
+}
+
+// a frame of blocksize samples per channel with an explicit 16 bits blocksize
+// and the rate and bits of STREAMINFO
+std::vector<u_char> MakeFrame(const std::vector<std::vector<int32_t>> &rows,
+                              const unsigned int channel_code, const unsigned int bits,
+                              const std::vector<SubframeWriter> &writers, FrameHeader &header) {
+  const size_t blocksize{rows[0].size()};
+  BitWriter w{};
+  w.Write(0xFFF8, 16);
+  w.Write(0x70, 8);
+  w.Write(channel_code << 4U, 8);
+  w.Write(0, 8);
+  w.Write(blocksize - 1, 16);
+  w.Write(Crc8(w.bytes_), 8);
+  header = FrameHeader{static_cast<uint32_t>(blocksize),
+                       44100,
+                       static_cast<uint32_t>(rows.size()),
+                       (channel_code >= 8) ? channel_code : 0,
+                       bits,
+                       false,
+                       0,
+                       0,
+                       w.bytes_.size()};
+  for (size_t c{0}; c < rows.size(); ++c) {
+    const bool side{((channel_code == 8) && (c == 1)) || ((channel_code == 9) && (c == 0))
+                    || ((channel_code == 10) && (c == 1))};
+    writers[c](w, rows[c], bits + (side ? 1 : 0));
+  }
+  w.Align();
+  w.Write(Crc16(w.bytes_), 16);
+  return w.bytes_;
+}
+
+std::vector<int32_t> Signal(const size_t count, const unsigned int bits, const uint32_t seed) {
+  std::vector<int32_t> s(count);
+  uint32_t lcg{seed};
+  const int32_t limit{(1 << (bits - 2)) - 1};
+  int32_t value{0};
+  for (int32_t &x : s) {
+    lcg = lcg * 1664525U + 1013904223U;
+    value = std::clamp(value + static_cast<int32_t>(lcg >> 20U) - 2048, -limit, limit);
+    x = value;
+  }
+  return s;
+}
+
+std::vector<u_char> Pack(const std::vector<std::vector<int32_t>> &channels, const unsigned int bits) {
+  std::vector<u_char> out{};
+  for (size_t i{0}; i < channels[0].size(); ++i) {
+    for (const std::vector<int32_t> &c : channels) {
+      for (unsigned int b{0}; b < bits; b += 8) {
+        out.push_back(static_cast<u_char>(static_cast<uint32_t>(c[i]) >> b));
+      }
+    }
+  }
+  return out;
+}
+
+class FrameDecoderTest : public ::testing::TestWithParam<unsigned int> {
+protected:
+  // encodes left and right with the given stereo mode and decodes them again
+  void ExpectStereo(const unsigned int channel_code, const std::vector<SubframeWriter> &writers) {
+    const unsigned int bits{GetParam()};
+    const std::vector<int32_t> left{Signal(1024, bits, 1)};
+    const std::vector<int32_t> right{Signal(1024, bits, 2)};
+    std::vector<std::vector<int32_t>> rows{left, right};
+    for (size_t i{0}; i < left.size(); ++i) {
+      if (channel_code == 8) {
+        rows[1][i] = left[i] - right[i];
+      } else if (channel_code == 9) {
+        rows[0][i] = left[i] - right[i];
+      } else if (channel_code == 10) {
+        rows[0][i] = (left[i] + right[i]) >> 1;
+        rows[1][i] = left[i] - right[i];
+      }
+    }
+    FrameHeader header{};
+    const std::vector<u_char> frame{MakeFrame(rows, channel_code, bits, writers, header)};
+
+    FrameDecoder decoder{};
+    ASSERT_TRUE(decoder.Reset(Info(bits, 2)));
+    std::vector<u_char> out(1024 * decoder.FrameBytes());
+    ASSERT_EQ(frame.size(), decoder.Decode(frame, header, out.data()));
+    EXPECT_EQ(Pack({left, right}, bits), out);
+  }
+};
+
+TEST_P(FrameDecoderTest, Verbatim) { ExpectStereo(1, {Verbatim, Verbatim}); }
+
+TEST_P(FrameDecoderTest, FixedOrders) {
+  for (size_t order{0}; order <= 4; ++order) {
+    ExpectStereo(1, {Fixed(order, 0), Fixed(order, 3)});
+  }
+}
+
+TEST_P(FrameDecoderTest, Escaped) { ExpectStereo(1, {Fixed(2, 2, 30), Fixed(1, 0, 31)}); }
+
+TEST_P(FrameDecoderTest, Lpc) {
+  ExpectStereo(1, {Lpc({1800, -800}, 12, 10), Lpc({900, 300, -250, 80, -20, 10, -5, 2}, 14, 10)});
+  // long predictors with wide coefficients need 64 bits sums
+  std::vector<int32_t> wide(32, 3);
+  wide[0] = 16000;
+  ExpectStereo(1, {Lpc(wide, 15, 14), Lpc({4096}, 15, 12)});
+}
+
+TEST_P(FrameDecoderTest, StereoModes) {
+  for (const unsigned int code : {8U, 9U, 10U}) {
+    ExpectStereo(code, {Fixed(2, 1), Lpc({1200, -300}, 12, 10)});
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Bits, FrameDecoderTest, ::testing::Values(16U, 24U));
+
+TEST(FrameDecoderConstantTest, ConstantWithWastedBits) {
+  BitWriter w{};
+  w.Write(0xFFF8, 16);
+  w.Write(0x70, 8);
+  w.Write(0x00, 8);
+  w.Write(0, 8);
+  w.Write(15, 16);
+  w.Write(Crc8(w.bytes_), 8);
+  const size_t header_size{w.bytes_.size()};
+  // constant -3 with 2 wasted bits, i.e. -12
+  w.Write(0x01, 8);
+  w.Write(0b01, 2);
+  w.WriteSigned(-3, 14);
+  w.Align();
+  w.Write(Crc16(w.bytes_), 16);
+
+  FrameDecoder decoder{};
+  ASSERT_TRUE(decoder.Reset(Info(16, 1)));
+  const FrameHeader header{16, 44100, 1, 0, 16, false, 0, 0, header_size};
+  std::vector<u_char> out(16 * 2);
+  ASSERT_EQ(w.bytes_.size(), decoder.Decode(w.bytes_, header, out.data()));
+  for (size_t i{0}; i < 16; ++i) {
+    EXPECT_EQ(0xF4, out[2 * i]);
+    EXPECT_EQ(0xFF, out[2 * i + 1]);
+  }
+}
+
+TEST(FrameDecoderConstantTest, RejectCorruptFrame) {
+  const std::vector<int32_t> samples{Signal(256, 16, 3)};
+  FrameHeader header{};
+  std::vector<u_char> frame{MakeFrame({samples}, 0, 16, {Fixed(2, 2)}, header)};
+
+  FrameDecoder decoder{};
+  ASSERT_TRUE(decoder.Reset(Info(16, 1)));
+  std::vector<u_char> out(256 * 2);
+  frame[frame.size() / 2] ^= 0x10U;
+  EXPECT_EQ(0, decoder.Decode(frame, header, out.data()));
+  // truncated
+  EXPECT_EQ(0, decoder.Decode(std::span<const u_char>{frame}.first(frame.size() - 1), header,
+                              out.data()));
+}
+
+TEST(FrameDecoderConstantTest, Supports) {
+  EXPECT_TRUE(FrameDecoder::Supports(Info(16, 2)));
+  EXPECT_TRUE(FrameDecoder::Supports(Info(24, 6)));
+  EXPECT_FALSE(FrameDecoder::Supports(Info(20, 2)));
+  EXPECT_FALSE(FrameDecoder::Supports(Info(16, 9)));
+}
+
+} // namespace
+} // namespace plac
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: MIT
+
+#include "frame_index.h"
+#include "cache_file.h"
+#include "conditions.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <span>
+#include <sys/stat.h>
+
+namespace plac {
+
+namespace {
+
+// local cache, so the file is in native byte order
+struct Header {
+  std::array<char, 8> magic_;
+  FrameIndex::Key key_;
+  uint64_t count_;
+  uint64_t complete_;
+};
+
+constexpr std::array<char, 8> kMagic{'P', 'L', 'A', 'C', 'I', 'D', 'X', '1'};
+
+// FNV-1a
+uint64_t Hash(const std::string_view s) {
+  uint64_t h{14695981039346656037ULL};
+  for (const char c : s) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+FrameIndex::Key KeyOf(const struct stat &st) {
+  return {static_cast<uint64_t>(st.st_size),
+          static_cast<int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec};
+}
+
+} // namespace
+
+void FrameIndex::Add(const uint64_t sample, const uint64_t offset) {
+  const auto it{std::lower_bound(entries_.begin(), entries_.end(), sample,
+                                 [](const Entry &e, const uint64_t s) { return e.sample_ < s; })};
+  if ((it != entries_.end()) && (it->sample_ == sample)) {
+    return;
+  }
+  entries_.insert(it, Entry{sample, offset});
+}
+
+std::optional<FrameIndex::Entry> FrameIndex::Find(const uint64_t sample) const {
+  const auto it{std::upper_bound(entries_.begin(), entries_.end(), sample,
+                                 [](const uint64_t s, const Entry &e) { return s < e.sample_; })};
+  if (it == entries_.begin()) {
+    return std::nullopt;
+  }
+  return *(it - 1);
+}
+
+bool FrameIndex::Save(const std::string &path, const Key &key) const {
+  const Header header{kMagic, key, entries_.size(), complete_ ? 1U : 0U};
+  return WriteFileAtomically(path, {std::as_bytes(std::span{&header, 1}),
+                                    std::as_bytes(std::span{entries_})});
+}
+
+std::optional<FrameIndex> FrameIndex::Load(const std::string &path, const Key &key) {
+  FILE *f{std::fopen(path.c_str(), "rb")};
+  if (f == nullptr) {
+    return std::nullopt;
+  }
+  std::optional<FrameIndex> index{};
+  Header header{};
+  // bounds the allocation if the file is corrupt
+  constexpr uint64_t kMaxEntries{1U << 24U};
+  if ((std::fread(&header, sizeof(header), 1, f) == 1) && (header.magic_ == kMagic)
+      && (header.key_ == key) && (header.count_ <= kMaxEntries)) {
+    FrameIndex loaded{};
+    loaded.entries_.resize(header.count_);
+    loaded.complete_ = header.complete_ != 0;
+    if (std::fread(loaded.entries_.data(), sizeof(Entry), loaded.entries_.size(), f)
+        == loaded.entries_.size()) {
+      index = std::move(loaded);
+    }
+  }
+  std::fclose(f);
+  return index;
+}
+
+std::optional<FrameIndex::Key> MakeFrameIndexKey(const int fd) {
+  struct stat st {};
+  if (::fstat(fd, &st) != 0) {
+    return std::nullopt;
+  }
+  return KeyOf(st);
+}
+
+std::optional<FrameIndex::Key> MakeFrameIndexKey(const std::string &path) {
+  struct stat st {};
+  if (::stat(path.c_str(), &st) != 0) {
+    return std::nullopt;
+  }
+  return KeyOf(st);
+}
+
+std::string DefaultFrameIndexDir() {
+  const std::string dir{CacheDir()};
+  return dir.empty() ? dir : dir + "/index";
+}
+
+std::string FrameIndexPath(const std::string &dir, const char *name) {
+  std::error_code ec{};
+  const std::filesystem::path absolute{std::filesystem::absolute(name, ec)};
+  if (ec) {
+    return {};
+  }
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    LOG_ERROR("cannot create {}: {}", dir, ec.message());
+    return {};
+  }
+  return std::format("{}/{:016x}.idx", dir, Hash(absolute.lexically_normal().string()));
+}
+
+} // namespace plac
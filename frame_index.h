@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef FRAME_INDEX_H
+#define FRAME_INDEX_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace plac {
+
+// Byte offsets of FLAC frames by their first sample, sorted by sample.
+//
+// It is built from the SEEKTABLE, which lists some frames, or while a file is
+// played from the start, which lists every frame. A complete index is kept in
+// a cache directory so that later seeks in the same file need no search.
+struct FrameIndex {
+  struct Entry {
+    uint64_t sample_;
+    // relative to the first frame, like in the SEEKTABLE
+    uint64_t offset_;
+
+    bool operator==(const Entry &) const = default;
+  };
+
+  // identity of the indexed file. the index is stale if the file changed
+  struct Key {
+    uint64_t size_;
+    int64_t mtime_ns_;
+
+    bool operator==(const Key &) const = default;
+  };
+
+  // keeps the entries sorted. an entry for a known sample is ignored
+  void Add(const uint64_t sample, const uint64_t offset);
+  // the frame which contains sample, or the closest one before it. empty if
+  // sample precedes every entry
+  std::optional<Entry> Find(const uint64_t sample) const;
+
+  // written to a temporary file which is renamed to path
+  bool Save(const std::string &path, const Key &key) const;
+  // empty if path does not hold an index for key
+  static std::optional<FrameIndex> Load(const std::string &path, const Key &key);
+
+  std::vector<Entry> entries_{};
+  // every frame of the file is listed
+  bool complete_{false};
+};
+
+// key of the file open as fd. empty if it cannot be stat'ed
+std::optional<FrameIndex::Key> MakeFrameIndexKey(const int fd);
+// key of the file at path, without opening it. empty if it cannot be stat'ed
+std::optional<FrameIndex::Key> MakeFrameIndexKey(const std::string &path);
+
+// $XDG_CACHE_HOME/plac/index, or ~/.cache/plac/index. empty if neither is set
+std::string DefaultFrameIndexDir();
+
+// file in dir which holds the index of name, derived from its absolute path.
+// creates dir. empty on failure
+std::string FrameIndexPath(const std::string &dir, const char *name);
+
+} // namespace plac
+
+#endif
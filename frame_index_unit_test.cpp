@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MIT
+
+#include "frame_index.h"
+#include "file_desc.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+
+namespace plac {
+namespace {
+
+TEST(FrameIndexTest, Find) {
+  FrameIndex index{};
+  EXPECT_FALSE(index.Find(0));
+
+  index.Add(4096, 1000);
+  index.Add(0, 0);
+  index.Add(8192, 2100);
+  index.Add(4096, 999);
+
+  ASSERT_EQ(3, index.entries_.size());
+  EXPECT_EQ((FrameIndex::Entry{0, 0}), index.Find(0));
+  EXPECT_EQ((FrameIndex::Entry{0, 0}), index.Find(4095));
+  EXPECT_EQ((FrameIndex::Entry{4096, 1000}), index.Find(4096));
+  EXPECT_EQ((FrameIndex::Entry{8192, 2100}), index.Find(100000));
+}
+
+class FrameIndexFileTest : public ::testing::Test {
+protected:
+  void TearDown() override { std::remove(kName); }
+
+  static constexpr const char *kName{"frame_index_unit_test.idx"};
+  static constexpr FrameIndex::Key kKey{123456, 789};
+};
+
+TEST_F(FrameIndexFileTest, SaveAndLoad) {
+  FrameIndex index{};
+  index.Add(0, 0);
+  index.Add(4096, 1000);
+  index.complete_ = true;
+  ASSERT_TRUE(index.Save(kName, kKey));
+
+  const std::optional<FrameIndex> loaded{FrameIndex::Load(kName, kKey)};
+  ASSERT_TRUE(loaded);
+  EXPECT_EQ(index.entries_, loaded->entries_);
+  EXPECT_TRUE(loaded->complete_);
+}
+
+TEST_F(FrameIndexFileTest, LoadWhenFileChanged) {
+  FrameIndex index{};
+  index.Add(0, 0);
+  ASSERT_TRUE(index.Save(kName, kKey));
+
+  EXPECT_FALSE(FrameIndex::Load(kName, FrameIndex::Key{123456, 790}));
+  EXPECT_FALSE(FrameIndex::Load(kName, FrameIndex::Key{123457, 789}));
+}
+
+TEST_F(FrameIndexFileTest, LoadWhenMissing) {
+  EXPECT_FALSE(FrameIndex::Load("does_not_exist.idx", kKey));
+}
+
+TEST(FrameIndexPathTest, PerFile) {
+  constexpr const char *kDir{"frame_index_unit_test_dir"};
+  const std::string a{FrameIndexPath(kDir, "a.flac")};
+  EXPECT_FALSE(a.empty());
+  EXPECT_TRUE(std::filesystem::is_directory(kDir));
+  EXPECT_EQ(a, FrameIndexPath(kDir, "./a.flac"));
+  EXPECT_NE(a, FrameIndexPath(kDir, "b.flac"));
+  std::filesystem::remove_all(kDir);
+}
+
+TEST(FrameIndexKeyTest, InvalidFileDesc) { EXPECT_FALSE(MakeFrameIndexKey(-1)); }
+
+TEST(FrameIndexKeyTest, PathMatchesFileDesc) {
+  const std::string name{"frame_index_unit_test.key"};
+  std::ofstream{name} << "key";
+  const FileDesc desc{name.c_str()};
+  ASSERT_TRUE(desc.IsValid());
+  const std::optional<FrameIndex::Key> key{MakeFrameIndexKey(name)};
+  ASSERT_TRUE(key);
+  EXPECT_EQ(MakeFrameIndexKey(desc.fd_), key);
+  EXPECT_FALSE(MakeFrameIndexKey(std::string{"frame_index_unit_test_missing"}));
+  std::remove(name.c_str());
+}
+
+} // namespace
+} // namespace plac
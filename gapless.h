@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef GAPLESS_H
+#define GAPLESS_H
+
+#include "stream.h"
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <span>
+#include <utility>
+
+namespace plac {
+
+struct GaplessStats {
+  size_t tracks{0};
+  // longest time between the end of one track and the start of the next on the decode thread
+  std::chrono::nanoseconds max_handover{0};
+};
+
+// Decodes names in order with two Streams. While one stream decodes, the other
+// one opens the next entry and parses its metadata on a helper thread, so the
+// hand-over between tracks is a pointer swap. The helper also decodes the
+// first frame with WarmUp(). Entries which cannot be opened or warmed up are
+// skipped.
+//
+// start is called with each stream right before it decodes. it returns false
+// to stop playback, e.g. if the audio format changes.
+template <typename F>
+GaplessStats PlayGapless(Stream &first, Stream &second, const std::span<const char *const> names,
+                         F &&start) {
+    size_t i{0};
+    auto prepare = [&names, &i](Stream *stream) {
+        while (i < names.size()) {
+            if (stream->Reset(names[i++]) && stream->WarmUp()) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    GaplessStats stats{};
+    Stream *current{&first};
+    Stream *next{&second};
+    bool ready{prepare(current)};
+    auto finished{std::chrono::steady_clock::now()};
+    while (ready) {
+        // i is only touched by the helper until get() returns
+        std::future<bool> prepared{std::async(std::launch::async, prepare, next)};
+        if (!std::forward<F>(start)(*current)) {
+            break;
+        }
+        if (stats.tracks != 0) {
+            stats.max_handover
+                = std::max(stats.max_handover, std::chrono::steady_clock::now() - finished);
+        }
+        ++stats.tracks;
+
+        current->Decode();
+        finished = std::chrono::steady_clock::now();
+
+        ready = prepared.get();
+        std::swap(current, next);
+    }
+
+    return stats;
+}
+
+} // namespace plac
+
+#endif
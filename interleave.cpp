@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: MIT
+
+#include "interleave.h"
+#include <array>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace plac {
+
+namespace {
+
+void Scalar16Bit(const int *const left, const int *const right, const size_t frames,
+                 u_char *data) {
+    for (size_t i{0}; i < frames; ++i) {
+        std::uint32_t interleaved{static_cast<std::uint32_t>(right[i])};
+        interleaved <<= 16;
+        interleaved |= static_cast<std::uint32_t>(left[i]) & 0xFFFF;
+        __builtin_memcpy(data, &interleaved, 4);
+        data += 4;
+    }
+}
+
+void Scalar24Bit(const int *const left, const int *const right, const size_t frames,
+                 u_char *data) {
+    for (size_t i{0}; i < frames; ++i) {
+        std::uint64_t interleaved{static_cast<std::uint32_t>(right[i])};
+        interleaved <<= 24;
+        interleaved |= static_cast<std::uint64_t>(left[i]) & 0xFFFFFF;
+        __builtin_memcpy(data, &interleaved, 6);
+        data += 6;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// 4 frames per iteration. (right << 16) | (left & 0xFFFF) per lane is already
+// the S16_LE frame. only SSE2 instructions, but the kernel is selected together
+// with Ssse3_24Bit, which needs pshufb, so it is built for SSSE3 as well.
+__attribute__((target("ssse3"))) void Ssse3_16Bit(const int *const left, const int *const right,
+                                                  const size_t frames, u_char *data) {
+    const __m128i mask{_mm_set1_epi32(0xFFFF)};
+    size_t i{0};
+    for (; (i + 4) <= frames; i += 4) {
+        const __m128i l{_mm_loadu_si128(reinterpret_cast<const __m128i *>(&left[i]))};
+        const __m128i r{_mm_loadu_si128(reinterpret_cast<const __m128i *>(&right[i]))};
+        const __m128i v{_mm_or_si128(_mm_slli_epi32(r, 16), _mm_and_si128(l, mask))};
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data), v);
+        data += 16;
+    }
+    Scalar16Bit(&left[i], &right[i], frames - i, data);
+}
+
+// 4 frames per iteration. pshufb drops the upper byte of each sample.
+__attribute__((target("ssse3"))) void Ssse3_24Bit(const int *const left, const int *const right,
+                                                  const size_t frames, u_char *data) {
+    const __m128i pack{_mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1)};
+    const __m128i tail{_mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 1, 2, 4)};
+    const __m128i rest{_mm_setr_epi8(5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, -1, -1, -1, -1)};
+    size_t i{0};
+    for (; (i + 4) <= frames; i += 4) {
+        const __m128i l{_mm_loadu_si128(reinterpret_cast<const __m128i *>(&left[i]))};
+        const __m128i r{_mm_loadu_si128(reinterpret_cast<const __m128i *>(&right[i]))};
+        const __m128i a{_mm_unpacklo_epi32(l, r)}; // l0 r0 l1 r1
+        const __m128i b{_mm_unpackhi_epi32(l, r)}; // l2 r2 l3 r3
+        const __m128i v0{_mm_or_si128(_mm_shuffle_epi8(a, pack), _mm_shuffle_epi8(b, tail))};
+        const __m128i v1{_mm_shuffle_epi8(b, rest)};
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data), v0);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(data + 16), v1);
+        data += 24;
+    }
+    Scalar24Bit(&left[i], &right[i], frames - i, data);
+}
+
+// 8 frames per iteration
+__attribute__((target("avx2"))) void Avx2_16Bit(const int *const left, const int *const right,
+                                                const size_t frames, u_char *data) {
+    const __m256i mask{_mm256_set1_epi32(0xFFFF)};
+    size_t i{0};
+    for (; (i + 8) <= frames; i += 8) {
+        const __m256i l{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(&left[i]))};
+        const __m256i r{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(&right[i]))};
+        const __m256i v{_mm256_or_si256(_mm256_slli_epi32(r, 16), _mm256_and_si256(l, mask))};
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data), v);
+        data += 32;
+    }
+    Ssse3_16Bit(&left[i], &right[i], frames - i, data);
+}
+
+// 8 frames per iteration. pshufb packs 2 frames into the lower 3 dwords of each
+// lane, the permutes then close the gaps across lanes.
+__attribute__((target("avx2"))) void Avx2_24Bit(const int *const left, const int *const right,
+                                                const size_t frames, u_char *data) {
+    const __m256i pack{_mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, //
+                                        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1)};
+    const __m256i lo_a{_mm256_setr_epi32(0, 1, 2, 0, 0, 0, 4, 5)};
+    const __m256i lo_b{_mm256_setr_epi32(0, 0, 0, 0, 1, 2, 0, 0)};
+    const __m256i hi_a{_mm256_setr_epi32(6, 0, 0, 0, 0, 0, 0, 0)};
+    const __m256i hi_b{_mm256_setr_epi32(0, 4, 5, 6, 0, 0, 0, 0)};
+    size_t i{0};
+    for (; (i + 8) <= frames; i += 8) {
+        const __m256i l{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(&left[i]))};
+        const __m256i r{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(&right[i]))};
+        // frames 0, 1 | 4, 5
+        const __m256i a{_mm256_shuffle_epi8(_mm256_unpacklo_epi32(l, r), pack)};
+        // frames 2, 3 | 6, 7
+        const __m256i b{_mm256_shuffle_epi8(_mm256_unpackhi_epi32(l, r), pack)};
+        const __m256i v0{_mm256_blend_epi32(_mm256_permutevar8x32_epi32(a, lo_a),
+                                            _mm256_permutevar8x32_epi32(b, lo_b), 0b00111000)};
+        const __m256i v1{_mm256_blend_epi32(_mm256_permutevar8x32_epi32(a, hi_a),
+                                            _mm256_permutevar8x32_epi32(b, hi_b), 0b00001110)};
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data), v0);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + 32), _mm256_castsi256_si128(v1));
+        data += 48;
+    }
+    Ssse3_24Bit(&left[i], &right[i], frames - i, data);
+}
+
+#elif defined(__ARM_NEON)
+
+// 8 frames per iteration. vmovn keeps the lower 16 bits, vst2 interleaves.
+void Neon16Bit(const int *const left, const int *const right, const size_t frames, u_char *data) {
+    size_t i{0};
+    for (; (i + 8) <= frames; i += 8) {
+        int16x8x2_t v;
+        v.val[0] = vcombine_s16(vmovn_s32(vld1q_s32(&left[i])), vmovn_s32(vld1q_s32(&left[i + 4])));
+        v.val[1]
+            = vcombine_s16(vmovn_s32(vld1q_s32(&right[i])), vmovn_s32(vld1q_s32(&right[i + 4])));
+        vst2q_s16(reinterpret_cast<int16_t *>(data), v);
+        data += 32;
+    }
+    Scalar16Bit(&left[i], &right[i], frames - i, data);
+}
+
+// 16 frames per iteration. vld4 splits the samples into byte planes, the upper
+// plane is dropped and vst3 writes the lower three planes interleaved.
+void Neon24Bit(const int *const left, const int *const right, const size_t frames, u_char *data) {
+    size_t i{0};
+    for (; (i + 16) <= frames; i += 16) {
+        const uint8x16x4_t l{vld4q_u8(reinterpret_cast<const uint8_t *>(&left[i]))};
+        const uint8x16x4_t r{vld4q_u8(reinterpret_cast<const uint8_t *>(&right[i]))};
+        const uint8x16x2_t b0{vzipq_u8(l.val[0], r.val[0])};
+        const uint8x16x2_t b1{vzipq_u8(l.val[1], r.val[1])};
+        const uint8x16x2_t b2{vzipq_u8(l.val[2], r.val[2])};
+        const uint8x16x3_t lo{{b0.val[0], b1.val[0], b2.val[0]}};
+        const uint8x16x3_t hi{{b0.val[1], b1.val[1], b2.val[1]}};
+        vst3q_u8(data, lo);
+        vst3q_u8(data + 48, hi);
+        data += 96;
+    }
+    Scalar24Bit(&left[i], &right[i], frames - i, data);
+}
+
+#endif
+
+std::span<const InterleaveKernels> Available() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const std::array<InterleaveKernels, 3> kernels{{
+        {"scalar", Scalar16Bit, Scalar24Bit},
+        {"ssse3", Ssse3_16Bit, Ssse3_24Bit},
+        {"avx2", Avx2_16Bit, Avx2_24Bit},
+    }};
+    // __builtin_cpu_supports() may run before the constructors of libgcc
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return kernels;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        return std::span{kernels}.first(2);
+    }
+    return std::span{kernels}.first(1);
+#elif defined(__ARM_NEON)
+    static const std::array<InterleaveKernels, 2> kernels{{
+        {"scalar", Scalar16Bit, Scalar24Bit},
+        {"neon", Neon16Bit, Neon24Bit},
+    }};
+    return kernels;
+#else
+    static const std::array<InterleaveKernels, 1> kernels{{
+        {"scalar", Scalar16Bit, Scalar24Bit},
+    }};
+    return kernels;
+#endif
+}
+
+} // namespace
+
+std::span<const InterleaveKernels> GetAvailableInterleaveKernels() {
+    static const std::span<const InterleaveKernels> available{Available()};
+    return available;
+}
+
+const InterleaveKernels &GetInterleaveKernels() {
+    static const InterleaveKernels &selected{GetAvailableInterleaveKernels().back()};
+    return selected;
+}
+
+} // namespace plac
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef INTERLEAVE_H
+#define INTERLEAVE_H
+
+#include "audio_format.h"
+#include <cstddef>
+#include <span>
+#include <sys/types.h>
+
+namespace plac {
+
+// Packs planar left/right samples into interleaved little endian frames.
+// S16_LE takes the lower 16 bits and S24_3LE the lower 24 bits of each sample.
+using InterleaveFn = void (*)(const int *left, const int *right, size_t frames, u_char *data);
+
+struct InterleaveKernels {
+  const char *name;
+  InterleaveFn s16;
+  InterleaveFn s24;
+};
+
+// all variants supported by the running CPU. the first entry is the scalar reference.
+std::span<const InterleaveKernels> GetAvailableInterleaveKernels();
+
+// fastest variant, selected once at startup
+const InterleaveKernels &GetInterleaveKernels();
+
+inline void Interleave(const AudioFormat format, const int *const left, const int *const right,
+                       const size_t frames, u_char *const data) {
+    if (format.bits == 16) {
+        GetInterleaveKernels().s16(left, right, frames, data);
+    } else if (format.bits == 24) {
+        GetInterleaveKernels().s24(left, right, frames, data);
+    }
+}
+
+template <unsigned int Bits, unsigned int Channels>
+void Interleave(FixedFormat<Bits, Channels>, const int *const left, const int *const right,
+                const size_t frames, u_char *const data) {
+    static_assert(Channels == 2, "only stereo is interleaved");
+    if constexpr (Bits == 16) {
+        GetInterleaveKernels().s16(left, right, frames, data);
+    } else {
+        static_assert(Bits == 24, "only 16 and 24 bits are interleaved");
+        GetInterleaveKernels().s24(left, right, frames, data);
+    }
+}
+
+} // namespace plac
+
+#endif
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+
+#include "interleave.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace plac {
+namespace {
+
+class InterleaveTest : public ::testing::TestWithParam<size_t> {
+protected:
+  void SetUp() override {
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> dist{};
+    left_.resize(kFrames);
+    right_.resize(kFrames);
+    for (size_t i{0}; i < kFrames; ++i) {
+      left_[i] = dist(gen);
+      right_[i] = dist(gen);
+    }
+  }
+
+  const InterleaveKernels &Reference() const { return GetAvailableInterleaveKernels().front(); }
+
+  // covers the vector body as well as all tail lengths
+  static constexpr size_t kFrames{133};
+  std::vector<int> left_;
+  std::vector<int> right_;
+};
+
+TEST(InterleaveReferenceTest, Scalar16Bit) {
+  const int left[]{0x12345678, -1};
+  const int right[]{0x0000ABCD, 0x7FFF};
+  u_char data[8]{};
+
+  GetAvailableInterleaveKernels().front().s16(left, right, 2, data);
+
+  EXPECT_EQ((std::vector<u_char>{0x78, 0x56, 0xCD, 0xAB, 0xFF, 0xFF, 0xFF, 0x7F}),
+            (std::vector<u_char>{std::begin(data), std::end(data)}));
+}
+
+TEST(InterleaveReferenceTest, Scalar24Bit) {
+  const int left[]{0x12345678, -1};
+  const int right[]{0x00ABCDEF, 0x7FFFFF};
+  u_char data[12]{};
+
+  GetAvailableInterleaveKernels().front().s24(left, right, 2, data);
+
+  EXPECT_EQ(
+      (std::vector<u_char>{0x78, 0x56, 0x34, 0xEF, 0xCD, 0xAB, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F}),
+      (std::vector<u_char>{std::begin(data), std::end(data)}));
+}
+
+TEST(InterleaveReferenceTest, SelectedIsAvailable) {
+  const auto available = GetAvailableInterleaveKernels();
+  ASSERT_FALSE(available.empty());
+  EXPECT_EQ(&available.back(), &GetInterleaveKernels());
+}
+
+TEST_P(InterleaveTest, SameAsReference16Bit) {
+  const InterleaveKernels &kernels{GetAvailableInterleaveKernels()[GetParam()]};
+  for (size_t frames{0}; frames <= kFrames; ++frames) {
+    std::vector<u_char> expected(frames * 4 + 1, 0xAA);
+    std::vector<u_char> actual(frames * 4 + 1, 0xAA);
+
+    Reference().s16(left_.data(), right_.data(), frames, expected.data());
+    kernels.s16(left_.data(), right_.data(), frames, actual.data());
+
+    ASSERT_EQ(expected, actual) << kernels.name << " with " << frames << " frames";
+  }
+}
+
+TEST_P(InterleaveTest, SameAsReference24Bit) {
+  const InterleaveKernels &kernels{GetAvailableInterleaveKernels()[GetParam()]};
+  for (size_t frames{0}; frames <= kFrames; ++frames) {
+    std::vector<u_char> expected(frames * 6 + 1, 0xAA);
+    std::vector<u_char> actual(frames * 6 + 1, 0xAA);
+
+    Reference().s24(left_.data(), right_.data(), frames, expected.data());
+    kernels.s24(left_.data(), right_.data(), frames, actual.data());
+
+    ASSERT_EQ(expected, actual) << kernels.name << " with " << frames << " frames";
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(AllKernels, InterleaveTest,
+                         ::testing::Range(size_t{0}, GetAvailableInterleaveKernels().size()));
+
+} // namespace
+} // namespace plac
@@ -0,0 +1,411 @@
+// SPDX-License-Identifier: MIT
+
+#include "library_index.h"
+#include "cache_file.h"
+#include "conditions.h"
+#include "file_desc.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace plac {
+
+namespace {
+
+// followed by count_ Track records and strings_size_ bytes of strings
+struct Header {
+  std::array<char, 8> magic_;
+  uint64_t count_;
+  uint64_t strings_size_;
+};
+
+constexpr std::array<char, 8> kMagic{'P', 'L', 'A', 'C', 'L', 'I', 'B', '1'};
+
+// most files have all metadata blocks in the first read, large PICTURE blocks
+// are skipped without reading them
+constexpr size_t kHeadSize{64U << 10U};
+constexpr size_t kSeekPointSize{18};
+constexpr uint64_t kPlaceholder{0xFFFFFFFFFFFFFFFFULL};
+
+enum BlockType : u_char { kStreamInfo = 0, kSeekTable = 3, kVorbisComment = 4 };
+
+// bytes of the file, served from its head if possible
+class Reader {
+public:
+  explicit Reader(const int fd) : fd_{fd}, head_(kHeadSize) {
+    const ssize_t n{::pread(fd_, head_.data(), head_.size(), 0)};
+    head_.resize((n > 0) ? static_cast<size_t>(n) : 0);
+  }
+
+  // empty at the end of the file
+  std::optional<std::span<const u_char>> Read(const size_t offset, const size_t size) {
+    if ((offset <= head_.size()) && (head_.size() - offset >= size)) {
+      return std::span<const u_char>{head_}.subspan(offset, size);
+    }
+    if (head_.size() < kHeadSize) {
+      return std::nullopt;
+    }
+    scratch_.resize(size);
+    const ssize_t n{::pread(fd_, scratch_.data(), size, static_cast<off_t>(offset))};
+    if ((n < 0) || (static_cast<size_t>(n) != size)) {
+      return std::nullopt;
+    }
+    return std::span<const u_char>{scratch_};
+  }
+
+private:
+  int fd_;
+  std::vector<u_char> head_;
+  std::vector<u_char> scratch_{};
+};
+
+uint64_t ReadBigEndian64(const u_char *p) {
+  uint64_t value{0};
+  for (size_t i{0}; i < 8; ++i) {
+    value = (value << 8U) | p[i];
+  }
+  return value;
+}
+
+bool IsFlacFile(const std::filesystem::path &path) {
+  const std::string extension{path.extension().string()};
+  return (extension.size() == 5)
+         && std::equal(extension.begin(), extension.end(), ".flac",
+                       [](const char a, const char b) {
+                         return std::tolower(static_cast<unsigned char>(a)) == b;
+                       });
+}
+
+// regular *.flac files below roots, sorted and without duplicates
+std::vector<std::string> ListFiles(const std::span<const std::string> roots) {
+  std::vector<std::string> files{};
+  for (const std::string &root : roots) {
+    std::error_code ec{};
+    std::filesystem::recursive_directory_iterator it{
+        root, std::filesystem::directory_options::skip_permission_denied, ec};
+    if (ec) {
+      LOG_ERROR("cannot list {}: {}", root, ec.message());
+      continue;
+    }
+    for (; it != std::filesystem::recursive_directory_iterator{}; it.increment(ec)) {
+      if (it->is_regular_file(ec) && IsFlacFile(it->path())) {
+        files.push_back(std::filesystem::absolute(it->path(), ec).lexically_normal().string());
+      }
+    }
+    if (ec) {
+      LOG_ERROR("cannot list {}: {}", root, ec.message());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  files.erase(std::unique(files.begin(), files.end()), files.end());
+  return files;
+}
+
+} // namespace
+
+std::optional<TrackMetadata> ScanTrack(const std::string &path) {
+  const FileDesc desc{path.c_str()};
+  if (!desc.IsValid()) {
+    return std::nullopt;
+  }
+  const std::optional<FrameIndex::Key> key{MakeFrameIndexKey(desc.fd_)};
+  if (!key) {
+    return std::nullopt;
+  }
+  Reader reader{desc.fd_};
+
+  size_t pos{0};
+  // an ID3v2 tag in front of the stream, libFLAC skips it as well
+  if (const auto id3{reader.Read(0, 10)}; id3 && (std::memcmp(id3->data(), "ID3", 3) == 0)) {
+    const auto &h{*id3};
+    // sync-safe integer, 7 bits per byte
+    pos = 10 + ((size_t{h[6]} << 21U) | (size_t{h[7]} << 14U) | (size_t{h[8]} << 7U) | h[9])
+          + (((h[5] & 0x10U) != 0) ? 10 : 0);
+  }
+  if (const auto magic{reader.Read(pos, 4)};
+      !magic || (std::memcmp(magic->data(), "fLaC", 4) != 0)) {
+    return std::nullopt;
+  }
+  pos += 4;
+
+  TrackMetadata track{path, *key, {}, 0, {}};
+  bool first{true};
+  bool last{false};
+  while (!last) {
+    const auto header{reader.Read(pos, 4)};
+    if (!header) {
+      return std::nullopt;
+    }
+    const u_char type{static_cast<u_char>((*header)[0] & 0x7FU)};
+    last = ((*header)[0] & 0x80U) != 0;
+    const size_t length{(size_t{(*header)[1]} << 16U) | (size_t{(*header)[2]} << 8U)
+                        | (*header)[3]};
+    pos += 4;
+    // STREAMINFO is mandatory and always first
+    if (first != (type == kStreamInfo)) {
+      return std::nullopt;
+    }
+    first = false;
+    if ((type == kStreamInfo) || (type == kSeekTable) || (type == kVorbisComment)) {
+      const auto body{reader.Read(pos, length)};
+      if (!body) {
+        return std::nullopt;
+      }
+      if (type == kStreamInfo) {
+        const std::optional<StreamInfo> info{ParseStreamInfo(*body)};
+        if (!info) {
+          return std::nullopt;
+        }
+        track.info_ = *info;
+      } else if (type == kSeekTable) {
+        track.seek_points_ = 0;
+        for (size_t i{0}; i + kSeekPointSize <= body->size(); i += kSeekPointSize) {
+          if (ReadBigEndian64(&(*body)[i]) != kPlaceholder) {
+            ++track.seek_points_;
+          }
+        }
+      } else {
+        const std::optional<Tags> tags{ParseVorbisComment(*body)};
+        if (!tags) {
+          return std::nullopt;
+        }
+        for (size_t i{0}; i < kTagCount; ++i) {
+          track.tags_[i] = (*tags)[i];
+        }
+      }
+    }
+    pos += length;
+  }
+  return track;
+}
+
+LibraryIndex::LibraryIndex(LibraryIndex &&other) noexcept
+    : data_{other.data_}, size_{other.size_}, tracks_{other.tracks_}, strings_{other.strings_} {
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.tracks_ = {};
+  other.strings_ = {};
+}
+
+LibraryIndex &LibraryIndex::operator=(LibraryIndex &&other) noexcept {
+  if (data_ == other.data_) {
+    return *this;
+  }
+  Unmap();
+  data_ = other.data_;
+  size_ = other.size_;
+  tracks_ = other.tracks_;
+  strings_ = other.strings_;
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.tracks_ = {};
+  other.strings_ = {};
+  return *this;
+}
+
+LibraryIndex::~LibraryIndex() noexcept { Unmap(); }
+
+void LibraryIndex::Unmap() {
+  if (data_ != nullptr) {
+    EXPECTS(::munmap(const_cast<u_char *>(data_), size_) == 0, "cannot unmap library index");
+  }
+}
+
+std::optional<LibraryIndex> LibraryIndex::Open(const std::string &path) {
+  const FileDesc desc{path.c_str()};
+  struct stat st {};
+  if (!desc.IsValid() || (::fstat(desc.fd_, &st) != 0)
+      || (static_cast<size_t>(st.st_size) < sizeof(Header))) {
+    return std::nullopt;
+  }
+  // lookups are random, so the pages are not read ahead
+  void *data{::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, desc.fd_, 0)};
+  if (data == MAP_FAILED) {
+    LOG_ERROR("cannot map {}: {}", path, ::strerror(errno));
+    return std::nullopt;
+  }
+  LibraryIndex index{};
+  index.data_ = static_cast<const u_char *>(data);
+  index.size_ = static_cast<size_t>(st.st_size);
+
+  Header header{};
+  std::memcpy(&header, index.data_, sizeof(header));
+  const size_t available{index.size_ - sizeof(Header)};
+  // the string table is not empty, it starts with the empty string
+  if ((header.magic_ != kMagic) || (header.count_ > available / sizeof(Track))
+      || (header.strings_size_ != available - header.count_ * sizeof(Track))
+      || (header.strings_size_ == 0) || (index.data_[index.size_ - 1] != '\0')) {
+    return std::nullopt;
+  }
+  // sizeof(Header) keeps the records aligned in the page aligned mapping
+  index.tracks_ = {reinterpret_cast<const Track *>(index.data_ + sizeof(Header)),
+                   static_cast<size_t>(header.count_)};
+  index.strings_ = {reinterpret_cast<const char *>(index.data_ + sizeof(Header)
+                                                   + header.count_ * sizeof(Track)),
+                    static_cast<size_t>(header.strings_size_)};
+  return index;
+}
+
+bool LibraryIndex::Save(const std::string &path, std::vector<TrackMetadata> tracks) {
+  std::sort(tracks.begin(), tracks.end(),
+            [](const TrackMetadata &a, const TrackMetadata &b) { return a.path_ < b.path_; });
+
+  // artists, albums and dates repeat across many tracks
+  std::string strings(1, '\0');
+  std::unordered_map<std::string_view, uint32_t> interned{{std::string_view{}, 0}};
+  const auto intern{[&strings, &interned](const std::string &s) -> uint32_t {
+    // an embedded NUL ends the string like in the tag of a C API
+    const std::string_view key{s.c_str()};
+    if (const auto it{interned.find(key)}; it != interned.end()) {
+      return it->second;
+    }
+    const auto offset{static_cast<uint32_t>(strings.size())};
+    strings.append(key);
+    strings.push_back('\0');
+    interned.emplace(key, offset);
+    return offset;
+  }};
+
+  std::vector<Track> records{};
+  records.reserve(tracks.size());
+  for (const TrackMetadata &track : tracks) {
+    Track record{};
+    record.key_ = track.key_;
+    record.total_samples_ = track.info_.total_samples_;
+    record.rate_ = track.info_.rate_;
+    record.channels_ = static_cast<uint16_t>(track.info_.channels_);
+    record.bits_ = static_cast<uint16_t>(track.info_.bits_);
+    record.seek_points_ = track.seek_points_;
+    record.path_ = intern(track.path_);
+    for (size_t i{0}; i < kTagCount; ++i) {
+      record.tags_[i] = intern(track.tags_[i]);
+    }
+    record.md5_ = track.info_.md5_;
+    records.push_back(record);
+  }
+  if (strings.size() > UINT32_MAX) {
+    LOG_ERROR("too many strings for {}", path);
+    return false;
+  }
+
+  const Header header{kMagic, records.size(), strings.size()};
+  return WriteFileAtomically(path, {std::as_bytes(std::span{&header, 1}),
+                                    std::as_bytes(std::span{records}),
+                                    std::as_bytes(std::span{strings})});
+}
+
+std::string_view LibraryIndex::String(const uint32_t offset) const {
+  if (offset >= strings_.size()) {
+    return {};
+  }
+  // the table ends with a NUL, checked by Open()
+  return {strings_.data() + offset};
+}
+
+const LibraryIndex::Track *LibraryIndex::Find(const std::string_view path) const {
+  const auto it{std::lower_bound(
+      tracks_.begin(), tracks_.end(), path,
+      [this](const Track &track, const std::string_view p) { return Path(track) < p; })};
+  if ((it == tracks_.end()) || (Path(*it) != path)) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+TrackMetadata LibraryIndex::ToMetadata(const Track &track) const {
+  TrackMetadata metadata{std::string{Path(track)}, track.key_, {}, track.seek_points_, {}};
+  metadata.info_.rate_ = track.rate_;
+  metadata.info_.channels_ = track.channels_;
+  metadata.info_.bits_ = track.bits_;
+  metadata.info_.total_samples_ = track.total_samples_;
+  metadata.info_.md5_ = track.md5_;
+  for (size_t i{0}; i < kTagCount; ++i) {
+    metadata.tags_[i] = String(track.tags_[i]);
+  }
+  return metadata;
+}
+
+std::optional<LibraryScanStats> UpdateLibraryIndex(const std::string &path,
+                                                   const std::span<const std::string> roots,
+                                                   unsigned int threads) {
+  if (threads == 0) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  const std::vector<std::string> files{ListFiles(roots)};
+  const std::optional<LibraryIndex> previous{LibraryIndex::Open(path)};
+
+  LibraryScanStats stats{};
+  std::vector<std::optional<TrackMetadata>> tracks(files.size());
+  std::vector<size_t> changed{};
+  for (size_t i{0}; i < files.size(); ++i) {
+    const LibraryIndex::Track *const known{previous ? previous->Find(files[i]) : nullptr};
+    if (known != nullptr) {
+      if (const std::optional<FrameIndex::Key> key{MakeFrameIndexKey(files[i])};
+          key && (*key == known->key_)) {
+        tracks[i] = previous->ToMetadata(*known);
+        ++stats.reused_;
+        continue;
+      }
+    }
+    changed.push_back(i);
+  }
+
+  // the metadata of a file is a few small reads, so the scan waits on storage
+  // far more than on the CPU and is spread over all threads
+  std::atomic<size_t> next{0};
+  const auto work{[&]() {
+    while (true) {
+      const size_t k{next.fetch_add(1, std::memory_order_relaxed)};
+      if (k >= changed.size()) {
+        return;
+      }
+      tracks[changed[k]] = ScanTrack(files[changed[k]]);
+    }
+  }};
+  std::vector<std::thread> workers{};
+  const size_t count{std::min<size_t>(threads, changed.size())};
+  for (size_t i{0}; i < count; ++i) {
+    workers.emplace_back(work);
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  stats.scanned_ = changed.size();
+
+  std::vector<TrackMetadata> indexed{};
+  indexed.reserve(files.size());
+  for (size_t i{0}; i < files.size(); ++i) {
+    if (tracks[i]) {
+      indexed.push_back(std::move(*tracks[i]));
+    } else {
+      LOG_ERROR("cannot read the metadata of {}", files[i]);
+      ++stats.failed_;
+    }
+  }
+  stats.tracks_ = indexed.size();
+
+  std::error_code ec{};
+  if (const std::filesystem::path dir{std::filesystem::path{path}.parent_path()}; !dir.empty()) {
+    std::filesystem::create_directories(dir, ec);
+  }
+  if (ec || !LibraryIndex::Save(path, std::move(indexed))) {
+    return std::nullopt;
+  }
+  return stats;
+}
+
+std::string DefaultLibraryIndexPath() {
+  const std::string dir{CacheDir()};
+  return dir.empty() ? dir : dir + "/library.idx";
+}
+
+} // namespace plac
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include "flac_frame.h"
+#include "frame_index.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <type_traits>
+#include <vector>
+
+namespace plac {
+
+// Metadata of a FLAC file as read by ScanTrack(), without decoding any audio
+struct TrackMetadata {
+  std::string path_;
+  FrameIndex::Key key_;
+  StreamInfo info_;
+  uint32_t seek_points_;
+  std::array<std::string, kTagCount> tags_;
+};
+
+// reads only the metadata blocks at the head of the file. empty if it is not
+// a FLAC file or its metadata is malformed
+std::optional<TrackMetadata> ScanTrack(const std::string &path);
+
+// Read-only view of an index file of a music library.
+//
+// The file is mapped as it is, opening it parses nothing. Tracks are records
+// of a fixed size sorted by path, all strings are interned in one table and
+// referenced by their offset. The file is a local cache in native byte order.
+class LibraryIndex {
+public:
+  struct Track {
+    FrameIndex::Key key_;
+    uint64_t total_samples_;
+    uint32_t rate_;
+    uint16_t channels_;
+    uint16_t bits_;
+    uint32_t seek_points_;
+    // offsets into the string table
+    uint32_t path_;
+    std::array<uint32_t, kTagCount> tags_;
+    std::array<u_char, 16> md5_;
+
+    // 0 if the number of samples is unknown
+    double Seconds() const {
+      return (rate_ == 0) ? 0.0 : static_cast<double>(total_samples_) / rate_;
+    }
+  };
+  static_assert(std::is_trivially_copyable_v<Track>);
+
+  LibraryIndex() = default;
+  LibraryIndex(const LibraryIndex &) = delete;
+  LibraryIndex(LibraryIndex &&other) noexcept;
+  LibraryIndex &operator=(const LibraryIndex &) = delete;
+  LibraryIndex &operator=(LibraryIndex &&other) noexcept;
+  ~LibraryIndex() noexcept;
+
+  // empty if path does not hold an index
+  static std::optional<LibraryIndex> Open(const std::string &path);
+  // sorts tracks by path. written to a temporary file which is renamed to path
+  static bool Save(const std::string &path, std::vector<TrackMetadata> tracks);
+
+  std::span<const Track> Tracks() const { return tracks_; }
+  // empty if offset is out of range
+  std::string_view String(uint32_t offset) const;
+  std::string_view Path(const Track &track) const { return String(track.path_); }
+  std::string_view Get(const Track &track, Tag tag) const {
+    return String(track.tags_[static_cast<size_t>(tag)]);
+  }
+  // binary search, nullptr if path is not indexed
+  const Track *Find(std::string_view path) const;
+  // copies the strings out of the mapping
+  TrackMetadata ToMetadata(const Track &track) const;
+
+private:
+  void Unmap();
+
+  const u_char *data_{nullptr};
+  size_t size_{0};
+  std::span<const Track> tracks_{};
+  std::string_view strings_{};
+};
+
+struct LibraryScanStats {
+  size_t tracks_{0};
+  // read again because they are new or their size or mtime changed
+  size_t scanned_{0};
+  // taken over from the previous index
+  size_t reused_{0};
+  // not a FLAC file or malformed, left out of the index
+  size_t failed_{0};
+};
+
+// Indexes every *.flac below roots, with threads reading metadata in parallel,
+// 0 for one per core. Files whose size and mtime match the previous index at
+// path are not opened. empty if the index cannot be written
+std::optional<LibraryScanStats> UpdateLibraryIndex(const std::string &path,
+                                                   std::span<const std::string> roots,
+                                                   unsigned int threads = 0);
+
+// $XDG_CACHE_HOME/plac/library.idx, or ~/.cache/plac/library.idx. empty if
+// neither is set
+std::string DefaultLibraryIndexPath();
+
+} // namespace plac
+
+#endif
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: MIT
+
+#include "library_index.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string_view>
+#include <vector>
+
+namespace plac {
+namespace {
+
+// 4096 samples per frame, 44.1 kHz, stereo, 16 bits, 441000 samples
+constexpr std::array<u_char, 34> kStreamInfo{
+    0x10, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0A, 0xC4,
+    0x42, 0xF0, 0x00, 0x06, 0xBA, 0xA8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+void AppendBlockHeader(std::vector<u_char> &data, const u_char type, const size_t length,
+                       const bool last) {
+  data.insert(data.end(), {static_cast<u_char>(type | (last ? 0x80U : 0U)),
+                           static_cast<u_char>(length >> 16U), static_cast<u_char>(length >> 8U),
+                           static_cast<u_char>(length)});
+}
+
+void AppendString(std::vector<u_char> &data, const std::string_view s) {
+  for (unsigned int shift{0}; shift < 32; shift += 8) {
+    data.push_back(static_cast<u_char>(s.size() >> shift));
+  }
+  data.insert(data.end(), s.begin(), s.end());
+}
+
+// metadata blocks only, the index does not look at the frames
+std::vector<u_char> MakeFile(const std::vector<std::string_view> &comments,
+                             const size_t picture_size = 0) {
+  std::vector<u_char> data{'f', 'L', 'a', 'C'};
+  AppendBlockHeader(data, 0, kStreamInfo.size(), false);
+  data.insert(data.end(), kStreamInfo.begin(), kStreamInfo.end());
+
+  // one seek point and one placeholder
+  AppendBlockHeader(data, 3, 36, false);
+  data.insert(data.end(), 8, 0x00);
+  data.insert(data.end(), 10, 0x00);
+  data.insert(data.end(), 8, 0xFF);
+  data.insert(data.end(), 10, 0x00);
+
+  if (picture_size != 0) {
+    AppendBlockHeader(data, 6, picture_size, false);
+    data.insert(data.end(), picture_size, 0xAA);
+  }
+
+  std::vector<u_char> vorbis_comment{};
+  AppendString(vorbis_comment, "reference libFLAC 1.4.3");
+  vorbis_comment.insert(vorbis_comment.end(), {static_cast<u_char>(comments.size()), 0, 0, 0});
+  for (const std::string_view comment : comments) {
+    AppendString(vorbis_comment, comment);
+  }
+  AppendBlockHeader(data, 4, vorbis_comment.size(), true);
+  data.insert(data.end(), vorbis_comment.begin(), vorbis_comment.end());
+  return data;
+}
+
+class LibraryIndexTest : public ::testing::Test {
+protected:
+  void SetUp() override { std::filesystem::create_directories(kDir + "/b"); }
+  void TearDown() override { std::filesystem::remove_all(kDir); }
+
+  static void Write(const std::string &name, const std::vector<u_char> &data) {
+    std::ofstream{name, std::ios::binary}.write(reinterpret_cast<const char *>(data.data()),
+                                                static_cast<std::streamsize>(data.size()));
+  }
+
+  static std::string Absolute(const std::string &name) {
+    return std::filesystem::absolute(name).lexically_normal().string();
+  }
+
+  const std::string kDir{"library_index_unit_test"};
+  const std::string kIndex{kDir + "/library.idx"};
+};
+
+TEST_F(LibraryIndexTest, ScanTrack) {
+  // the VORBIS_COMMENT lies behind the first read
+  Write(kDir + "/a.flac", MakeFile({"TITLE=a", "artist=x", "TITLE=b"}, 100000));
+
+  const std::optional<TrackMetadata> track{ScanTrack(kDir + "/a.flac")};
+  ASSERT_TRUE(track);
+  EXPECT_EQ(44100, track->info_.rate_);
+  EXPECT_EQ(2, track->info_.channels_);
+  EXPECT_EQ(16, track->info_.bits_);
+  EXPECT_EQ(441000, track->info_.total_samples_);
+  EXPECT_EQ(1, track->seek_points_);
+  EXPECT_EQ("a", track->tags_[static_cast<size_t>(Tag::title)]);
+  EXPECT_EQ("x", track->tags_[static_cast<size_t>(Tag::artist)]);
+  EXPECT_EQ("", track->tags_[static_cast<size_t>(Tag::album)]);
+  EXPECT_EQ(std::filesystem::file_size(kDir + "/a.flac"), track->key_.size_);
+}
+
+TEST_F(LibraryIndexTest, ScanTrackWhenMalformed) {
+  std::vector<u_char> data{MakeFile({"TITLE=a"})};
+  data.pop_back();
+  Write(kDir + "/truncated.flac", data);
+  Write(kDir + "/other.flac", {'O', 'g', 'g', 'S', 0, 0, 0, 0});
+
+  EXPECT_FALSE(ScanTrack(kDir + "/truncated.flac"));
+  EXPECT_FALSE(ScanTrack(kDir + "/other.flac"));
+  EXPECT_FALSE(ScanTrack(kDir + "/missing.flac"));
+}
+
+TEST_F(LibraryIndexTest, Update) {
+  Write(kDir + "/b/2.flac", MakeFile({"ARTIST=x", "ALBUM=y", "TITLE=two"}));
+  Write(kDir + "/1.FLAC", MakeFile({"ARTIST=x", "ALBUM=y", "TITLE=one"}));
+  Write(kDir + "/notes.txt", {'x'});
+  Write(kDir + "/bad.flac", {'x'});
+
+  const std::vector<std::string> roots{kDir};
+  const std::optional<LibraryScanStats> stats{UpdateLibraryIndex(kIndex, roots, 2)};
+  ASSERT_TRUE(stats);
+  EXPECT_EQ(2, stats->tracks_);
+  EXPECT_EQ(3, stats->scanned_);
+  EXPECT_EQ(0, stats->reused_);
+  EXPECT_EQ(1, stats->failed_);
+
+  const std::optional<LibraryIndex> index{LibraryIndex::Open(kIndex)};
+  ASSERT_TRUE(index);
+  ASSERT_EQ(2, index->Tracks().size());
+  const LibraryIndex::Track &one{index->Tracks()[0]};
+  const LibraryIndex::Track &two{index->Tracks()[1]};
+  EXPECT_EQ(Absolute(kDir + "/1.FLAC"), index->Path(one));
+  EXPECT_EQ(Absolute(kDir + "/b/2.flac"), index->Path(two));
+  EXPECT_EQ("one", index->Get(one, Tag::title));
+  EXPECT_EQ("two", index->Get(two, Tag::title));
+  EXPECT_EQ("", index->Get(two, Tag::genre));
+  // interned
+  EXPECT_EQ(one.tags_[static_cast<size_t>(Tag::artist)],
+            two.tags_[static_cast<size_t>(Tag::artist)]);
+  EXPECT_DOUBLE_EQ(10.0, one.Seconds());
+  EXPECT_EQ(16, one.bits_);
+
+  EXPECT_EQ(&two, index->Find(Absolute(kDir + "/b/2.flac")));
+  EXPECT_EQ(nullptr, index->Find(Absolute(kDir + "/bad.flac")));
+  EXPECT_EQ(nullptr, index->Find("2.flac"));
+}
+
+TEST_F(LibraryIndexTest, UpdateIsIncremental) {
+  Write(kDir + "/1.flac", MakeFile({"TITLE=one"}));
+  Write(kDir + "/b/2.flac", MakeFile({"TITLE=two"}));
+  Write(kDir + "/b/3.flac", MakeFile({"TITLE=three"}));
+  const std::vector<std::string> roots{kDir};
+  ASSERT_TRUE(UpdateLibraryIndex(kIndex, roots));
+
+  const std::optional<LibraryScanStats> unchanged{UpdateLibraryIndex(kIndex, roots)};
+  ASSERT_TRUE(unchanged);
+  EXPECT_EQ(3, unchanged->tracks_);
+  EXPECT_EQ(0, unchanged->scanned_);
+  EXPECT_EQ(3, unchanged->reused_);
+
+  Write(kDir + "/1.flac", MakeFile({"TITLE=uno"}));
+  // same size, only the mtime tells the change
+  const std::string name{kDir + "/1.flac"};
+  std::filesystem::last_write_time(name, std::filesystem::last_write_time(name)
+                                             + std::chrono::seconds{1});
+  std::filesystem::remove(kDir + "/b/3.flac");
+  const std::optional<LibraryScanStats> changed{UpdateLibraryIndex(kIndex, roots)};
+  ASSERT_TRUE(changed);
+  EXPECT_EQ(2, changed->tracks_);
+  EXPECT_EQ(1, changed->scanned_);
+  EXPECT_EQ(1, changed->reused_);
+
+  const std::optional<LibraryIndex> index{LibraryIndex::Open(kIndex)};
+  ASSERT_TRUE(index);
+  ASSERT_EQ(2, index->Tracks().size());
+  EXPECT_EQ("uno", index->Get(index->Tracks()[0], Tag::title));
+  EXPECT_EQ("two", index->Get(index->Tracks()[1], Tag::title));
+  EXPECT_EQ(1, index->Tracks()[1].seek_points_);
+}
+
+TEST_F(LibraryIndexTest, OpenWhenCorrupt) {
+  EXPECT_FALSE(LibraryIndex::Open(kIndex));
+
+  Write(kDir + "/1.flac", MakeFile({}));
+  ASSERT_TRUE(LibraryIndex::Save(kIndex, {*ScanTrack(kDir + "/1.flac")}));
+  ASSERT_TRUE(LibraryIndex::Open(kIndex));
+
+  std::filesystem::resize_file(kIndex, std::filesystem::file_size(kIndex) - 1);
+  EXPECT_FALSE(LibraryIndex::Open(kIndex));
+}
+
+} // namespace
+} // namespace plac
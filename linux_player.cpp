@@ -1,11 +1,33 @@
 // SPDX-License-Identifier: MIT
 
 #include "alsa_audio_device.h"
+#include "audio_buffer.h"
+#include "flow_control.h"
+#include "gapless.h"
+#include "metrics.h"
+#include "parse_number.h"
+#include "playback_verifier.h"
+#include "prefetcher.h"
+#include "realtime.h"
+#include "startup_trace.h"
 #include "stream.h"
+#include <atomic>
+#include <cstdint>
+#include <getopt.h>
+#include <optional>
 #include <sched.h>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <thread>
 
-int main(int argc, char *argv[]) {
-    EXPECTS(argc > 1, "no file provided");
+namespace {
+
+// only the ALSA writer runs on the isolated core. decoding and file I/O stay on
+// the default affinity of the process which excludes isolated cores.
+void MakeRealtime() {
+    ::plac::PrefaultStack();
 
     cpu_set_t cpu_set;
     CPU_ZERO(&cpu_set);
@@ -31,27 +53,353 @@ int main(int argc, char *argv[]) {
         // check it with `getcap <path>/flacplayer`
         LOG_ERROR("failed to set scheduling parameters: {}", ::strerror(errno));
     }
+}
 
-    ::plac::Stream stream{plac::AlsaAudioDevice::Output::uln2};
+// page faults of the decode thread per track, and of the output thread since
+// the previous report. reports are made when the decoder reaches a track
+// boundary, the output plays the buffered audio of the previous track at that
+// time, so its faults cannot be attributed to a track. the output thread reads
+// its own counters only before and after its loop, while it plays they are
+// read from /proc by the decode thread
+struct FaultReport {
+    // output thread, before and after the playback loop
+    void Started() {
+        output_ = ::plac::ThreadFaults();
+        tid_.store(::plac::ThreadId(), std::memory_order_release);
+    }
+    void Stopped() {
+        stopped_ = ::plac::ThreadFaults();
+        exited_.store(true, std::memory_order_release);
+    }
 
-    bool first{true};
-    while (optind <= (argc - 1)) {
-        if (!stream.Reset(argv[optind++])) {
-            continue;
+    // decode thread. logs the previous track when name starts, and the last
+    // track with an empty name
+    void Next(const std::string_view name) {
+        const ::plac::FaultCounts decoder{::plac::ThreadFaults()};
+        if (!name_.empty()) {
+            const ::plac::FaultCounts d{decoder - decoder_};
+            std::optional<::plac::FaultCounts> output{};
+            // the tid of an exited thread may be reused, e.g. by a thread of
+            // PlayGapless(). exited_ is set before the thread exits, so /proc
+            // showed the output thread if it is still unset after the read
+            if (const pid_t tid{tid_.load(std::memory_order_acquire)}; tid != 0) {
+                if (!exited_.load(std::memory_order_acquire)) {
+                    output = ::plac::ThreadFaults(tid);
+                }
+                if (exited_.load(std::memory_order_acquire)) {
+                    output = stopped_;
+                }
+            }
+            if (output) {
+                const ::plac::FaultCounts o{*output - output_};
+                output_ = *output;
+                LOG_INFO("page faults of {}: decoder {} minor {} major, output since the previous "
+                         "report {} minor {} major",
+                         name_, d.minor_, d.major_, o.minor_, o.major_);
+            } else {
+                LOG_INFO("page faults of {}: decoder {} minor {} major", name_, d.minor_, d.major_);
+            }
+        }
+        name_ = name;
+        decoder_ = decoder;
+    }
+
+    // set once the output thread has taken output_
+    std::atomic<pid_t> tid_{0};
+    ::plac::FaultCounts output_{};
+    // set once the output thread has taken stopped_
+    std::atomic<bool> exited_{false};
+    ::plac::FaultCounts stopped_{};
+    // decode thread only
+    std::string name_{};
+    ::plac::FaultCounts decoder_{};
+};
+
+struct Options {
+    ::plac::Stream::Input input{::plac::Stream::Input::mmap};
+    size_t memory_limit{::plac::Stream::kDefaultMemoryLimit};
+    ::plac::Stream::Engine engine{::plac::Stream::Engine::libflac};
+    ::plac::AlsaAudioDevice::Profile profile{::plac::AlsaAudioDevice::Profile::power_save};
+    ::plac::AlsaAudioDevice::Start start{::plac::AlsaAudioDevice::Start::full_buffer};
+    ::plac::AlsaAudioDevice::Output output{::plac::AlsaAudioDevice::Output::uln2};
+    // Prometheus text file. empty if not exported
+    std::string metrics{};
+    // startup phases, see startup_harness. empty if not traced
+    std::string startup_trace{};
+    // position in the first file in seconds
+    uint64_t position{0};
+    // frame index cache. empty to disable it
+    std::string index_dir{::plac::DefaultFrameIndexDir()};
+    // checks the MD5 of each track in the background
+    bool verify{true};
+    // upcoming tracks which are read into the page cache, 0 to disable it
+    size_t prefetch{::plac::Prefetcher::kDefaultTracks};
+    size_t prefetch_budget{::plac::Prefetcher::kDefaultBudget};
+    // mlockall() at startup
+    bool lock_memory{true};
+};
+
+// [[h:]mm:]ss, empty if malformed
+std::optional<uint64_t> ParseTime(const std::string_view text) {
+    uint64_t seconds{0};
+    uint64_t field{0};
+    bool digits{false};
+    int separators{0};
+    for (const char c : text) {
+        if ((c >= '0') && (c <= '9')) {
+            field = field * 10 + static_cast<uint64_t>(c - '0');
+            digits = true;
+        } else if ((c == ':') && digits && (separators < 2)) {
+            seconds = (seconds + field) * 60;
+            field = 0;
+            digits = false;
+            ++separators;
+        } else {
+            return std::nullopt;
+        }
+    }
+    if (!digits) {
+        return std::nullopt;
+    }
+    return seconds + field;
+}
+
+// usage: flacplayer [--input=read|mmap|memory|uring] [--memory-limit=<MiB>]
+//                   [--decoder=libflac|native] [--profile=power-save|100ms|20ms|5ms] [--fast-start]
+//                   [--device=uln2|file] [--metrics=<path>] [--startup-trace=<path>]
+//                   [--start=[[h:]mm:]ss] [--index-dir=<path>|--no-index] [--no-verify]
+//                   [--prefetch=<tracks>] [--prefetch-budget=<MiB>] [--no-lock] <file>...
+Options ParseOptions(int argc, char *argv[]) {
+    const option long_options[]{
+        {"input", required_argument, nullptr, 'i'},
+        {"memory-limit", required_argument, nullptr, 'm'},
+        {"decoder", required_argument, nullptr, 'e'},
+        {"profile", required_argument, nullptr, 'p'},
+        {"fast-start", no_argument, nullptr, 'f'},
+        {"device", required_argument, nullptr, 'd'},
+        {"metrics", required_argument, nullptr, 'x'},
+        {"startup-trace", required_argument, nullptr, 't'},
+        {"start", required_argument, nullptr, 's'},
+        {"index-dir", required_argument, nullptr, 'n'},
+        {"no-index", no_argument, nullptr, 'N'},
+        {"no-verify", no_argument, nullptr, 'V'},
+        {"prefetch", required_argument, nullptr, 'r'},
+        {"prefetch-budget", required_argument, nullptr, 'b'},
+        {"no-lock", no_argument, nullptr, 'L'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    Options options{};
+    int c{};
+    while ((c = ::getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (c) {
+        case 'i': {
+            const std::string_view input{optarg};
+            if (input == "read") {
+                options.input = ::plac::Stream::Input::read;
+            } else if (input == "mmap") {
+                options.input = ::plac::Stream::Input::mmap;
+            } else if (input == "memory") {
+                options.input = ::plac::Stream::Input::memory;
+            } else if (input == "uring") {
+                options.input = ::plac::Stream::Input::uring;
+            } else {
+                ENSURES(false, "unknown input: {}", optarg);
+            }
+            break;
+        }
+        case 'm': {
+            const std::optional<uint64_t> mib{::plac::ParseNumber(optarg, SIZE_MAX >> 20U)};
+            ENSURES(mib.has_value(), "invalid memory limit: {}", optarg);
+            options.memory_limit = static_cast<size_t>(*mib) << 20U;
+            break;
+        }
+        case 'e': {
+            const std::string_view engine{optarg};
+            if (engine == "libflac") {
+                options.engine = ::plac::Stream::Engine::libflac;
+            } else if (engine == "native") {
+                options.engine = ::plac::Stream::Engine::native;
+            } else {
+                ENSURES(false, "unknown decoder: {}", optarg);
+            }
+            break;
+        }
+        case 'p': {
+            const std::string_view profile{optarg};
+            if (profile == "power-save") {
+                options.profile = ::plac::AlsaAudioDevice::Profile::power_save;
+            } else if (profile == "100ms") {
+                options.profile = ::plac::AlsaAudioDevice::Profile::ms100;
+            } else if (profile == "20ms") {
+                options.profile = ::plac::AlsaAudioDevice::Profile::ms20;
+            } else if (profile == "5ms") {
+                options.profile = ::plac::AlsaAudioDevice::Profile::ms5;
+            } else {
+                ENSURES(false, "unknown profile: {}", optarg);
+            }
+            break;
+        }
+        case 'f':
+            options.start = ::plac::AlsaAudioDevice::Start::fast;
+            break;
+        case 'd': {
+            const std::string_view device{optarg};
+            if (device == "uln2") {
+                options.output = ::plac::AlsaAudioDevice::Output::uln2;
+            } else if (device == "file") {
+                options.output = ::plac::AlsaAudioDevice::Output::file;
+            } else {
+                ENSURES(false, "unknown device: {}", optarg);
+            }
+            break;
+        }
+        case 'x':
+            options.metrics = optarg;
+            break;
+        case 't':
+            options.startup_trace = optarg;
+            break;
+        case 's': {
+            const std::optional<uint64_t> position{ParseTime(optarg)};
+            ENSURES(position.has_value(), "invalid start: {}", optarg);
+            options.position = *position;
+            break;
         }
+        case 'n':
+            options.index_dir = optarg;
+            break;
+        case 'N':
+            options.index_dir.clear();
+            break;
+        case 'V':
+            options.verify = false;
+            break;
+        case 'r': {
+            const std::optional<uint64_t> tracks{::plac::ParseNumber(optarg, SIZE_MAX)};
+            ENSURES(tracks.has_value(), "invalid prefetch: {}", optarg);
+            options.prefetch = static_cast<size_t>(*tracks);
+            break;
+        }
+        case 'b': {
+            const std::optional<uint64_t> mib{::plac::ParseNumber(optarg, SIZE_MAX >> 20U)};
+            ENSURES(mib.has_value(), "invalid prefetch budget: {}", optarg);
+            options.prefetch_budget = static_cast<size_t>(*mib) << 20U;
+            break;
+        }
+        case 'L':
+            options.lock_memory = false;
+            break;
+        default:
+            ENSURES(false, "unknown option");
+            break;
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const int64_t entered{::plac::MonotonicNs()};
+    const Options options{ParseOptions(argc, argv)};
+    EXPECTS(optind < argc, "no file provided");
+    // before the buffers are allocated and the threads are started, which are
+    // locked as they are touched
+    if (options.lock_memory) {
+        ::plac::LockMemory();
+    }
+    ::plac::PrefaultStack();
+    // starts the log thread before the real-time thread may log
+    ::plac::AsyncLog::Instance();
+
+    std::optional<::plac::StartupTrace> startup{};
+    if (!options.startup_trace.empty()) {
+        startup.emplace(options.startup_trace);
+        startup->Mark(::plac::StartupTrace::Phase::main, entered);
+        startup->Mark(::plac::StartupTrace::Phase::options);
+    }
+
+    ::plac::FlowControl flow{};
+    ::plac::AudioBuffer<65536> audio_buffer{};
+    audio_buffer.Prefault();
+    // while one stream decodes the other one prepares the next track
+    ::plac::Stream stream1{audio_buffer, flow, options.input, options.memory_limit,
+                          options.engine};
+    ::plac::Stream stream2{audio_buffer, flow, options.input, options.memory_limit,
+                          options.engine};
+    stream1.index_dir_ = options.index_dir;
+    stream2.index_dir_ = options.index_dir;
+    ::plac::AlsaAudioDevice device{options.output, audio_buffer, flow};
+    if (startup) {
+        startup->Mark(::plac::StartupTrace::Phase::device_open);
+        stream1.startup_ = &*startup;
+        stream2.startup_ = &*startup;
+        device.startup_ = &*startup;
+    }
+    std::thread output{};
+
+    std::optional<::plac::PlaybackVerifier> verifier{};
+    if (options.verify) {
+        verifier.emplace();
+        stream1.verifier_ = &*verifier;
+        stream2.verifier_ = &*verifier;
+    }
+
+    ::plac::PlaybackMetrics metrics{};
+    std::optional<::plac::MetricsExporter> exporter{};
+    if (!options.metrics.empty()) {
+        stream1.metrics_ = &metrics;
+        stream2.metrics_ = &metrics;
+        device.metrics_ = &metrics;
+        exporter.emplace(metrics, options.metrics);
+    }
+
+    const std::span<const char *const> names{&argv[optind], static_cast<size_t>(argc - optind)};
+    std::optional<::plac::Prefetcher> prefetcher{};
+    if (options.prefetch != 0) {
+        prefetcher.emplace(names, options.prefetch, options.prefetch_budget);
+    }
+
+    FaultReport faults{};
+    bool first{true};
+    ::plac::PlayGapless(stream1, stream2, names, [&](::plac::Stream &stream) {
+        faults.Next(stream.name_);
         if (first) {
             first = false;
-            stream.device_.Init(stream.format_, ::plac::AlsaAudioDevice::LogLevel::non_verbose);
+            if ((options.position != 0) && !stream.Seek(options.position * stream.format_.rate)) {
+                return false;
+            }
+            device.Init(stream.format_,
+                        ::plac::AlsaAudioDevice::LogLevel::non_verbose,
+                        options.profile,
+                        options.start);
+            if (startup) {
+                startup->Mark(::plac::StartupTrace::Phase::device_init);
+            }
+            // sched_setaffinity() and sched_setscheduler() with pid 0 only affect the calling thread
+            output = std::thread{[&device, &faults]() {
+                MakeRealtime();
+                faults.Started();
+                device.Playback();
+                faults.Stopped();
+            }};
         }
-        if (stream.device_.format_ != stream.format_) {
+        if (device.format_ != stream.format_) {
             LOG_ERROR("audio format mismatch");
-            break;
+            return false;
+        }
+        if (prefetcher) {
+            prefetcher->Play(stream.name_);
         }
+        return true;
+    });
 
-        stream.Decode();
+    flow.Close();
+    if (output.joinable()) {
+        output.join();
     }
-
-    stream.device_.Drain();
+    faults.Next({});
 
     return 0;
 }
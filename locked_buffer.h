@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LOCKED_BUFFER_H
+#define LOCKED_BUFFER_H
+
+#include "conditions.h"
+#include "file_desc.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace plac {
+
+// Whole file copied into anonymous memory which is locked into RAM. Once
+// constructed, consuming the file never touches the storage device again.
+struct LockedBuffer {
+  LockedBuffer() = default;
+  // invalid if the file is empty, larger than limit or cannot be read
+  LockedBuffer(const FileDesc &desc, const size_t limit) {
+    struct stat st {};
+    if (!desc.IsValid() || (::fstat(desc.fd_, &st) != 0) || (st.st_size <= 0)
+        || (static_cast<size_t>(st.st_size) > limit)) {
+      return;
+    }
+    const size_t size{static_cast<size_t>(st.st_size)};
+    void *data{::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+    if (data == MAP_FAILED) {
+      return;
+    }
+    data_ = static_cast<u_char *>(data);
+    size_ = size;
+
+    // lock before reading so that the pages are resident when read(2) fills them
+    locked_ = ::mlock(data_, size_) == 0;
+    if (!locked_) {
+      LOG_ERROR("cannot lock {} bytes: {}", size_, ::strerror(errno));
+    }
+
+    size_t offset{0};
+    while (offset < size_) {
+      const ssize_t r{::pread(desc.fd_, data_ + offset, size_ - offset, static_cast<off_t>(offset))};
+      if (r <= 0) {
+        LOG_ERROR("cannot read file into memory: {}", ::strerror(errno));
+        Unmap();
+        return;
+      }
+      offset += static_cast<size_t>(r);
+    }
+  }
+  LockedBuffer(const LockedBuffer &) = delete;
+  LockedBuffer(LockedBuffer &&other) noexcept
+      : data_{other.data_}, size_{other.size_}, locked_{other.locked_} {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.locked_ = false;
+  }
+  LockedBuffer &operator=(const LockedBuffer &) = delete;
+  LockedBuffer &operator=(LockedBuffer &&other) noexcept {
+    if (data_ == other.data_) {
+      return *this;
+    }
+    Unmap();
+    data_ = other.data_;
+    size_ = other.size_;
+    locked_ = other.locked_;
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.locked_ = false;
+    return *this;
+  }
+  ~LockedBuffer() noexcept { Unmap(); }
+
+  bool IsValid() const { return data_ != nullptr; }
+
+  u_char *data_{nullptr};
+  size_t size_{0};
+  // false if RLIMIT_MEMLOCK is exceeded. the data is still held in memory.
+  bool locked_{false};
+
+private:
+  void Unmap() {
+    if (IsValid()) {
+      // munmap implicitly unlocks
+      EXPECTS(::munmap(data_, size_) == 0, "cannot unmap buffer");
+      data_ = nullptr;
+      size_ = 0;
+      locked_ = false;
+    }
+  }
+};
+
+} // namespace plac
+
+#endif
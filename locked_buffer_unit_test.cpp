@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: MIT
+
+#include "locked_buffer.h"
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <vector>
+
+namespace plac {
+namespace {
+
+class LockedBufferTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    content_.resize(10000);
+    std::iota(content_.begin(), content_.end(), 0);
+
+    FILE *f{std::fopen(kName, "wb")};
+    ASSERT_NE(nullptr, f);
+    ASSERT_EQ(content_.size(), std::fwrite(content_.data(), 1, content_.size(), f));
+    ASSERT_EQ(0, std::fclose(f));
+  }
+  void TearDown() override { std::remove(kName); }
+
+  static constexpr const char *kName{"locked_buffer_unit_test.bin"};
+  std::vector<u_char> content_;
+};
+
+TEST_F(LockedBufferTest, DefaultConstructor) {
+  LockedBuffer b{};
+  EXPECT_FALSE(b.IsValid());
+}
+
+TEST_F(LockedBufferTest, InvalidFileDesc) {
+  LockedBuffer b{FileDesc{}, 1U << 20U};
+  EXPECT_FALSE(b.IsValid());
+}
+
+TEST_F(LockedBufferTest, EmptyFile) {
+  LockedBuffer b{FileDesc{"/dev/null"}, 1U << 20U};
+  EXPECT_FALSE(b.IsValid());
+}
+
+TEST_F(LockedBufferTest, Constructor) {
+  LockedBuffer b{FileDesc{kName}, content_.size()};
+  ASSERT_TRUE(b.IsValid());
+  EXPECT_EQ(content_.size(), b.size_);
+  EXPECT_EQ(content_, (std::vector<u_char>{b.data_, b.data_ + b.size_}));
+}
+
+TEST_F(LockedBufferTest, ExceedsLimit) {
+  LockedBuffer b{FileDesc{kName}, content_.size() - 1};
+  EXPECT_FALSE(b.IsValid());
+}
+
+TEST_F(LockedBufferTest, MoveConstructor) {
+  LockedBuffer b1{FileDesc{kName}, content_.size()};
+  EXPECT_TRUE(b1.IsValid());
+  LockedBuffer b2{std::move(b1)};
+  EXPECT_FALSE(b1.IsValid());
+  EXPECT_TRUE(b2.IsValid());
+}
+
+TEST_F(LockedBufferTest, MoveAssignment) {
+  LockedBuffer b1{FileDesc{kName}, content_.size()};
+  EXPECT_TRUE(b1.IsValid());
+  LockedBuffer b2{FileDesc{kName}, content_.size()};
+  EXPECT_TRUE(b2.IsValid());
+  b2 = std::move(b1);
+  EXPECT_FALSE(b1.IsValid());
+  EXPECT_TRUE(b2.IsValid());
+}
+
+} // namespace
+} // namespace plac
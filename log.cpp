@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MIT
+
+#include "log.h"
+#include "poll_backoff.h"
+
+#include <cstdio>
+#include <exception>
+
+namespace plac {
+
+namespace {
+
+void Write(const LogRecord &r) {
+    const std::string line{FormatLogRecord(r)};
+    FILE *f{(r.severity_ == Severity::info) ? stdout : stderr};
+    std::fwrite(line.data(), 1, line.size(), f);
+    std::fflush(f);
+}
+
+} // namespace
+
+std::string FormatLogRecord(const LogRecord &r) {
+    std::string line{};
+    if (r.severity_ == Severity::error) {
+        line = std::format("flacplayer [{}:{} ({})] ", r.file_, r.line_, r.func_);
+    }
+    try {
+        r.format_(r, line);
+    } catch (const std::exception &e) {
+        line += std::format("invalid log record \"{}\": {}", r.fmt_, e.what());
+    }
+    line += '\n';
+    return line;
+}
+
+AsyncLog::AsyncLog() : thread_{[this]() { Run(); }} {}
+
+AsyncLog::~AsyncLog() noexcept {
+    {
+        std::lock_guard lock{mutex_};
+        stopped_ = true;
+    }
+    stop_.notify_one();
+    thread_.join();
+    Flush();
+}
+
+AsyncLog &AsyncLog::Instance() {
+    static AsyncLog log{};
+    return log;
+}
+
+void AsyncLog::Flush() {
+    Drain();
+    std::fflush(stdout);
+    std::fflush(stderr);
+}
+
+size_t AsyncLog::Drain() {
+    size_t count{0};
+    while (queue_.TryPop(Write)) {
+        ++count;
+    }
+    if (const size_t dropped{dropped_.exchange(0, std::memory_order_relaxed)}; dropped != 0) {
+        std::fprintf(stderr, "flacplayer dropped %zu log records\n", dropped);
+    }
+    return count;
+}
+
+void AsyncLog::Run() {
+    // polling keeps the writers free of any wake-up system call. a record
+    // written after a long idle time shows up with a delay of up to
+    // kMaxPollInterval
+    PollBackoff backoff{kPollInterval, kMaxPollInterval};
+    std::unique_lock lock{mutex_};
+    while (!stopped_) {
+        lock.unlock();
+        const size_t count{Drain()};
+        lock.lock();
+        if (count != 0) {
+            backoff.Reset();
+        } else {
+            stop_.wait_for(lock, backoff.Next(), [this]() { return stopped_; });
+        }
+    }
+}
+
+} // namespace plac
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef LOG_H
+#define LOG_H
+
+#include "mpmc_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace plac {
+
+enum class Severity {
+    info,  // written to stdout as is
+    error, // written to stderr with the source location
+};
+
+// Fixed-size binary log entry. The arguments are copied into args_ as they
+// are, strings included, and formatted later by the thread writing the log.
+struct LogRecord {
+    static constexpr size_t kArgsSize{512};
+    using FormatFn = void (*)(const LogRecord &, std::string &);
+
+    FormatFn format_{nullptr};
+    Severity severity_{Severity::error};
+    std::string_view file_;
+    std::string_view func_;
+    int line_{0};
+    std::string_view fmt_;
+    alignas(std::max_align_t) std::byte args_[kArgsSize];
+};
+
+// string argument copied into a record. longer strings are truncated.
+struct LogString {
+    char data_[95];
+    std::uint8_t size_;
+};
+
+template<typename T>
+auto EncodeLogArg(const T &v)
+{
+    if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+        LogString s{};
+        std::string_view sv{};
+        if constexpr (std::is_pointer_v<std::decay_t<T>>) {
+            sv = (v != nullptr) ? std::string_view{v} : std::string_view{"(null)"};
+        } else {
+            sv = v;
+        }
+        s.size_ = static_cast<std::uint8_t>(std::min(sv.size(), sizeof(s.data_)));
+        std::memcpy(s.data_, sv.data(), s.size_);
+        return s;
+    } else {
+        static_assert(std::is_trivially_copyable_v<std::decay_t<T>>,
+                      "log arguments must be strings or trivially copyable");
+        return std::decay_t<T>{v};
+    }
+}
+
+inline std::string_view DecodeLogArg(const LogString &s) { return {s.data_, s.size_}; }
+
+template<typename T>
+const T &DecodeLogArg(const T &v)
+{
+    return v;
+}
+
+template<typename Args>
+void FormatLogArgs(const LogRecord &r, std::string &out)
+{
+    const Args &args{*std::launder(reinterpret_cast<const Args *>(r.args_))};
+    std::apply(
+        [&r, &out](const auto &...encoded) {
+            auto decoded{std::tuple{DecodeLogArg(encoded)...}};
+            std::apply(
+                [&r, &out](auto &...d) { out += std::vformat(r.fmt_, std::make_format_args(d...)); },
+                decoded);
+        },
+        args);
+}
+
+// stores fmt and v in r. neither allocates nor blocks.
+template<typename... Ts>
+void EncodeLogRecord(LogRecord &r, const std::string_view fmt, const Ts &...v)
+{
+    using Args = std::tuple<decltype(EncodeLogArg(v))...>;
+    static_assert(sizeof(Args) <= LogRecord::kArgsSize, "too many log arguments");
+    static_assert(alignof(Args) <= alignof(std::max_align_t));
+    static_assert(std::is_trivially_destructible_v<Args>);
+
+    r.format_ = &FormatLogArgs<Args>;
+    r.fmt_ = fmt;
+    ::new (static_cast<void *>(r.args_)) Args{EncodeLogArg(v)...};
+}
+
+// line written for r, including the trailing newline
+std::string FormatLogRecord(const LogRecord &r);
+
+// Logging which is safe to call from the real-time thread. Callers only copy
+// a record into a lock-free queue. A background thread polls the queue, formats
+// the records and writes them. The poll interval grows while nothing is logged.
+// If the queue is full the record is dropped and counted.
+class AsyncLog {
+public:
+    static constexpr size_t kCapacity{256};
+    static constexpr std::chrono::milliseconds kPollInterval{10};
+    static constexpr std::chrono::milliseconds kMaxPollInterval{1000};
+
+    AsyncLog();
+    AsyncLog(const AsyncLog &) = delete;
+    AsyncLog(AsyncLog &&) = delete;
+    AsyncLog &operator=(const AsyncLog &) = delete;
+    AsyncLog &operator=(AsyncLog &&) = delete;
+    ~AsyncLog() noexcept;
+
+    // process wide log. the first call starts the background thread, so call it
+    // before any real-time thread is started.
+    static AsyncLog &Instance();
+
+    template<typename... Ts>
+    void Push(const Severity severity,
+              const std::string_view file,
+              const int line,
+              const std::string_view func,
+              const std::string_view fmt,
+              const Ts &...v)
+    {
+        const bool pushed{queue_.TryPush([&](LogRecord &r) {
+            r.severity_ = severity;
+            r.file_ = file;
+            r.line_ = line;
+            r.func_ = func;
+            EncodeLogRecord(r, fmt, v...);
+        })};
+        if (!pushed) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // writes all pending records from the calling thread
+    void Flush();
+
+private:
+    // returns the number of records written
+    size_t Drain();
+    void Run();
+
+    MpmcQueue<LogRecord, kCapacity> queue_{};
+    std::atomic<size_t> dropped_{0};
+    std::mutex mutex_{};
+    std::condition_variable stop_{};
+    bool stopped_{false};
+    std::thread thread_;
+};
+
+} // namespace plac
+
+#endif
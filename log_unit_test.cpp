@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: MIT
+
+#include "log.h"
+#include <gtest/gtest.h>
+#include <string>
+
+namespace plac {
+namespace {
+
+template <typename... Ts> std::string Format(const Severity severity, const Ts &...v) {
+  LogRecord r{};
+  r.severity_ = severity;
+  r.file_ = "file.cpp";
+  r.line_ = 42;
+  r.func_ = "Func";
+  EncodeLogRecord(r, v...);
+  return FormatLogRecord(r);
+}
+
+TEST(LogTest, NoArguments) {
+  EXPECT_EQ("flacplayer [file.cpp:42 (Func)] no arguments\n",
+            Format(Severity::error, "no arguments"));
+}
+
+TEST(LogTest, Info) { EXPECT_EQ("1/10: title\n", Format(Severity::info, "{}/{}: {}", 1, 10, "title")); }
+
+TEST(LogTest, Arithmetic) {
+  EXPECT_EQ("-1 4294967295 2.5 true x\n",
+            Format(Severity::info, "{} {} {} {} {}", -1, 4294967295U, 2.5, true, 'x'));
+}
+
+TEST(LogTest, FormatSpec) { EXPECT_EQ("  7|ab  \n", Format(Severity::info, "{:>3}|{:<4}", 7, "ab")); }
+
+TEST(LogTest, StringsAreCopied) {
+  char buffer[]{"before"};
+  LogRecord r{};
+  r.severity_ = Severity::info;
+  EncodeLogRecord(r, "{} {}", static_cast<const char *>(buffer), std::string{"temporary"});
+  buffer[0] = 'X';
+  EXPECT_EQ("before temporary\n", FormatLogRecord(r));
+}
+
+TEST(LogTest, NullString) {
+  EXPECT_EQ("(null)\n", Format(Severity::info, "{}", static_cast<const char *>(nullptr)));
+}
+
+TEST(LogTest, LongStringIsTruncated) {
+  const std::string s(1000, 'a');
+  EXPECT_EQ(std::string(sizeof(LogString::data_), 'a') + "\n", Format(Severity::info, "{}", s));
+}
+
+TEST(LogTest, Push) {
+  AsyncLog log{};
+  for (size_t i{0}; i < 2 * AsyncLog::kCapacity; ++i) {
+    log.Push(Severity::error, __FILE__, __LINE__, __func__, "record {} of {}", i, "Push");
+  }
+  log.Flush();
+}
+
+} // namespace
+} // namespace plac
@@ -8,7 +8,7 @@ int main(int argc, char *argv[]) {
   EXPECTS(argc > 1, "no file provided");
 
   ::plac::FlowControl flow{};
-  ::plac::AudioBuffer<228000> audio_buffer{};
+  ::plac::AudioBuffer<65536> audio_buffer{};
   ::plac::Stream stream{audio_buffer, flow};
   ::plac::CoreAudioDevice device{audio_buffer, flow};
 
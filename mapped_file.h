@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "conditions.h"
+#include "file_desc.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace plac {
+
+// Read-only mapping of a whole file which is consumed front to back.
+//
+// Pages behind the consumer are dropped with MADV_DONTNEED so that the
+// resident set stays flat even for multi-GB files. Pages ahead of the consumer
+// are requested with MADV_WILLNEED. Small files are prefaulted completely.
+struct MappedFile {
+  // files up to this size are prefaulted with MAP_POPULATE
+  static constexpr size_t kPopulateLimit{64U << 20U};
+  // granularity of MADV_DONTNEED and MADV_WILLNEED
+  static constexpr size_t kWindow{1U << 20U};
+
+  MappedFile() = default;
+  explicit MappedFile(const FileDesc &desc) {
+    struct stat st {};
+    if (!desc.IsValid() || (::fstat(desc.fd_, &st) != 0) || (st.st_size <= 0)) {
+      return;
+    }
+    const size_t size{static_cast<size_t>(st.st_size)};
+    const int flags{MAP_PRIVATE | ((size <= kPopulateLimit) ? MAP_POPULATE : 0)};
+    void *data{::mmap(nullptr, size, PROT_READ, flags, desc.fd_, 0)};
+    if (data == MAP_FAILED) {
+      return;
+    }
+    data_ = static_cast<const u_char *>(data);
+    size_ = size;
+    // after mlockall(MCL_FUTURE) the mapping is locked, and MADV_DONTNEED fails on locked pages
+    EXPECTS(::munlock(data, size_) == 0, "cannot unlock mapping");
+    EXPECTS(::madvise(data, size_, MADV_SEQUENTIAL) == 0, "cannot advise sequential access");
+    Prefetch(0);
+  }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept
+      : data_{other.data_}, size_{other.size_}, released_{other.released_} {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.released_ = 0;
+  }
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (data_ == other.data_) {
+      return *this;
+    }
+    Unmap();
+    data_ = other.data_;
+    size_ = other.size_;
+    released_ = other.released_;
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.released_ = 0;
+    return *this;
+  }
+  ~MappedFile() noexcept { Unmap(); }
+
+  bool IsValid() const { return data_ != nullptr; }
+
+  // everything before offset has been consumed
+  void Release(const size_t offset) {
+    const size_t end{std::min(offset, size_) / kWindow * kWindow};
+    if (end <= released_) {
+      return;
+    }
+    // the mapping is private and read-only, pages are refetched from the page cache if touched again
+    EXPECTS(::madvise(const_cast<u_char *>(data_) + released_, end - released_, MADV_DONTNEED) == 0,
+            "cannot drop consumed pages");
+    released_ = end;
+    Prefetch(end);
+  }
+
+  const u_char *data_{nullptr};
+  size_t size_{0};
+  size_t released_{0};
+
+private:
+  // keeps two windows ahead of the consumer in flight
+  void Prefetch(const size_t offset) const {
+    if (offset < size_) {
+      // best effort, failure only costs a page fault later on
+      ::madvise(const_cast<u_char *>(data_) + offset, std::min(2 * kWindow, size_ - offset),
+                MADV_WILLNEED);
+    }
+  }
+
+  void Unmap() {
+    if (IsValid()) {
+      EXPECTS(::munmap(const_cast<u_char *>(data_), size_) == 0, "cannot unmap file");
+    }
+  }
+};
+
+} // namespace plac
+
+#endif
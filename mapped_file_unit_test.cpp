@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+
+#include "mapped_file.h"
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <vector>
+
+namespace plac {
+namespace {
+
+class MappedFileTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    content_.resize(3 * MappedFile::kWindow + 123);
+    std::iota(content_.begin(), content_.end(), 0);
+
+    FILE *f{std::fopen(kName, "wb")};
+    ASSERT_NE(nullptr, f);
+    ASSERT_EQ(content_.size(), std::fwrite(content_.data(), 1, content_.size(), f));
+    ASSERT_EQ(0, std::fclose(f));
+  }
+  void TearDown() override { std::remove(kName); }
+
+  static constexpr const char *kName{"mapped_file_unit_test.bin"};
+  std::vector<u_char> content_;
+};
+
+TEST_F(MappedFileTest, DefaultConstructor) {
+  MappedFile m{};
+  EXPECT_FALSE(m.IsValid());
+}
+
+TEST_F(MappedFileTest, InvalidFileDesc) {
+  MappedFile m{FileDesc{}};
+  EXPECT_FALSE(m.IsValid());
+}
+
+TEST_F(MappedFileTest, EmptyFile) {
+  MappedFile m{FileDesc{"/dev/null"}};
+  EXPECT_FALSE(m.IsValid());
+}
+
+TEST_F(MappedFileTest, Constructor) {
+  MappedFile m{FileDesc{kName}};
+  ASSERT_TRUE(m.IsValid());
+  EXPECT_EQ(content_.size(), m.size_);
+  EXPECT_EQ(content_, (std::vector<u_char>{m.data_, m.data_ + m.size_}));
+}
+
+TEST_F(MappedFileTest, Release) {
+  MappedFile m{FileDesc{kName}};
+  ASSERT_TRUE(m.IsValid());
+
+  m.Release(MappedFile::kWindow - 1);
+  EXPECT_EQ(0, m.released_);
+  m.Release(2 * MappedFile::kWindow + 1);
+  EXPECT_EQ(2 * MappedFile::kWindow, m.released_);
+  m.Release(MappedFile::kWindow);
+  EXPECT_EQ(2 * MappedFile::kWindow, m.released_);
+  m.Release(m.size_);
+  EXPECT_EQ(3 * MappedFile::kWindow, m.released_);
+
+  // released pages are faulted in again from the file
+  EXPECT_EQ(content_, (std::vector<u_char>{m.data_, m.data_ + m.size_}));
+}
+
+TEST_F(MappedFileTest, MoveConstructor) {
+  MappedFile m1{FileDesc{kName}};
+  EXPECT_TRUE(m1.IsValid());
+  MappedFile m2{std::move(m1)};
+  EXPECT_FALSE(m1.IsValid());
+  EXPECT_TRUE(m2.IsValid());
+}
+
+TEST_F(MappedFileTest, MoveAssignment) {
+  MappedFile m1{FileDesc{kName}};
+  EXPECT_TRUE(m1.IsValid());
+  MappedFile m2{FileDesc{kName}};
+  EXPECT_TRUE(m2.IsValid());
+  m2 = std::move(m1);
+  EXPECT_FALSE(m1.IsValid());
+  EXPECT_TRUE(m2.IsValid());
+}
+
+} // namespace
+} // namespace plac
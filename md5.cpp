@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: MIT
+
+#include "md5.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace plac {
+
+namespace {
+
+constexpr std::array<uint32_t, 64> kSines{
+    0xD76AA478U, 0xE8C7B756U, 0x242070DBU, 0xC1BDCEEEU, 0xF57C0FAFU, 0x4787C62AU, 0xA8304613U,
+    0xFD469501U, 0x698098D8U, 0x8B44F7AFU, 0xFFFF5BB1U, 0x895CD7BEU, 0x6B901122U, 0xFD987193U,
+    0xA679438EU, 0x49B40821U, 0xF61E2562U, 0xC040B340U, 0x265E5A51U, 0xE9B6C7AAU, 0xD62F105DU,
+    0x02441453U, 0xD8A1E681U, 0xE7D3FBC8U, 0x21E1CDE6U, 0xC33707D6U, 0xF4D50D87U, 0x455A14EDU,
+    0xA9E3E905U, 0xFCEFA3F8U, 0x676F02D9U, 0x8D2A4C8AU, 0xFFFA3942U, 0x8771F681U, 0x6D9D6122U,
+    0xFDE5380CU, 0xA4BEEA44U, 0x4BDECFA9U, 0xF6BB4B60U, 0xBEBFBC70U, 0x289B7EC6U, 0xEAA127FAU,
+    0xD4EF3085U, 0x04881D05U, 0xD9D4D039U, 0xE6DB99E5U, 0x1FA27CF8U, 0xC4AC5665U, 0xF4292244U,
+    0x432AFF97U, 0xAB9423A7U, 0xFC93A039U, 0x655B59C3U, 0x8F0CCC92U, 0xFFEFF47DU, 0x85845DD1U,
+    0x6FA87E4FU, 0xFE2CE6E0U, 0xA3014314U, 0x4E0811A1U, 0xF7537E82U, 0xBD3AF235U, 0x2AD7D2BBU,
+    0xEB86D391U};
+
+// rotations per round, each repeated for the 16 steps of the round
+constexpr std::array<int, 16> kShifts{7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+
+} // namespace
+
+void Md5::Transform(const u_char *block) {
+  std::array<uint32_t, 16> m{};
+  for (size_t i{0}; i < m.size(); ++i) {
+    m[i] = uint32_t{block[4 * i]} | (uint32_t{block[4 * i + 1]} << 8U)
+           | (uint32_t{block[4 * i + 2]} << 16U) | (uint32_t{block[4 * i + 3]} << 24U);
+  }
+  uint32_t a{state_[0]};
+  uint32_t b{state_[1]};
+  uint32_t c{state_[2]};
+  uint32_t d{state_[3]};
+  for (size_t i{0}; i < 64; ++i) {
+    uint32_t f{0};
+    size_t g{0};
+    if (i < 16) {
+      f = (b & c) | (~b & d);
+      g = i;
+    } else if (i < 32) {
+      f = (d & b) | (~d & c);
+      g = (5 * i + 1) % 16;
+    } else if (i < 48) {
+      f = b ^ c ^ d;
+      g = (3 * i + 5) % 16;
+    } else {
+      f = c ^ (b | ~d);
+      g = (7 * i) % 16;
+    }
+    const uint32_t rotated{std::rotl(a + f + kSines[i] + m[g], kShifts[(i / 16) * 4 + i % 4])};
+    a = d;
+    d = c;
+    c = b;
+    b += rotated;
+  }
+  state_[0] += a;
+  state_[1] += b;
+  state_[2] += c;
+  state_[3] += d;
+}
+
+void Md5::Update(std::span<const u_char> data) {
+  size_t used{static_cast<size_t>(bytes_ % block_.size())};
+  bytes_ += data.size();
+  if (used != 0) {
+    const size_t n{std::min(block_.size() - used, data.size())};
+    std::memcpy(&block_[used], data.data(), n);
+    data = data.subspan(n);
+    used += n;
+    if (used < block_.size()) {
+      return;
+    }
+    Transform(block_.data());
+  }
+  while (data.size() >= block_.size()) {
+    Transform(data.data());
+    data = data.subspan(block_.size());
+  }
+  if (!data.empty()) {
+    std::memcpy(block_.data(), data.data(), data.size());
+  }
+}
+
+Md5::Digest Md5::Final() {
+  const uint64_t bits{bytes_ * 8};
+  // a one bit, zeros up to 56 bytes of the last block and the length
+  std::array<u_char, 72> padding{0x80};
+  const size_t used{static_cast<size_t>(bytes_ % block_.size())};
+  const size_t n{((used < 56) ? 56 : 120) - used};
+  for (size_t i{0}; i < 8; ++i) {
+    padding[n + i] = static_cast<u_char>(bits >> (8 * i));
+  }
+  Update({padding.data(), n + 8});
+
+  Digest digest{};
+  for (size_t i{0}; i < digest.size(); ++i) {
+    digest[i] = static_cast<u_char>(state_[i / 4] >> (8 * (i % 4)));
+  }
+  return digest;
+}
+
+} // namespace plac
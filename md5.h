@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef MD5_H
+#define MD5_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <sys/types.h>
+
+namespace plac {
+
+// MD5 of RFC 1321, as STREAMINFO holds it for the decoded samples. FLAC
+// hashes the samples interleaved and little endian in the fewest whole bytes,
+// which is the S16_LE and S24_3LE layout of AudioBuffer.
+class Md5 {
+public:
+  using Digest = std::array<u_char, 16>;
+
+  void Update(std::span<const u_char> data);
+  // pads the message. call Reset() before hashing the next one
+  Digest Final();
+  void Reset() { *this = Md5{}; }
+
+private:
+  void Transform(const u_char *block);
+
+  std::array<uint32_t, 4> state_{0x67452301U, 0xEFCDAB89U, 0x98BADCFEU, 0x10325476U};
+  std::array<u_char, 64> block_{};
+  uint64_t bytes_{0};
+};
+
+} // namespace plac
+
+#endif
@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: MIT
+
+#include "md5.h"
+#include <format>
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+
+namespace plac {
+namespace {
+
+std::string Hex(const Md5::Digest &digest) {
+  std::string hex{};
+  for (const u_char c : digest) {
+    hex += std::format("{:02x}", c);
+  }
+  return hex;
+}
+
+std::span<const u_char> Bytes(const std::string_view text) {
+  return {reinterpret_cast<const u_char *>(text.data()), text.size()};
+}
+
+// test suite of RFC 1321
+TEST(Md5Test, Reference) {
+  const std::pair<std::string_view, std::string_view> cases[]{
+      {"", "d41d8cd98f00b204e9800998ecf8427e"},
+      {"a", "0cc175b9c0f1b6a831c399e269772661"},
+      {"abc", "900150983cd24fb0d6963f7d28e17f72"},
+      {"message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+      {"abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b"},
+      {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+       "d174ab98d277d9f5a5611c2c9f419d9f"},
+      {"12345678901234567890123456789012345678901234567890123456789012345678901234567890",
+       "57edf4a22be3c955ac49da2e2107b67a"},
+  };
+  for (const auto &[text, expected] : cases) {
+    Md5 md5{};
+    md5.Update(Bytes(text));
+    EXPECT_EQ(expected, Hex(md5.Final())) << text;
+  }
+}
+
+TEST(Md5Test, Incremental) {
+  const std::string text(1000, 'x');
+  Md5 whole{};
+  whole.Update(Bytes(text));
+  const Md5::Digest expected{whole.Final()};
+
+  // pieces which straddle the blocks in every way
+  for (size_t piece{1}; piece <= 130; ++piece) {
+    Md5 md5{};
+    for (size_t i{0}; i < text.size(); i += piece) {
+      md5.Update(Bytes(std::string_view{text}.substr(i, piece)));
+    }
+    EXPECT_EQ(expected, md5.Final()) << piece;
+  }
+
+  whole.Reset();
+  whole.Update(Bytes(text));
+  EXPECT_EQ(expected, whole.Final());
+}
+
+} // namespace
+} // namespace plac
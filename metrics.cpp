@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: MIT
+
+#include "metrics.h"
+#include "cache_file.h"
+#include <format>
+#include <span>
+
+namespace plac {
+
+namespace {
+
+void AppendHeader(std::string &out, const std::string_view name, const std::string_view type,
+                  const std::string_view help) {
+  out += std::format("# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+template <typename T>
+void AppendCounter(std::string &out, const std::string_view name, const std::string_view help,
+                   const T value) {
+  AppendHeader(out, name, "counter", help);
+  out += std::format("{} {}\n", name, value);
+}
+
+void AppendGauge(std::string &out, const std::string_view name, const std::string_view help,
+                 const double value) {
+  AppendHeader(out, name, "gauge", help);
+  out += std::format("{} {}\n", name, value);
+}
+
+// values are divided by scale, e.g. to export microseconds as seconds
+template <size_t N>
+void AppendHistogram(std::string &out, const std::string_view name, const std::string_view help,
+                     const Histogram<N> &h, const double scale) {
+  AppendHeader(out, name, "histogram", help);
+  uint64_t cumulative{0};
+  for (size_t i{0}; i < N; ++i) {
+    cumulative += h.counts_[i].load(std::memory_order_relaxed);
+    out += std::format("{}_bucket{{le=\"{}\"}} {}\n", name,
+                       static_cast<double>(h.bounds_[i]) / scale, cumulative);
+  }
+  cumulative += h.counts_[N].load(std::memory_order_relaxed);
+  out += std::format("{}_bucket{{le=\"+Inf\"}} {}\n", name, cumulative);
+  out += std::format("{}_sum {}\n", name,
+                     static_cast<double>(h.sum_.load(std::memory_order_relaxed)) / scale);
+  // the buckets are read one by one, so report the count they add up to
+  out += std::format("{}_count {}\n", name, cumulative);
+}
+
+} // namespace
+
+std::string FormatPrometheus(const PlaybackMetrics &m) {
+  std::string out{};
+  AppendCounter(out, "plac_xruns_total", "Buffer underruns of the audio device.",
+                m.xruns_.load(std::memory_order_relaxed));
+  AppendCounter(out, "plac_recovers_total", "Calls of snd_pcm_recover().",
+                m.recovers_.load(std::memory_order_relaxed));
+  AppendCounter(out, "plac_frames_total", "Frames committed to the hardware buffer.",
+                m.frames_.load(std::memory_order_relaxed));
+  AppendCounter(out, "plac_decoded_frames_total", "Frames decoded.",
+                m.decoded_frames_.load(std::memory_order_relaxed));
+
+  const double decode_seconds{static_cast<double>(m.decode_ns_.load(std::memory_order_relaxed))
+                              / 1e9};
+  AppendCounter(out, "plac_decode_seconds_total", "Time spent decoding.", decode_seconds);
+  const unsigned int rate{m.rate_.load(std::memory_order_relaxed)};
+  const uint64_t decoded{m.decoded_frames_.load(std::memory_order_relaxed)};
+  const double audio_seconds{(rate != 0) ? static_cast<double>(decoded) / rate : 0.0};
+  AppendGauge(out, "plac_decode_seconds_per_audio_second",
+              "Decode time per second of decoded audio.",
+              (audio_seconds > 0.0) ? decode_seconds / audio_seconds : 0.0);
+
+  const uint64_t min_fill{m.fill_percent_.min_.load(std::memory_order_relaxed)};
+  AppendGauge(out, "plac_hw_buffer_fill_ratio_min",
+              "Lowest hardware buffer fill level seen at a wakeup.",
+              (m.fill_percent_.count_.load(std::memory_order_relaxed) != 0)
+                  ? static_cast<double>(min_fill) / 100.0
+                  : 0.0);
+  AppendHistogram(out, "plac_hw_buffer_fill_ratio", "Hardware buffer fill level at each wakeup.",
+                  m.fill_percent_, 100.0);
+  AppendHistogram(out, "plac_wakeup_lateness_seconds",
+                  "Delay of each wakeup against its period boundary.", m.lateness_us_, 1e6);
+  AppendHistogram(out, "plac_start_latency_seconds",
+                  "Time from preparing the audio device until the stream starts.",
+                  m.start_latency_us_, 1e6);
+  AppendCounter(out, "plac_read_stalls_total", "Reads which waited for the storage.",
+                m.read_stalls_.load(std::memory_order_relaxed));
+  AppendCounter(out, "plac_read_stall_seconds_total", "Time spent waiting for the storage.",
+                static_cast<double>(m.read_stall_ns_.load(std::memory_order_relaxed)) / 1e9);
+  AppendHistogram(out, "plac_readahead_blocks",
+                  "Completed reads ahead of the decoder when it moves to the next block.",
+                  m.readahead_blocks_, 1.0);
+  return out;
+}
+
+MetricsExporter::MetricsExporter(const PlaybackMetrics &metrics, std::string path,
+                                 const std::chrono::milliseconds interval)
+    : metrics_{metrics}, path_{std::move(path)}, interval_{interval}, mutex_{}, cv_{},
+      stop_{false}, thread_{[this]() { Run(); }} {}
+
+MetricsExporter::~MetricsExporter() noexcept {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+  Export();
+}
+
+bool MetricsExporter::Export() const {
+  const std::string text{FormatPrometheus(metrics_)};
+  return WriteFileAtomically(path_, {std::as_bytes(std::span{text})});
+}
+
+void MetricsExporter::Run() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (!cv_.wait_for(lock, interval_, [this]() { return stop_; })) {
+    lock.unlock();
+    Export();
+    lock.lock();
+  }
+}
+
+} // namespace plac
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace plac {
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+// Fixed buckets with inclusive upper bounds and an implicit +Inf bucket.
+// Add() is called by a single writer, any thread may read concurrently.
+template <size_t N> struct Histogram {
+  explicit Histogram(const std::array<uint64_t, N> &bounds) : bounds_{bounds} {}
+  Histogram(const Histogram &) = delete;
+  Histogram(Histogram &&) = delete;
+  Histogram &operator=(const Histogram &) = delete;
+  Histogram &operator=(Histogram &&) = delete;
+  ~Histogram() noexcept = default;
+
+  void Add(const uint64_t v) {
+    const auto i{std::lower_bound(bounds_.begin(), bounds_.end(), v) - bounds_.begin()};
+    counts_[static_cast<size_t>(i)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(v, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    if (v < min_.load(std::memory_order_relaxed)) {
+      min_.store(v, std::memory_order_relaxed);
+    }
+  }
+
+  const std::array<uint64_t, N> bounds_;
+  std::array<std::atomic<uint64_t>, N + 1> counts_{};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> min_{std::numeric_limits<uint64_t>::max()};
+};
+
+// Health of the playback path. Counters are updated with relaxed atomics by
+// the output and decode threads and exported by MetricsExporter.
+struct PlaybackMetrics {
+  // snd_pcm_recover() calls and the underruns among them
+  std::atomic<uint64_t> recovers_{0};
+  std::atomic<uint64_t> xruns_{0};
+  // frames committed to the hardware buffer
+  std::atomic<uint64_t> frames_{0};
+  // time spent in the decoder, excluding waits for space in AudioBuffer
+  std::atomic<uint64_t> decode_ns_{0};
+  std::atomic<uint64_t> decoded_frames_{0};
+  std::atomic<unsigned int> rate_{0};
+  // reads of the uring input which waited for the storage, and the time waited
+  std::atomic<uint64_t> read_stalls_{0};
+  std::atomic<uint64_t> read_stall_ns_{0};
+
+  // hardware buffer fill level at each wakeup, in percent of the buffer size
+  Histogram<7> fill_percent_{{10, 25, 50, 60, 75, 90, 100}};
+  // delay of each wakeup against the period boundary derived from the stream start
+  Histogram<10> lateness_us_{{50, 100, 250, 500, 1'000, 2'500, 5'000, 10'000, 50'000, 100'000}};
+  // time from preparing the stream, initially or after a recovery, until it is started
+  Histogram<8> start_latency_us_{
+      {10'000, 25'000, 50'000, 100'000, 250'000, 500'000, 1'000'000, 2'500'000}};
+  // completed reads of the uring input ahead of the decoder whenever it moves
+  // on to the next block
+  Histogram<5> readahead_blocks_{{0, 1, 2, 4, 8}};
+};
+
+// metrics in the Prometheus text exposition format
+std::string FormatPrometheus(const PlaybackMetrics &metrics);
+
+// Writes the metrics to path every interval from a background thread, and once
+// more on destruction. The file is replaced atomically so a scraper never sees
+// a partial file.
+class MetricsExporter {
+public:
+  static constexpr std::chrono::milliseconds kDefaultInterval{10'000};
+
+  MetricsExporter(const PlaybackMetrics &metrics, std::string path,
+                  std::chrono::milliseconds interval = kDefaultInterval);
+  MetricsExporter(const MetricsExporter &) = delete;
+  MetricsExporter(MetricsExporter &&) = delete;
+  MetricsExporter &operator=(const MetricsExporter &) = delete;
+  MetricsExporter &operator=(MetricsExporter &&) = delete;
+  ~MetricsExporter() noexcept;
+
+  bool Export() const;
+
+private:
+  void Run();
+
+  const PlaybackMetrics &metrics_;
+  const std::string path_;
+  const std::chrono::milliseconds interval_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_;
+  std::thread thread_;
+};
+
+} // namespace plac
+
+#endif
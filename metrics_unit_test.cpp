@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: MIT
+
+#include "metrics.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+namespace plac {
+namespace {
+
+TEST(HistogramTest, Buckets) {
+  Histogram<3> h{{10, 20, 30}};
+  h.Add(0);
+  h.Add(10);
+  h.Add(11);
+  h.Add(30);
+  h.Add(31);
+  EXPECT_EQ(2U, h.counts_[0].load());
+  EXPECT_EQ(1U, h.counts_[1].load());
+  EXPECT_EQ(1U, h.counts_[2].load());
+  EXPECT_EQ(1U, h.counts_[3].load());
+  EXPECT_EQ(5U, h.count_.load());
+  EXPECT_EQ(82U, h.sum_.load());
+  EXPECT_EQ(0U, h.min_.load());
+}
+
+TEST(HistogramTest, Min) {
+  Histogram<1> h{{10}};
+  h.Add(7);
+  h.Add(3);
+  h.Add(5);
+  EXPECT_EQ(3U, h.min_.load());
+}
+
+TEST(MetricsTest, FormatPrometheus) {
+  PlaybackMetrics m{};
+  m.xruns_ = 2;
+  m.recovers_ = 3;
+  m.frames_ = 44100;
+  m.rate_ = 44100;
+  m.decoded_frames_ = 88200;
+  m.decode_ns_ = 100'000'000;
+  m.fill_percent_.Add(50);
+  m.fill_percent_.Add(95);
+  m.lateness_us_.Add(120);
+  m.start_latency_us_.Add(40'000);
+  m.read_stalls_ = 2;
+  m.read_stall_ns_ = 3'000'000;
+  m.readahead_blocks_.Add(0);
+  m.readahead_blocks_.Add(3);
+
+  const std::string text{FormatPrometheus(m)};
+  EXPECT_NE(std::string::npos, text.find("# TYPE plac_xruns_total counter\nplac_xruns_total 2\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_recovers_total 3\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_frames_total 44100\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_decode_seconds_total 0.1\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_decode_seconds_per_audio_second 0.05\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_hw_buffer_fill_ratio_min 0.5\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_hw_buffer_fill_ratio_bucket{le=\"0.25\"} 0\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_hw_buffer_fill_ratio_bucket{le=\"0.5\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_hw_buffer_fill_ratio_bucket{le=\"1\"} 2\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_hw_buffer_fill_ratio_count 2\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_wakeup_lateness_seconds_bucket{le=\"0.0001\"} 0\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_wakeup_lateness_seconds_bucket{le=\"0.00025\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_wakeup_lateness_seconds_bucket{le=\"+Inf\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_wakeup_lateness_seconds_sum 0.00012\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_start_latency_seconds_bucket{le=\"0.025\"} 0\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_start_latency_seconds_bucket{le=\"0.05\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_start_latency_seconds_sum 0.04\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_read_stalls_total 2\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_read_stall_seconds_total 0.003\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_readahead_blocks_bucket{le=\"0\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_readahead_blocks_bucket{le=\"2\"} 1\n"));
+  EXPECT_NE(std::string::npos, text.find("plac_readahead_blocks_bucket{le=\"4\"} 2\n"));
+}
+
+TEST(MetricsTest, Export) {
+  constexpr const char *kName{"metrics_unit_test.prom"};
+  PlaybackMetrics m{};
+  m.xruns_ = 1;
+  {
+    MetricsExporter exporter{m, kName, std::chrono::hours{1}};
+    m.xruns_ = 4;
+  }
+  std::ifstream f{kName};
+  std::stringstream content{};
+  content << f.rdbuf();
+  EXPECT_EQ(FormatPrometheus(m), content.str());
+  std::remove(kName);
+}
+
+TEST(MetricsTest, ExportInvalidPath) {
+  PlaybackMetrics m{};
+  MetricsExporter exporter{m, "/nonexistent/metrics.prom", std::chrono::hours{1}};
+  EXPECT_FALSE(exporter.Export());
+}
+
+} // namespace
+} // namespace plac
@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace plac {
+
+// Bounded lock-free multi-producer multi-consumer queue.
+//
+// Implements https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// Elements are filled and consumed in place, so pushing never allocates and
+// never blocks. A full queue rejects the element.
+template <typename T, size_t N> class MpmcQueue {
+public:
+    MpmcQueue()
+    {
+        for (size_t i{0}; i < N; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue(MpmcQueue &&) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(MpmcQueue &&) = delete;
+    ~MpmcQueue() noexcept = default;
+
+    // fill is called with the element to be written. returns false if full.
+    template<typename F>
+    bool TryPush(F &&fill)
+    {
+        size_t pos{enqueue_.load(std::memory_order_relaxed)};
+        Cell *cell{nullptr};
+        while (true) {
+            cell = &cells_[pos & (N - 1)];
+            const size_t sequence{cell->sequence.load(std::memory_order_acquire)};
+            const auto diff{static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos)};
+            if (diff == 0) {
+                if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+        std::forward<F>(fill)(cell->data);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consume is called with the element to be read. returns false if empty.
+    template<typename F>
+    bool TryPop(F &&consume)
+    {
+        size_t pos{dequeue_.load(std::memory_order_relaxed)};
+        Cell *cell{nullptr};
+        while (true) {
+            cell = &cells_[pos & (N - 1)];
+            const size_t sequence{cell->sequence.load(std::memory_order_acquire)};
+            const auto diff{static_cast<std::intptr_t>(sequence)
+                            - static_cast<std::intptr_t>(pos + 1)};
+            if (diff == 0) {
+                if (dequeue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_.load(std::memory_order_relaxed);
+            }
+        }
+        std::forward<F>(consume)(static_cast<const T &>(cell->data));
+        cell->sequence.store(pos + N, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static_assert((N >= 2) && ((N & (N - 1)) == 0), "N must be a power of two.");
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    Cell cells_[N];
+    alignas(64) std::atomic<size_t> enqueue_{0};
+    alignas(64) std::atomic<size_t> dequeue_{0};
+};
+
+} // namespace plac
+
+#endif
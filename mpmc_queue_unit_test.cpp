@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT
+
+#include "mpmc_queue.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace plac {
+namespace {
+
+TEST(MpmcQueueTest, Empty) {
+  MpmcQueue<int, 4> q{};
+  EXPECT_FALSE(q.TryPop([](const int &) {}));
+}
+
+TEST(MpmcQueueTest, Full) {
+  MpmcQueue<int, 4> q{};
+  for (int i{0}; i < 4; ++i) {
+    EXPECT_TRUE(q.TryPush([i](int &v) { v = i; }));
+  }
+  EXPECT_FALSE(q.TryPush([](int &v) { v = 4; }));
+
+  int popped{-1};
+  EXPECT_TRUE(q.TryPop([&popped](const int &v) { popped = v; }));
+  EXPECT_EQ(0, popped);
+  EXPECT_TRUE(q.TryPush([](int &v) { v = 4; }));
+}
+
+TEST(MpmcQueueTest, Order) {
+  MpmcQueue<int, 4> q{};
+  std::vector<int> popped{};
+  for (int i{0}; i < 10; ++i) {
+    EXPECT_TRUE(q.TryPush([i](int &v) { v = i; }));
+    EXPECT_TRUE(q.TryPop([&popped](const int &v) { popped.push_back(v); }));
+  }
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), popped);
+}
+
+TEST(MpmcQueueTest, Producers) {
+  constexpr int kProducers{4};
+  constexpr int kCount{20000};
+  MpmcQueue<int, 64> q{};
+
+  std::vector<std::thread> producers{};
+  for (int p{0}; p < kProducers; ++p) {
+    producers.emplace_back([&q]() {
+      for (int i{1}; i <= kCount; ++i) {
+        while (!q.TryPush([i](int &v) { v = i; })) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  long long sum{0};
+  int popped{0};
+  while (popped < kProducers * kCount) {
+    if (q.TryPop([&sum](const int &v) { sum += v; })) {
+      ++popped;
+    }
+  }
+  for (auto &t : producers) {
+    t.join();
+  }
+
+  EXPECT_EQ(static_cast<long long>(kProducers) * kCount * (kCount + 1) / 2, sum);
+  EXPECT_FALSE(q.TryPop([](const int &) {}));
+}
+
+} // namespace
+} // namespace plac
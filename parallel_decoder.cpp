@@ -0,0 +1,303 @@
+// SPDX-License-Identifier: MIT
+
+#include "parallel_decoder.h"
+#include "conditions.h"
+#include "file_desc.h"
+#include "flac_frame.h"
+#include "interleave.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace plac {
+
+namespace {
+
+// decoded PCM of the frames between two split points
+struct Chunk {
+  std::vector<u_char> pcm_;
+  // sample numbers of the first decoded frame and behind the last one
+  uint64_t first_sample_;
+  uint64_t end_sample_;
+  bool written_;
+  // libFLAC reported an error or the frames were not consecutive
+  bool failed_;
+  bool done_;
+};
+
+} // namespace
+
+struct ParallelDecoder::Worker {
+  FLAC__StreamDecoder *decoder_;
+  // "fLaC" and the STREAMINFO block, read before frames_
+  std::array<u_char, 42> head_;
+  std::span<const u_char> frames_;
+  size_t offset_;
+  AudioFormat format_;
+  Chunk *chunk_;
+  // set for the single threaded fallback, which hands every frame to write_
+  // instead of collecting the PCM in chunk_
+  const WriteFn *write_;
+  bool stopped_;
+};
+
+namespace {
+
+using Worker = ParallelDecoder::Worker;
+
+FLAC__StreamDecoderReadStatus read_callback(const FLAC__StreamDecoder *, FLAC__byte *buffer,
+                                            size_t *bytes, void *client_data) {
+  Worker *worker{static_cast<Worker *>(client_data)};
+  size_t n{0};
+  if (worker->offset_ < worker->head_.size()) {
+    n = std::min(*bytes, worker->head_.size() - worker->offset_);
+    std::memcpy(buffer, &worker->head_[worker->offset_], n);
+  } else {
+    const size_t offset{worker->offset_ - worker->head_.size()};
+    n = std::min(*bytes, worker->frames_.size() - offset);
+    std::memcpy(buffer, &worker->frames_[offset], n);
+  }
+  worker->offset_ += n;
+  *bytes = n;
+  return (n > 0) ? FLAC__STREAM_DECODER_READ_STATUS_CONTINUE
+                 : FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+}
+
+FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *,
+                                              const FLAC__Frame *frame,
+                                              const FLAC__int32 *const buffer[],
+                                              void *client_data) {
+  Worker *worker{static_cast<Worker *>(client_data)};
+  Chunk &chunk{*worker->chunk_};
+  const uint32_t blocksize{frame->header.blocksize};
+  // libFLAC converts frame numbers to sample numbers before the callback
+  const uint64_t sample{frame->header.number.sample_number};
+
+  if ((frame->header.bits_per_sample != worker->format_.bits)
+      || (frame->header.channels != worker->format_.channels)
+      || (chunk.written_ && (sample != chunk.end_sample_))) {
+    chunk.failed_ = true;
+    return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+  }
+  if (!chunk.written_) {
+    chunk.first_sample_ = sample;
+    chunk.written_ = true;
+  }
+  chunk.end_sample_ = sample + blocksize;
+
+  const size_t size{AsBytes(worker->format_, blocksize)};
+  if (worker->write_ == nullptr) {
+    const size_t used{chunk.pcm_.size()};
+    chunk.pcm_.resize(used + size);
+    Interleave(worker->format_, buffer[0], buffer[1], blocksize, &chunk.pcm_[used]);
+    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+  }
+
+  chunk.pcm_.resize(size);
+  Interleave(worker->format_, buffer[0], buffer[1], blocksize, chunk.pcm_.data());
+  if (!(*worker->write_)(worker->format_, chunk.pcm_)) {
+    worker->stopped_ = true;
+    return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+  }
+  return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void error_callback(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus, void *client_data) {
+  static_cast<Worker *>(client_data)->chunk_->failed_ = true;
+}
+
+// decodes frames as a stream of their own which consists of STREAMINFO only
+void DecodeChunk(Worker &worker, const std::span<const u_char> info_block,
+                 const std::span<const u_char> frames, const AudioFormat format, Chunk &chunk) {
+  std::memcpy(worker.head_.data(), "fLaC", 4);
+  std::copy(info_block.begin(), info_block.end(), worker.head_.begin() + 4);
+  // STREAMINFO is the last metadata block
+  worker.head_[4] |= 0x80U;
+  worker.frames_ = frames;
+  worker.offset_ = 0;
+  worker.format_ = format;
+  worker.chunk_ = &chunk;
+
+  ENSURES(FLAC__stream_decoder_reset(worker.decoder_), "cannot reset decoder");
+  if (!FLAC__stream_decoder_process_until_end_of_stream(worker.decoder_)) {
+    chunk.failed_ = true;
+  }
+}
+
+} // namespace
+
+ParallelDecoder::ParallelDecoder(unsigned int threads, const size_t chunk_bytes)
+    : chunk_bytes_{chunk_bytes}, workers_{} {
+  if (threads == 0) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+  for (unsigned int i{0}; i < threads; ++i) {
+    auto worker{std::make_unique<Worker>()};
+    worker->decoder_ = FLAC__stream_decoder_new();
+    ENSURES(worker->decoder_ != nullptr, "cannot create FLAC decoder");
+    const FLAC__StreamDecoderInitStatus init_status{FLAC__stream_decoder_init_stream(
+        worker->decoder_, read_callback, nullptr, nullptr, nullptr, nullptr, write_callback,
+        nullptr, error_callback, worker.get())};
+    ENSURES(init_status == FLAC__STREAM_DECODER_INIT_STATUS_OK, "cannot initialize FLAC decoder");
+    workers_.push_back(std::move(worker));
+  }
+}
+
+ParallelDecoder::~ParallelDecoder() noexcept {
+  for (const std::unique_ptr<Worker> &worker : workers_) {
+    FLAC__stream_decoder_finish(worker->decoder_);
+    FLAC__stream_decoder_delete(worker->decoder_);
+  }
+}
+
+bool ParallelDecoder::Decode(const std::span<const u_char> data, const WriteFn &write) {
+  stats_ = Stats{};
+  const std::optional<StreamLayout> layout{ParseStreamLayout(data)};
+  if (!layout) {
+    LOG_ERROR("not a FLAC file");
+    return false;
+  }
+  const StreamInfo &info{layout->info_};
+  const AudioFormat format{info.bits_, info.channels_, info.rate_};
+  if (!WithFixedFormat(format, [](auto) {})) {
+    LOG_ERROR("FLAC format not supported");
+    return false;
+  }
+
+  // the scan only touches the bytes behind each target up to the next sync code
+  std::vector<size_t> splits{layout->audio_start_};
+  while (data.size() - splits.back() > chunk_bytes_) {
+    const size_t split{FindFrameHeader(data, splits.back() + chunk_bytes_, info)};
+    if (split == data.size()) {
+      break;
+    }
+    splits.push_back(split);
+  }
+  splits.push_back(data.size());
+  const size_t count{splits.size() - 1};
+  stats_.chunks_ = count;
+
+  std::vector<Chunk> chunks(count);
+  std::mutex mutex{};
+  std::condition_variable decoded{};
+  std::condition_variable consumed{};
+  size_t next{0};
+  size_t emitted{0};
+  bool stop{false};
+  // bounds the decoded PCM which waits for write
+  const size_t window{2 * workers_.size()};
+
+  // each thread takes the next chunk in file order, so that a slow chunk only
+  // delays its own thread
+  const auto work{[&](Worker &worker) {
+    while (true) {
+      size_t k{0};
+      {
+        std::unique_lock lock{mutex};
+        consumed.wait(lock, [&]() { return stop || (next == count) || (next < emitted + window); });
+        if (stop || (next == count)) {
+          return;
+        }
+        k = next++;
+      }
+      DecodeChunk(worker, layout->info_block_, data.subspan(splits[k], splits[k + 1] - splits[k]),
+                  format, chunks[k]);
+      {
+        std::lock_guard lock{mutex};
+        chunks[k].done_ = true;
+      }
+      decoded.notify_all();
+    }
+  }};
+  std::vector<std::thread> threads{};
+  for (const std::unique_ptr<Worker> &worker : workers_) {
+    threads.emplace_back(work, std::ref(*worker));
+  }
+
+  // a chunk is complete if it starts where its predecessor ended and its
+  // successor starts where it ends. a split inside a frame truncates the
+  // chunk before it, and the one behind starts with an error and a later frame
+  uint64_t expected{0};
+  size_t k{0};
+  bool stopped{false};
+  for (; k < count; ++k) {
+    {
+      std::unique_lock lock{mutex};
+      decoded.wait(lock,
+                   [&]() { return chunks[k].done_ && ((k + 1 == count) || chunks[k + 1].done_); });
+    }
+    Chunk &chunk{chunks[k]};
+    const bool complete{
+        !chunk.failed_ && chunk.written_ && (chunk.first_sample_ == expected)
+        && ((k + 1 == count)
+                ? ((info.total_samples_ == 0) || (chunk.end_sample_ == info.total_samples_))
+                : (chunks[k + 1].written_ && (chunks[k + 1].first_sample_ == chunk.end_sample_)))};
+    if (!complete) {
+      break;
+    }
+    if (!write(format, chunk.pcm_)) {
+      stopped = true;
+      break;
+    }
+    expected = chunk.end_sample_;
+    chunk.pcm_ = std::vector<u_char>{};
+    {
+      std::lock_guard lock{mutex};
+      emitted = k + 1;
+    }
+    consumed.notify_all();
+  }
+  {
+    std::lock_guard lock{mutex};
+    stop = true;
+  }
+  consumed.notify_all();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  if (stopped || (k == count)) {
+    return !stopped;
+  }
+
+  // chunk k starts at a frame, the previous one was checked against it
+  LOG_INFO("chunk {} of {} does not end at a frame, decoding the rest single threaded", k + 1,
+           count);
+  stats_.fallback_ = true;
+  Worker &worker{*workers_.front()};
+  Chunk rest{};
+  worker.write_ = &write;
+  worker.stopped_ = false;
+  DecodeChunk(worker, layout->info_block_, data.subspan(splits[k]), format, rest);
+  worker.write_ = nullptr;
+  if (worker.stopped_) {
+    return false;
+  }
+  if (rest.failed_ || !rest.written_ || (rest.first_sample_ != expected)
+      || ((info.total_samples_ != 0) && (rest.end_sample_ != info.total_samples_))) {
+    LOG_ERROR("corrupt FLAC frames");
+    return false;
+  }
+  return true;
+}
+
+bool ParallelDecoder::Decode(const char *name, const WriteFn &write) {
+  const FileDesc desc{name};
+  if (!desc.IsValid()) {
+    LOG_ERROR("cannot open {}: {}", name, ::strerror(errno));
+    return false;
+  }
+  const MappedFile map{desc};
+  if (!map.IsValid()) {
+    LOG_ERROR("cannot map {}", name);
+    return false;
+  }
+  return Decode(std::span<const u_char>{map.data_, map.size_}, write);
+}
+
+} // namespace plac
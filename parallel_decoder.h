@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef PARALLEL_DECODER_H
+#define PARALLEL_DECODER_H
+
+#include "audio_format.h"
+#include <FLAC/stream_decoder.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <sys/types.h>
+#include <vector>
+
+namespace plac {
+
+// Decodes whole FLAC files on several cores, for jobs which are not bound to
+// real time like decoding to a file or verification. Playback keeps using
+// Stream, one frame after the other.
+//
+// FLAC frames do not depend on each other. The file is split every
+// chunk_bytes at the next frame header, and each chunk is decoded by one
+// libFLAC decoder per thread as if it was a stream of its own. The PCM of the
+// chunks is handed out in file order. A chunk boundary which turns out not to
+// be a frame boundary is detected by the sample numbers of the adjacent chunks,
+// decoding then continues single threaded from the last good chunk.
+class ParallelDecoder {
+public:
+  static constexpr size_t kChunkBytes{1U << 20U};
+
+  // receives consecutive interleaved frames in the packed format of
+  // AudioBuffer. returns false to stop decoding
+  using WriteFn = std::function<bool(const AudioFormat format, std::span<const u_char> data)>;
+
+  struct Stats {
+    size_t chunks_;
+    // a chunk boundary was not a frame boundary
+    bool fallback_;
+  };
+
+  // threads 0 means one per core
+  explicit ParallelDecoder(unsigned int threads = 0, size_t chunk_bytes = kChunkBytes);
+  ParallelDecoder(const ParallelDecoder &) = delete;
+  ParallelDecoder(ParallelDecoder &&) = delete;
+  ParallelDecoder &operator=(const ParallelDecoder &) = delete;
+  ParallelDecoder &operator=(ParallelDecoder &&) = delete;
+  ~ParallelDecoder() noexcept;
+
+  // data is a whole file. false if it is not a stereo 16 or 24 bits FLAC file,
+  // if a frame is corrupt or if write returned false
+  bool Decode(std::span<const u_char> data, const WriteFn &write);
+  // opens name and decodes it from a mapping
+  bool Decode(const char *name, const WriteFn &write);
+
+  unsigned int Threads() const { return static_cast<unsigned int>(workers_.size()); }
+
+  Stats stats_{};
+
+  // one decoder and the chunk it works on, public for the libFLAC callbacks
+  struct Worker;
+
+private:
+  size_t chunk_bytes_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+} // namespace plac
+
+#endif
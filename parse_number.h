@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef PARSE_NUMBER_H
+#define PARSE_NUMBER_H
+
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+namespace plac {
+
+// decimal digits only, empty if malformed or above max
+inline std::optional<uint64_t> ParseNumber(const std::string_view text, const uint64_t max) {
+  uint64_t value{};
+  const auto [ptr, ec]{std::from_chars(text.data(), text.data() + text.size(), value)};
+  if (text.empty() || (ec != std::errc{}) || (ptr != text.data() + text.size()) || (value > max)) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+} // namespace plac
+
+#endif
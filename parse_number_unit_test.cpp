@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+
+#include "parse_number.h"
+#include <gtest/gtest.h>
+
+namespace plac {
+namespace {
+
+TEST(ParseNumberTest, Decimal) {
+  EXPECT_EQ(0, ParseNumber("0", 10));
+  EXPECT_EQ(10, ParseNumber("10", 10));
+  EXPECT_EQ(UINT64_MAX, ParseNumber("18446744073709551615", UINT64_MAX));
+}
+
+TEST(ParseNumberTest, Malformed) {
+  EXPECT_FALSE(ParseNumber("", 10));
+  EXPECT_FALSE(ParseNumber("abc", 10));
+  EXPECT_FALSE(ParseNumber("1x", 10));
+  EXPECT_FALSE(ParseNumber("-1", 10));
+  EXPECT_FALSE(ParseNumber("+1", 10));
+  EXPECT_FALSE(ParseNumber(" 1", 10));
+}
+
+TEST(ParseNumberTest, OutOfRange) {
+  EXPECT_FALSE(ParseNumber("11", 10));
+  EXPECT_FALSE(ParseNumber("18446744073709551616", UINT64_MAX));
+}
+
+} // namespace
+} // namespace plac
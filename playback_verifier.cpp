@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: MIT
+
+#include "playback_verifier.h"
+#include "conditions.h"
+#include "interleave.h"
+#include "log.h"
+#include "poll_backoff.h"
+#include "realtime.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sched.h>
+
+namespace plac {
+
+namespace {
+
+// the pages of a large allocation are mapped when they are first written.
+// touched before the consumer thread starts
+template <typename T> std::unique_ptr<T> Prefaulted(std::unique_ptr<T> object) {
+  PreTouch({reinterpret_cast<u_char *>(object.get()), sizeof(T)});
+  return object;
+}
+
+} // namespace
+
+PlaybackVerifier::PlaybackVerifier(const std::chrono::milliseconds poll_interval)
+    : queue_{Prefaulted(std::make_unique<MpmcQueue<Block, kCapacity>>())},
+      thread_{[this, poll_interval]() { Run(poll_interval); }} {}
+
+PlaybackVerifier::~PlaybackVerifier() noexcept {
+  {
+    std::lock_guard lock{mutex_};
+    stopped_ = true;
+  }
+  stop_.notify_one();
+  thread_.join();
+  Drain();
+}
+
+void PlaybackVerifier::Begin(const std::string_view name, const Md5::Digest &md5,
+                             const uint64_t total_samples, const AudioFormat format) {
+  format_ = format;
+  dropping_ = !queue_->TryPush([&](Block &block) {
+    block.kind_ = Block::Kind::begin;
+    block.size_ = std::min(name.size(), kNameSize);
+    std::memcpy(block.bytes_.data(), name.data(), block.size_);
+    block.md5_ = md5;
+    block.total_samples_ = total_samples;
+    block.format_ = format;
+    block.dropped_ = false;
+  });
+  if (dropping_) {
+    stats_.dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void PlaybackVerifier::Add(std::span<const u_char> data) {
+  while (!dropping_ && !data.empty()) {
+    const size_t n{std::min(data.size(), kBlockBytes)};
+    dropping_ = !queue_->TryPush([&data, n](Block &block) {
+      block.kind_ = Block::Kind::data;
+      block.size_ = n;
+      std::memcpy(block.bytes_.data(), data.data(), n);
+    });
+    if (dropping_) {
+      stats_.dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    data = data.subspan(n);
+  }
+}
+
+void PlaybackVerifier::Add(const int *left, const int *right, size_t frames) {
+  const size_t max_frames{kBlockBytes / AsBytes(format_, 1)};
+  while (!dropping_ && (frames != 0)) {
+    const size_t n{std::min(frames, max_frames)};
+    dropping_ = !queue_->TryPush([this, left, right, n](Block &block) {
+      block.kind_ = Block::Kind::data;
+      block.size_ = AsBytes(format_, n);
+      Interleave(format_, left, right, n, block.bytes_.data());
+    });
+    if (dropping_) {
+      stats_.dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    left += n;
+    right += n;
+    frames -= n;
+  }
+}
+
+void PlaybackVerifier::End() {
+  const bool dropped{dropping_};
+  const bool pushed{queue_->TryPush([dropped](Block &block) {
+    block.kind_ = Block::Kind::end;
+    block.size_ = 0;
+    block.dropped_ = dropped;
+  })};
+  if (!pushed && !dropped) {
+    stats_.dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+  dropping_ = false;
+}
+
+size_t PlaybackVerifier::Drain() {
+  std::lock_guard lock{drain_mutex_};
+  size_t count{0};
+  while (queue_->TryPop([this](const Block &block) { Consume(block); })) {
+    ++count;
+  }
+  return count;
+}
+
+void PlaybackVerifier::Consume(const Block &block) {
+  switch (block.kind_) {
+  case Block::Kind::begin:
+    // the end of the previous track was dropped, the producer counted it
+    if (track_.active_) {
+      Finish(true);
+    }
+    track_ = Track{};
+    track_.active_ = true;
+    std::memcpy(track_.name_.data(), block.bytes_.data(), block.size_);
+    track_.name_size_ = block.size_;
+    track_.expected_ = block.md5_;
+    track_.total_samples_ = block.total_samples_;
+    track_.format_ = block.format_;
+    break;
+  case Block::Kind::data:
+    if (track_.active_) {
+      track_.md5_.Update({block.bytes_.data(), block.size_});
+      track_.samples_ += AsFrames(track_.format_, block.size_);
+    }
+    break;
+  case Block::Kind::end:
+    if (track_.active_) {
+      Finish(block.dropped_);
+    }
+    break;
+  }
+}
+
+void PlaybackVerifier::Finish(const bool dropped) {
+  const std::string_view name{track_.name_.data(), track_.name_size_};
+  track_.active_ = false;
+  if (dropped) {
+    LOG_INFO("MD5 of {} not verified, the verifier fell behind", name);
+    return;
+  }
+  if (track_.expected_ == Md5::Digest{}) {
+    stats_.incomplete_.fetch_add(1, std::memory_order_relaxed);
+    LOG_INFO("MD5 of {} not verified, STREAMINFO has none", name);
+    return;
+  }
+  if ((track_.total_samples_ == 0) || (track_.samples_ != track_.total_samples_)) {
+    stats_.incomplete_.fetch_add(1, std::memory_order_relaxed);
+    LOG_INFO("MD5 of {} not verified, {} of {} samples decoded", name, track_.samples_,
+             track_.total_samples_);
+    return;
+  }
+  if (track_.md5_.Final() != track_.expected_) {
+    stats_.mismatched_.fetch_add(1, std::memory_order_relaxed);
+    LOG_ERROR("MD5 mismatch of {}", name);
+    return;
+  }
+  stats_.verified_.fetch_add(1, std::memory_order_relaxed);
+  LOG_INFO("MD5 of {} verified", name);
+}
+
+void PlaybackVerifier::Run(const std::chrono::milliseconds poll_interval) {
+  // runs only when no other thread of the system wants the core
+  sched_param param{};
+  if (::sched_setscheduler(0, SCHED_IDLE, &param) != 0) {
+    LOG_ERROR("cannot lower the priority of the verifier: {}", ::strerror(errno));
+  }
+  // Add() must stay as cheap as a copy, so the decoder never signals this
+  // thread. between tracks and while the decoder waits for the output the
+  // queue stays empty, and the wait grows up to kMaxPollInterval
+  PollBackoff backoff{poll_interval, kMaxPollInterval};
+  std::unique_lock lock{mutex_};
+  while (!stopped_) {
+    lock.unlock();
+    if (Drain() != 0) {
+      backoff.Reset();
+    }
+    lock.lock();
+    stop_.wait_for(lock, backoff.Next(), [this]() { return stopped_; });
+  }
+}
+
+} // namespace plac
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef PLAYBACK_VERIFIER_H
+#define PLAYBACK_VERIFIER_H
+
+#include "audio_format.h"
+#include "md5.h"
+#include "mpmc_queue.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <sys/types.h>
+#include <thread>
+
+namespace plac {
+
+// Checks the MD5 of STREAMINFO while a track plays, without slowing down the
+// decoder.
+//
+// The decode thread copies each decoded block into a lock-free side queue and
+// never waits for it. A thread with SCHED_IDLE polls the queue, hashes the
+// blocks and compares the MD5 at the end of the track. Mismatches are logged
+// as errors. If the queue is full, the rest of the track is not verified,
+// which is logged and counted as dropped. Tracks which were not decoded from
+// the first to the last sample, e.g. after a seek, or which have no MD5 are
+// counted as incomplete.
+class PlaybackVerifier {
+public:
+  static constexpr size_t kBlockBytes{32U << 10U};
+  // holds more than a full AudioBuffer of 24 bits stereo, which the decoder
+  // writes in a burst at the start of each track
+  static constexpr size_t kCapacity{32};
+  static constexpr std::chrono::milliseconds kPollInterval{10};
+  // 24 bits at 192 kHz are 6 blocks in this time, which leaves room for the
+  // burst at the start of a track
+  static constexpr std::chrono::milliseconds kMaxPollInterval{160};
+
+  struct Stats {
+    std::atomic<size_t> verified_{0};
+    std::atomic<size_t> mismatched_{0};
+    std::atomic<size_t> dropped_{0};
+    std::atomic<size_t> incomplete_{0};
+  };
+
+  explicit PlaybackVerifier(std::chrono::milliseconds poll_interval = kPollInterval);
+  PlaybackVerifier(const PlaybackVerifier &) = delete;
+  PlaybackVerifier(PlaybackVerifier &&) = delete;
+  PlaybackVerifier &operator=(const PlaybackVerifier &) = delete;
+  PlaybackVerifier &operator=(PlaybackVerifier &&) = delete;
+  ~PlaybackVerifier() noexcept;
+
+  // producer, i.e. the decode thread. neither allocates nor blocks
+  //
+  // starts a track. name is truncated for the log
+  void Begin(std::string_view name, const Md5::Digest &md5, uint64_t total_samples,
+             AudioFormat format);
+  // interleaved frames in the packed format of AudioBuffer
+  void Add(std::span<const u_char> data);
+  // planar stereo frames, packed like AudioBuffer::Write() does
+  void Add(const int *left, const int *right, size_t frames);
+  void End();
+
+  // hashes all pending blocks from the calling thread. returns their number
+  size_t Drain();
+
+  Stats stats_{};
+
+private:
+  static constexpr size_t kNameSize{96};
+
+  struct Block {
+    enum class Kind { begin, data, end };
+
+    Kind kind_;
+    // begin: the bytes of the name. data: the bytes of the frames
+    size_t size_;
+    // begin only
+    Md5::Digest md5_;
+    uint64_t total_samples_;
+    AudioFormat format_;
+    // end only. the producer dropped blocks of the track
+    bool dropped_;
+    std::array<u_char, kBlockBytes> bytes_;
+  };
+
+  // consumer side of a track
+  struct Track {
+    bool active_{false};
+    std::array<char, kNameSize> name_{};
+    size_t name_size_{0};
+    Md5::Digest expected_{};
+    uint64_t total_samples_{0};
+    AudioFormat format_{};
+    Md5 md5_{};
+    uint64_t samples_{0};
+  };
+
+  void Consume(const Block &block);
+  void Finish(bool dropped);
+  void Run(std::chrono::milliseconds poll_interval);
+
+  // too large for the stack of the caller
+  std::unique_ptr<MpmcQueue<Block, kCapacity>> queue_;
+  // producer only
+  AudioFormat format_{};
+  bool dropping_{false};
+  // consumer only, Drain() is serialized by drain_mutex_
+  std::mutex drain_mutex_{};
+  Track track_{};
+
+  std::mutex mutex_{};
+  std::condition_variable stop_{};
+  bool stopped_{false};
+  std::thread thread_;
+};
+
+} // namespace plac
+
+#endif
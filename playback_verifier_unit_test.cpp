@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: MIT
+
+#include "playback_verifier.h"
+#include "interleave.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace plac {
+namespace {
+
+constexpr AudioFormat kFormat{16, 2, 44100};
+
+class PlaybackVerifierTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    left_.resize(kFrames);
+    right_.resize(kFrames);
+    for (size_t i{0}; i < kFrames; ++i) {
+      left_[i] = static_cast<int>(i);
+      right_[i] = -static_cast<int>(i);
+    }
+    pcm_.resize(AsBytes(kFormat, kFrames));
+    Interleave(kFormat, left_.data(), right_.data(), kFrames, pcm_.data());
+    Md5 md5{};
+    md5.Update(pcm_);
+    md5_ = md5.Final();
+  }
+
+  // spans several blocks
+  static constexpr size_t kFrames{20000};
+  std::vector<int> left_{};
+  std::vector<int> right_{};
+  std::vector<u_char> pcm_{};
+  Md5::Digest md5_{};
+  // the test drains the queue itself
+  PlaybackVerifier verifier_{std::chrono::hours{1}};
+};
+
+TEST_F(PlaybackVerifierTest, Verified) {
+  verifier_.Begin("packed", md5_, kFrames, kFormat);
+  verifier_.Add(std::span<const u_char>{pcm_}.first(1000));
+  verifier_.Add(std::span<const u_char>{pcm_}.subspan(1000));
+  verifier_.End();
+  verifier_.Begin("planar", md5_, kFrames, kFormat);
+  verifier_.Add(left_.data(), right_.data(), 1234);
+  verifier_.Add(left_.data() + 1234, right_.data() + 1234, kFrames - 1234);
+  verifier_.End();
+  verifier_.Drain();
+  EXPECT_EQ(2, verifier_.stats_.verified_);
+  EXPECT_EQ(0, verifier_.stats_.mismatched_);
+}
+
+TEST_F(PlaybackVerifierTest, Mismatch) {
+  pcm_[4321] ^= 0x01U;
+  verifier_.Begin("corrupt", md5_, kFrames, kFormat);
+  verifier_.Add(pcm_);
+  verifier_.End();
+  verifier_.Drain();
+  EXPECT_EQ(0, verifier_.stats_.verified_);
+  EXPECT_EQ(1, verifier_.stats_.mismatched_);
+}
+
+TEST_F(PlaybackVerifierTest, Incomplete) {
+  // e.g. after a seek
+  verifier_.Begin("seeked", md5_, kFrames, kFormat);
+  verifier_.Add(std::span<const u_char>{pcm_}.subspan(AsBytes(kFormat, 100)));
+  verifier_.End();
+  verifier_.Begin("no md5", Md5::Digest{}, kFrames, kFormat);
+  verifier_.Add(pcm_);
+  verifier_.End();
+  verifier_.Drain();
+  EXPECT_EQ(2, verifier_.stats_.incomplete_);
+  EXPECT_EQ(0, verifier_.stats_.mismatched_);
+}
+
+TEST_F(PlaybackVerifierTest, DropWhenFull) {
+  // more blocks than the queue holds, nothing drains it in between
+  std::vector<u_char> pcm{};
+  while (pcm.size() <= PlaybackVerifier::kCapacity * PlaybackVerifier::kBlockBytes) {
+    pcm.insert(pcm.end(), pcm_.begin(), pcm_.end());
+  }
+  verifier_.Begin("long", md5_, AsFrames(kFormat, pcm.size()), kFormat);
+  verifier_.Add(pcm);
+  verifier_.End();
+  EXPECT_EQ(1, verifier_.stats_.dropped_);
+  verifier_.Drain();
+  EXPECT_EQ(0, verifier_.stats_.verified_);
+  EXPECT_EQ(0, verifier_.stats_.mismatched_);
+
+  // the next track is verified again
+  verifier_.Begin("short", md5_, kFrames, kFormat);
+  verifier_.Add(pcm_);
+  verifier_.End();
+  verifier_.Drain();
+  EXPECT_EQ(1, verifier_.stats_.verified_);
+}
+
+} // namespace
+} // namespace plac
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef POLL_BACKOFF_H
+#define POLL_BACKOFF_H
+
+#include <algorithm>
+#include <chrono>
+
+namespace plac {
+
+// Wait between the polls of a thread which consumes a lock-free queue.
+//
+// Each poll which finds the queue empty doubles the wait, up to max, so that
+// an idle consumer rarely wakes up. Reset() after a poll which found work
+// starts over at min.
+class PollBackoff {
+public:
+  PollBackoff(const std::chrono::milliseconds min, const std::chrono::milliseconds max)
+      : min_{min}, max_{std::max(min, max)}, wait_{min} {}
+
+  void Reset() { wait_ = min_; }
+
+  // the wait before the next poll
+  std::chrono::milliseconds Next() {
+    const std::chrono::milliseconds wait{wait_};
+    wait_ = std::min(2 * wait_, max_);
+    return wait;
+  }
+
+private:
+  std::chrono::milliseconds min_;
+  std::chrono::milliseconds max_;
+  std::chrono::milliseconds wait_;
+};
+
+} // namespace plac
+
+#endif
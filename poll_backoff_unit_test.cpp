@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+
+#include "poll_backoff.h"
+#include <gtest/gtest.h>
+
+namespace plac {
+namespace {
+
+using std::chrono::milliseconds;
+
+TEST(PollBackoffTest, DoublesUpToMax) {
+  PollBackoff backoff{milliseconds{10}, milliseconds{50}};
+  EXPECT_EQ(milliseconds{10}, backoff.Next());
+  EXPECT_EQ(milliseconds{20}, backoff.Next());
+  EXPECT_EQ(milliseconds{40}, backoff.Next());
+  EXPECT_EQ(milliseconds{50}, backoff.Next());
+  EXPECT_EQ(milliseconds{50}, backoff.Next());
+
+  backoff.Reset();
+  EXPECT_EQ(milliseconds{10}, backoff.Next());
+}
+
+TEST(PollBackoffTest, MaxBelowMin) {
+  PollBackoff backoff{milliseconds{10}, milliseconds{1}};
+  EXPECT_EQ(milliseconds{10}, backoff.Next());
+  EXPECT_EQ(milliseconds{10}, backoff.Next());
+}
+
+} // namespace
+} // namespace plac
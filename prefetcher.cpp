@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: MIT
+
+#include "prefetcher.h"
+#include "conditions.h"
+#include "file_desc.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <utility>
+
+namespace plac {
+
+Prefetcher::Prefetcher(const std::span<const char *const> names, const size_t tracks,
+                       const size_t budget, AdviseFn advise)
+    : names_{names}, tracks_{tracks}, budget_{budget}, advise_{std::move(advise)},
+      requested_(names.size(), 0), current_{names.size()}, target_{names.size()},
+      thread_{[this]() { Run(); }} {}
+
+Prefetcher::~Prefetcher() noexcept {
+  {
+    std::lock_guard lock{mutex_};
+    stopped_ = true;
+  }
+  changed_.notify_one();
+  done_.notify_all();
+  thread_.join();
+}
+
+void Prefetcher::Play(const std::string_view name) {
+  std::lock_guard lock{mutex_};
+  for (size_t i{(target_ == names_.size()) ? 0 : target_}; i < names_.size(); ++i) {
+    if (names_[i] == name) {
+      target_ = i;
+      if (target_ != current_) {
+        busy_ = true;
+        changed_.notify_one();
+      }
+      return;
+    }
+  }
+}
+
+void Prefetcher::Wait() {
+  std::unique_lock lock{mutex_};
+  done_.wait(lock, [this]() { return !busy_ || stopped_; });
+}
+
+void Prefetcher::Advise(const char *name, const uint64_t offset, const uint64_t length,
+                        const int advice) {
+  const FileDesc desc{name};
+  if (!desc.IsValid()) {
+    LOG_ERROR("cannot open {} to read ahead: {}", name, ::strerror(errno));
+    return;
+  }
+  // returns the error instead of setting errno
+  if (const int error{::posix_fadvise(desc.fd_, static_cast<off_t>(offset),
+                                      static_cast<off_t>(length), advice)};
+      error != 0) {
+    LOG_ERROR("cannot advise the kernel about {}: {}", name, ::strerror(error));
+  }
+}
+
+void Prefetcher::Run() {
+  std::unique_lock lock{mutex_};
+  while (true) {
+    changed_.wait(lock, [this]() { return stopped_ || (target_ != current_); });
+    if (stopped_) {
+      return;
+    }
+    const size_t target{target_};
+    lock.unlock();
+    Update(target);
+    lock.lock();
+    current_ = target;
+    if (target_ == current_) {
+      busy_ = false;
+      done_.notify_all();
+    }
+  }
+}
+
+void Prefetcher::Update(const size_t current) {
+  const size_t end{std::min(names_.size(), current + 1 + tracks_)};
+  // a playlist may list a file more than once
+  const auto upcoming{[this, current, end](const char *name) {
+    return std::any_of(&names_[current], names_.data() + end,
+                       [name](const char *other) { return std::strcmp(name, other) == 0; });
+  }};
+
+  // the tracks which finished since the last update, or were skipped
+  if (current_ != names_.size()) {
+    for (size_t i{current_}; i < current; ++i) {
+      if (!upcoming(names_[i])) {
+        advise_(names_[i], 0, 0, POSIX_FADV_DONTNEED);
+      }
+      requested_[i] = 0;
+    }
+  }
+
+  // the track which plays is read by the decoder anyway
+  uint64_t remaining{budget_};
+  for (size_t i{current + 1}; (i < end) && (remaining != 0); ++i) {
+    struct stat st {};
+    if (::stat(names_[i], &st) != 0) {
+      continue;
+    }
+    const uint64_t wanted{std::min(static_cast<uint64_t>(st.st_size), remaining)};
+    if (wanted > requested_[i]) {
+      advise_(names_[i], requested_[i], wanted - requested_[i], POSIX_FADV_WILLNEED);
+      requested_[i] = wanted;
+    }
+    remaining -= wanted;
+  }
+}
+
+} // namespace plac
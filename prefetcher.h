@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace plac {
+
+// Warms the page cache for the next tracks of a playlist, so that a spinning
+// disk or an SD card has spun up and read them well before the track boundary.
+//
+// When a track starts playing, the next entries are read ahead with
+// POSIX_FADV_WILLNEED until budget bytes are requested, a file in whole or in
+// part. The tracks before the one which plays are dropped from the page cache
+// with POSIX_FADV_DONTNEED. The system calls run on a thread of their own,
+// WILLNEED blocks while the request queue of the device is full.
+class Prefetcher {
+public:
+  static constexpr size_t kDefaultTracks{3};
+  static constexpr size_t kDefaultBudget{256U << 20U};
+
+  // posix_fadvise() on the range of the file. a length of 0 is the rest of it
+  using AdviseFn =
+      std::function<void(const char *name, uint64_t offset, uint64_t length, int advice)>;
+
+  // names must outlive the prefetcher
+  explicit Prefetcher(std::span<const char *const> names, size_t tracks = kDefaultTracks,
+                      size_t budget = kDefaultBudget, AdviseFn advise = Advise);
+  Prefetcher(const Prefetcher &) = delete;
+  Prefetcher(Prefetcher &&) = delete;
+  Prefetcher &operator=(const Prefetcher &) = delete;
+  Prefetcher &operator=(Prefetcher &&) = delete;
+  ~Prefetcher() noexcept;
+
+  // name starts playing. it is searched from the current track on, since
+  // entries which cannot be opened are skipped. does not block on I/O
+  void Play(std::string_view name);
+
+  // waits until the advice for the last Play() is given
+  void Wait();
+
+  // opens name for the duration of the call, errors are only logged
+  static void Advise(const char *name, uint64_t offset, uint64_t length, int advice);
+
+private:
+  void Run();
+  void Update(size_t current);
+
+  const std::span<const char *const> names_;
+  const size_t tracks_;
+  const size_t budget_;
+  const AdviseFn advise_;
+  // worker only. bytes from the start of each file which were requested
+  std::vector<uint64_t> requested_;
+
+  std::mutex mutex_{};
+  std::condition_variable changed_{};
+  std::condition_variable done_{};
+  // the track which the advice was given for, written by the worker
+  size_t current_;
+  // the track which plays. both are names_.size() before the first Play()
+  size_t target_;
+  bool busy_{false};
+  bool stopped_{false};
+  std::thread thread_;
+};
+
+} // namespace plac
+
+#endif
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: MIT
+
+#include "prefetcher.h"
+#include <array>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace plac {
+namespace {
+
+struct Advice {
+  std::string name_;
+  uint64_t offset_;
+  uint64_t length_;
+  int advice_;
+
+  bool operator==(const Advice &) const = default;
+};
+
+class PrefetcherTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    std::filesystem::create_directories(kDir);
+    for (const char *name : kNames) {
+      std::ofstream{name}.close();
+      std::filesystem::resize_file(name, 100);
+    }
+  }
+  void TearDown() override { std::filesystem::remove_all(kDir); }
+
+  Prefetcher::AdviseFn Recorder() {
+    return [this](const char *name, const uint64_t offset, const uint64_t length,
+                  const int advice) { advice_.push_back(Advice{name, offset, length, advice}); };
+  }
+
+  static constexpr const char *kDir{"prefetcher_unit_test"};
+  static constexpr std::array<const char *, 4> kNames{
+      "prefetcher_unit_test/0.flac", "prefetcher_unit_test/1.flac", "prefetcher_unit_test/2.flac",
+      "prefetcher_unit_test/3.flac"};
+  // written by the worker, read after Wait()
+  std::vector<Advice> advice_{};
+};
+
+TEST_F(PrefetcherTest, ReadsAheadWithinBudget) {
+  Prefetcher prefetcher{kNames, 2, 150, Recorder()};
+  prefetcher.Play(kNames[0]);
+  prefetcher.Wait();
+  EXPECT_EQ((std::vector<Advice>{{kNames[1], 0, 100, POSIX_FADV_WILLNEED},
+                                 {kNames[2], 0, 50, POSIX_FADV_WILLNEED}}),
+            advice_);
+
+  advice_.clear();
+  prefetcher.Play(kNames[1]);
+  prefetcher.Wait();
+  EXPECT_EQ((std::vector<Advice>{{kNames[0], 0, 0, POSIX_FADV_DONTNEED},
+                                 {kNames[2], 50, 50, POSIX_FADV_WILLNEED},
+                                 {kNames[3], 0, 50, POSIX_FADV_WILLNEED}}),
+            advice_);
+
+  // the same track again
+  advice_.clear();
+  prefetcher.Play(kNames[1]);
+  prefetcher.Wait();
+  EXPECT_TRUE(advice_.empty());
+}
+
+TEST_F(PrefetcherTest, DropsSkippedTracks) {
+  Prefetcher prefetcher{kNames, 1, 1000, Recorder()};
+  prefetcher.Play(kNames[0]);
+  prefetcher.Wait();
+  advice_.clear();
+
+  prefetcher.Play(kNames[2]);
+  prefetcher.Wait();
+  EXPECT_EQ((std::vector<Advice>{{kNames[0], 0, 0, POSIX_FADV_DONTNEED},
+                                 {kNames[1], 0, 0, POSIX_FADV_DONTNEED},
+                                 {kNames[3], 0, 100, POSIX_FADV_WILLNEED}}),
+            advice_);
+
+  // tracks before the current one are not searched
+  advice_.clear();
+  prefetcher.Play(kNames[1]);
+  prefetcher.Wait();
+  EXPECT_TRUE(advice_.empty());
+}
+
+TEST_F(PrefetcherTest, KeepsRepeatedTracks) {
+  const std::array<const char *, 3> names{kNames[0], kNames[1], kNames[0]};
+  Prefetcher prefetcher{names, 1, 1000, Recorder()};
+  prefetcher.Play(kNames[0]);
+  prefetcher.Play(kNames[1]);
+  prefetcher.Wait();
+  advice_.clear();
+
+  prefetcher.Play(kNames[0]);
+  prefetcher.Wait();
+  EXPECT_EQ((std::vector<Advice>{{kNames[1], 0, 0, POSIX_FADV_DONTNEED}}), advice_);
+}
+
+TEST_F(PrefetcherTest, Advise) {
+  // only logs
+  Prefetcher::Advise(kNames[0], 0, 0, POSIX_FADV_WILLNEED);
+  Prefetcher::Advise("does_not_exist.flac", 0, 0, POSIX_FADV_WILLNEED);
+}
+
+} // namespace
+} // namespace plac
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef RAW_FILE_SINK_H
+#define RAW_FILE_SINK_H
+
+#include "audio_format.h"
+#include "conditions.h"
+#include "file_desc.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace plac {
+
+// AudioSink which writes the interleaved frames to a file as they are, like
+// the write_file PCM in asoundrc but without alsa-lib.
+struct RawFileSink {
+  explicit RawFileSink(const char *name) : desc_{name, O_WRONLY | O_CREAT | O_TRUNC, 0644} {
+    ENSURES(desc_.IsValid(), "cannot open {}: {}", name, ::strerror(errno));
+  }
+  RawFileSink(const RawFileSink &) = delete;
+  RawFileSink(RawFileSink &&) = delete;
+  RawFileSink &operator=(const RawFileSink &) = delete;
+  RawFileSink &operator=(RawFileSink &&) = delete;
+  ~RawFileSink() noexcept = default;
+
+  ssize_t Write(const AudioFormat format, const u_char *const data, const size_t count) {
+    const size_t size{AsBytes(format, count)};
+    size_t done{0};
+    while (done < size) {
+      const ssize_t r{::write(desc_.fd_, data + done, size - done)};
+      if (r < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return -errno;
+      }
+      done += static_cast<size_t>(r);
+    }
+    return static_cast<ssize_t>(count);
+  }
+
+  void Drain() {}
+
+  FileDesc desc_;
+};
+
+} // namespace plac
+
+#endif
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+
+#include "realtime.h"
+#include "conditions.h"
+#include <array>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <linux/capability.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace plac {
+
+namespace {
+
+size_t PageSize() { return static_cast<size_t>(::sysconf(_SC_PAGESIZE)); }
+
+// without, mappings and heap growth fail once RLIMIT_MEMLOCK bytes are locked,
+// e.g. the mapping of a large FLAC file
+bool MayLockAll() {
+  rlimit limit{};
+  if ((::getrlimit(RLIMIT_MEMLOCK, &limit) == 0) && (limit.rlim_cur == RLIM_INFINITY)) {
+    return true;
+  }
+  FILE *const f{std::fopen("/proc/self/status", "r")};
+  if (f == nullptr) {
+    return false;
+  }
+  bool capable{false};
+  std::array<char, 256> line{};
+  while (std::fgets(line.data(), static_cast<int>(line.size()), f) != nullptr) {
+    uint64_t effective{};
+    if (std::sscanf(line.data(), "CapEff: %" SCNx64, &effective) == 1) {
+      capable = ((effective >> CAP_IPC_LOCK) & 1U) != 0;
+      break;
+    }
+  }
+  std::fclose(f);
+  return capable;
+}
+
+} // namespace
+
+bool LockMemory() {
+  if (::mlockall(MCL_CURRENT) != 0) {
+    // grant it with `sudo setcap 'cap_ipc_lock,cap_sys_nice=eip' <path>/flacplayer`
+    // or raise the limit of `ulimit -l`
+    LOG_ERROR("cannot lock memory: {}", ::strerror(errno));
+    return false;
+  }
+#ifdef MCL_ONFAULT
+  if (!MayLockAll()) {
+    LOG_ERROR("memory mapped later is not locked, RLIMIT_MEMLOCK is limited");
+    return false;
+  }
+  // without MCL_ONFAULT, mmap() would read and lock whole FLAC files
+  if (::mlockall(MCL_FUTURE | MCL_ONFAULT) != 0) {
+    LOG_ERROR("cannot lock memory mapped later: {}", ::strerror(errno));
+    return false;
+  }
+  return true;
+#else
+  LOG_ERROR("memory mapped later is not locked, built without MCL_ONFAULT");
+  return false;
+#endif
+}
+
+[[gnu::noinline]] void PrefaultStack() {
+  std::array<u_char, kStackReserve> reserve;
+  // volatile, so that the stores to the dead array are kept
+  volatile u_char *const bytes{reserve.data()};
+  for (size_t i{0}; i < reserve.size(); i += PageSize()) {
+    bytes[i] = 0;
+  }
+}
+
+void PreTouch(const std::span<u_char> data) {
+  if (data.empty()) {
+    return;
+  }
+  volatile u_char *const bytes{data.data()};
+  const size_t page{PageSize()};
+  // data may start and end within a page
+  for (size_t i{0}; i < data.size(); i += page) {
+    bytes[i] = bytes[i];
+  }
+  bytes[data.size() - 1] = bytes[data.size() - 1];
+}
+
+FaultCounts ThreadFaults() {
+  rusage usage{};
+  EXPECTS(::getrusage(RUSAGE_THREAD, &usage) == 0, "cannot get resource usage");
+  return FaultCounts{static_cast<uint64_t>(usage.ru_minflt),
+                     static_cast<uint64_t>(usage.ru_majflt)};
+}
+
+std::optional<FaultCounts> ThreadFaults(const pid_t tid) {
+  const std::string path{"/proc/self/task/" + std::to_string(tid) + "/stat"};
+  FILE *const f{std::fopen(path.c_str(), "r")};
+  if (f == nullptr) {
+    return std::nullopt;
+  }
+  std::array<char, 1024> line{};
+  const bool read{std::fgets(line.data(), static_cast<int>(line.size()), f) != nullptr};
+  std::fclose(f);
+  // the name in parentheses may contain spaces and parentheses itself
+  const char *const end{read ? std::strrchr(line.data(), ')') : nullptr};
+  FaultCounts faults{};
+  // state ppid pgrp session tty_nr tpgid flags minflt cminflt majflt
+  if ((end == nullptr)
+      || (std::sscanf(end + 1, " %*c %*d %*d %*d %*d %*d %*u %" SCNu64 " %*u %" SCNu64,
+                      &faults.minor_, &faults.major_)
+          != 2)) {
+    return std::nullopt;
+  }
+  return faults;
+}
+
+pid_t ThreadId() { return static_cast<pid_t>(::syscall(SYS_gettid)); }
+
+} // namespace plac
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <sys/types.h>
+
+namespace plac {
+
+// Keeps page faults out of the playback loop.
+//
+// LockMemory() locks what is mapped at startup and every page which is touched
+// later. Buffers and stacks of the real-time path are touched before playback
+// starts, so that the loop never waits for the kernel to map a page.
+
+// stack which each thread of the real-time path prefaults
+constexpr size_t kStackReserve{256U << 10U};
+
+// mlockall(MCL_CURRENT) populates and locks the current mappings, e.g. the code
+// of libFLAC and libasound. later mappings are locked as they are touched, but
+// only if the process may lock unlimited memory, i.e. has CAP_IPC_LOCK or an
+// unlimited RLIMIT_MEMLOCK. false if not everything is locked, which is logged
+bool LockMemory();
+
+// touches kStackReserve bytes of the stack below the caller
+void PrefaultStack();
+
+// writes every page of data without changing its bytes. a read would only map
+// the shared zero page of anonymous memory
+void PreTouch(std::span<u_char> data);
+
+struct FaultCounts {
+  // served without I/O, e.g. from the page cache or by a new zeroed page
+  uint64_t minor_{0};
+  // which waited for I/O
+  uint64_t major_{0};
+
+  FaultCounts operator-(const FaultCounts &other) const {
+    return FaultCounts{minor_ - other.minor_, major_ - other.major_};
+  }
+  bool operator==(const FaultCounts &) const = default;
+};
+
+// of the calling thread, from getrusage(RUSAGE_THREAD)
+FaultCounts ThreadFaults();
+// of thread tid of this process, from /proc. empty if tid has exited. the
+// same counters as getrusage(), without a system call on that thread
+std::optional<FaultCounts> ThreadFaults(pid_t tid);
+pid_t ThreadId();
+
+} // namespace plac
+
+#endif
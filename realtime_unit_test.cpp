@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+
+#include "realtime.h"
+#include <gtest/gtest.h>
+#include <optional>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace plac {
+namespace {
+
+TEST(RealtimeTest, PreTouchKeepsBytes) {
+  const size_t page{static_cast<size_t>(::sysconf(_SC_PAGESIZE))};
+  const size_t size{64 * page};
+  void *const data{
+      ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+  ASSERT_NE(MAP_FAILED, data);
+  u_char *const bytes{static_cast<u_char *>(data)};
+  bytes[0] = 1;
+  bytes[size - 1] = 2;
+
+  const FaultCounts before{ThreadFaults()};
+  PreTouch({bytes + 1, size - 1});
+  const FaultCounts faults{ThreadFaults() - before};
+  // the first and the last page were mapped already
+  EXPECT_GE(faults.minor_, 62);
+  EXPECT_EQ(0, faults.major_);
+  EXPECT_EQ(1, bytes[0]);
+  EXPECT_EQ(0, bytes[page]);
+  EXPECT_EQ(2, bytes[size - 1]);
+
+  // touched pages do not fault again
+  const FaultCounts again{ThreadFaults()};
+  PreTouch({bytes, size});
+  EXPECT_EQ(again, ThreadFaults());
+  EXPECT_EQ(0, ::munmap(data, size));
+}
+
+TEST(RealtimeTest, PrefaultStack) {
+  PrefaultStack();
+  const FaultCounts before{ThreadFaults()};
+  PrefaultStack();
+  EXPECT_EQ(before, ThreadFaults());
+}
+
+TEST(RealtimeTest, OtherThread) {
+  const FaultCounts own{ThreadFaults()};
+  const std::optional<FaultCounts> proc{ThreadFaults(ThreadId())};
+  ASSERT_TRUE(proc);
+  EXPECT_GE(proc->minor_, own.minor_);
+  EXPECT_GE(proc->major_, own.major_);
+
+  EXPECT_FALSE(ThreadFaults(-1));
+}
+
+} // namespace
+} // namespace plac
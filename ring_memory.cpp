@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: MIT
+
+#include "ring_memory.h"
+#include "conditions.h"
+#include "file_desc.h"
+#include "realtime.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace plac {
+
+namespace {
+
+// maps the first size bytes of fd twice back to back, nullptr on failure
+u_char *MapTwice(const FileDesc &fd, const size_t size) {
+  // reserve the address range first so that both halves are adjacent
+  void *base{::mmap(nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+  if (base == MAP_FAILED) {
+    return nullptr;
+  }
+  u_char *const data{static_cast<u_char *>(base)};
+  for (u_char *half : {data, data + size}) {
+    if (::mmap(half, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd.fd_, 0)
+        == MAP_FAILED) {
+      EXPECTS(::munmap(base, 2 * size) == 0, "cannot unmap ring");
+      return nullptr;
+    }
+  }
+  return data;
+}
+
+} // namespace
+
+RingMemory::RingMemory(const size_t capacity) : capacity_{capacity} {
+#if defined(__linux__)
+  const size_t page{static_cast<size_t>(::sysconf(_SC_PAGESIZE))};
+  // the mappings keep the memfd alive
+  FileDesc fd{};
+  fd.fd_ = ::memfd_create("plac-audio-buffer", MFD_CLOEXEC);
+  if (fd.IsValid()
+      && (::ftruncate(fd.fd_, static_cast<off_t>(capacity_ * kMaxFrameBytes)) == 0)) {
+    for (size_t frame_bytes{1}; frame_bytes <= kMaxFrameBytes; ++frame_bytes) {
+      const size_t size{capacity_ * frame_bytes};
+      if ((size % page) == 0) {
+        if (u_char *const data{MapTwice(fd, size)}; data != nullptr) {
+          views_[frame_bytes - 1] = View{data, true};
+        }
+      }
+    }
+  } else {
+    LOG_ERROR("cannot create ring memory, using a split ring: {}", ::strerror(errno));
+  }
+#endif
+
+  for (View &view : views_) {
+    if (!view.mirrored_) {
+      if (!linear_) {
+        linear_ = std::make_unique<u_char[]>(capacity_ * kMaxFrameBytes);
+      }
+      view.data_ = linear_.get();
+    }
+  }
+}
+
+RingMemory::~RingMemory() noexcept {
+  for (size_t frame_bytes{1}; frame_bytes <= kMaxFrameBytes; ++frame_bytes) {
+    const View &view{views_[frame_bytes - 1]};
+    if (view.mirrored_) {
+      EXPECTS(::munmap(view.data_, 2 * capacity_ * frame_bytes) == 0, "cannot unmap ring");
+    }
+  }
+}
+
+void RingMemory::Prefault() {
+  for (size_t frame_bytes{1}; frame_bytes <= kMaxFrameBytes; ++frame_bytes) {
+    const View &view{views_[frame_bytes - 1]};
+    if (view.mirrored_) {
+      PreTouch({view.data_, 2 * capacity_ * frame_bytes});
+    }
+  }
+  if (linear_) {
+    PreTouch({linear_.get(), capacity_ * kMaxFrameBytes});
+  }
+}
+
+} // namespace plac
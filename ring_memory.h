@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef RING_MEMORY_H
+#define RING_MEMORY_H
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <sys/types.h>
+
+namespace plac {
+
+// Backing store of a ring of frames whose frame size is only known at runtime.
+//
+// The frames live in a memfd. For every frame size whose ring is a multiple of
+// the page size, the memfd is mapped twice back to back, so that any span of
+// up to the capacity is contiguous, across the end of the ring too. Frame sizes
+// which cannot be mirrored, or all of them if memfd_create() or mmap() fail,
+// share plain heap memory and spans split at the end of the ring.
+class RingMemory {
+public:
+  static constexpr size_t kMaxFrameBytes{6};
+
+  struct View {
+    u_char *data_{nullptr};
+    // data_[capacity * frame_bytes + i] is data_[i]
+    bool mirrored_{false};
+  };
+
+  // capacity in frames of up to kMaxFrameBytes
+  explicit RingMemory(const size_t capacity);
+  RingMemory(const RingMemory &) = delete;
+  RingMemory(RingMemory &&) = delete;
+  RingMemory &operator=(const RingMemory &) = delete;
+  RingMemory &operator=(RingMemory &&) = delete;
+  ~RingMemory() noexcept;
+
+  View Get(const size_t frame_bytes) const { return views_[frame_bytes - 1]; }
+
+  // maps every page of all views before the ring is used. each half of a
+  // mirrored view faults on its own
+  void Prefault();
+
+private:
+  size_t capacity_;
+  std::array<View, kMaxFrameBytes> views_{};
+  std::unique_ptr<u_char[]> linear_{};
+};
+
+} // namespace plac
+
+#endif
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+
+#include "ring_memory.h"
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+namespace plac {
+namespace {
+
+TEST(RingMemoryTest, Mirrored) {
+  const size_t capacity{static_cast<size_t>(::sysconf(_SC_PAGESIZE))};
+  RingMemory memory{capacity};
+  for (size_t frame_bytes{1}; frame_bytes <= RingMemory::kMaxFrameBytes; ++frame_bytes) {
+    const RingMemory::View view{memory.Get(frame_bytes)};
+    ASSERT_TRUE(view.mirrored_) << frame_bytes;
+    const size_t size{capacity * frame_bytes};
+    view.data_[3] = static_cast<u_char>(frame_bytes);
+    EXPECT_EQ(frame_bytes, view.data_[size + 3]);
+    view.data_[size + 5] = 42;
+    EXPECT_EQ(42, view.data_[5]);
+  }
+}
+
+TEST(RingMemoryTest, SplitWhenNotPageAligned) {
+  RingMemory memory{32};
+  for (size_t frame_bytes{1}; frame_bytes <= RingMemory::kMaxFrameBytes; ++frame_bytes) {
+    const RingMemory::View view{memory.Get(frame_bytes)};
+    EXPECT_FALSE(view.mirrored_);
+    ASSERT_NE(nullptr, view.data_);
+    view.data_[32 * frame_bytes - 1] = 1;
+  }
+}
+
+TEST(RingMemoryTest, PartlyMirrored) {
+  // 4 frames of 1024 bytes are a page, 3 and 6 byte frames are not
+  RingMemory memory{1024};
+  EXPECT_TRUE(memory.Get(4).mirrored_);
+  EXPECT_FALSE(memory.Get(3).mirrored_);
+  EXPECT_FALSE(memory.Get(6).mirrored_);
+}
+
+TEST(RingMemoryTest, Prefault) {
+  const size_t capacity{static_cast<size_t>(::sysconf(_SC_PAGESIZE))};
+  RingMemory memory{capacity};
+  memory.Get(4).data_[7] = 42;
+  memory.Prefault();
+  EXPECT_EQ(42, memory.Get(4).data_[7]);
+  EXPECT_EQ(42, memory.Get(4).data_[4 * capacity + 7]);
+}
+
+} // namespace
+} // namespace plac
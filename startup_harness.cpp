@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: MIT
+
+// Measures the time from spawning flacplayer to its first committed frame.
+//
+// usage: startup_harness [--runs=<n>] <flacplayer> <file> [<flacplayer option>...]
+//
+// Each run starts the player with --device=file, which writes to the null PCM
+// of asoundrc, and --startup-trace. The player is stopped once the trace is
+// written. Cold runs drop the file and the player from the page cache first,
+// warm runs follow a run which loaded them. Per phase percentiles are printed
+// in milliseconds. A phase lasts from the previous mark to its own one, spawn
+// from posix_spawn() to entering main().
+
+#include "startup_trace.h"
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <spawn.h>
+#include <string>
+#include <string_view>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+namespace {
+
+constexpr std::chrono::seconds kTimeout{10};
+
+// samples in nanoseconds per phase, spawn first, total last
+struct Samples {
+  static constexpr size_t kColumns{plac::StartupTrace::kPhases + 1};
+
+  void Add(const int64_t spawned, const plac::StartupTrace::Marks &marks) {
+    int64_t previous{spawned};
+    for (size_t i{0}; i < plac::StartupTrace::kPhases; ++i) {
+      values_[i].push_back(marks[i] - previous);
+      previous = marks[i];
+    }
+    values_[kColumns - 1].push_back(marks.back() - spawned);
+  }
+
+  std::array<std::vector<int64_t>, kColumns> values_{};
+};
+
+// best effort. the kernel wide drop needs root, fadvise only drops clean pages of the file
+void DropCaches(const std::vector<std::string> &names) {
+  ::sync();
+  if (FILE *f{std::fopen("/proc/sys/vm/drop_caches", "w")}; f != nullptr) {
+    std::fputs("1", f);
+    std::fclose(f);
+    return;
+  }
+  for (const std::string &name : names) {
+    const int fd{::open(name.c_str(), O_RDONLY)};
+    if (fd >= 0) {
+      ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      ::close(fd);
+    }
+  }
+}
+
+std::optional<plac::StartupTrace::Marks> ReadTrace(const std::string &path) {
+  std::ifstream file{path};
+  if (!file) {
+    return std::nullopt;
+  }
+  const std::string text{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+  return plac::ParseStartupTrace(text);
+}
+
+// one run of the player, empty on failure
+std::optional<plac::StartupTrace::Marks> Run(std::vector<std::string> args, const std::string &file,
+                                             const std::string &trace, int64_t &spawned) {
+  std::remove(trace.c_str());
+  args.push_back("--device=file");
+  args.push_back("--startup-trace=" + trace);
+  args.push_back(file);
+  std::vector<char *> argv{};
+  for (std::string &arg : args) {
+    argv.push_back(arg.data());
+  }
+  argv.push_back(nullptr);
+
+  pid_t pid{};
+  spawned = plac::MonotonicNs();
+  const int r{::posix_spawn(&pid, argv[0], nullptr, nullptr, argv.data(), environ)};
+  if (r != 0) {
+    std::fprintf(stderr, "cannot spawn %s: %s\n", argv[0], ::strerror(r));
+    return std::nullopt;
+  }
+
+  std::optional<plac::StartupTrace::Marks> marks{};
+  int status{0};
+  bool exited{false};
+  const auto deadline{std::chrono::steady_clock::now() + kTimeout};
+  while (!marks && !exited && (std::chrono::steady_clock::now() < deadline)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    marks = ReadTrace(trace);
+    exited = ::waitpid(pid, &status, WNOHANG) == pid;
+  }
+  if (!exited) {
+    ::kill(pid, SIGKILL);
+    ::waitpid(pid, &status, 0);
+  }
+  std::remove(trace.c_str());
+  return marks;
+}
+
+void Print(const std::string_view title, const Samples &samples) {
+  std::printf("%s (%zu runs)\n", std::string{title}.c_str(), samples.values_[0].size());
+  std::printf("%-12s %9s %9s %9s %9s\n", "phase [ms]", "p50", "p90", "p99", "max");
+  for (size_t i{0}; i < Samples::kColumns; ++i) {
+    const std::string_view name{(i == 0)                        ? "spawn"
+                                : (i < Samples::kColumns - 1) ? plac::StartupTrace::kNames[i]
+                                                              : "total"};
+    const std::vector<int64_t> &v{samples.values_[i]};
+    std::printf("%-12s %9.3f %9.3f %9.3f %9.3f\n", std::string{name}.c_str(),
+                static_cast<double>(plac::Percentile(v, 50)) / 1e6,
+                static_cast<double>(plac::Percentile(v, 90)) / 1e6,
+                static_cast<double>(plac::Percentile(v, 99)) / 1e6,
+                static_cast<double>(plac::Percentile(v, 100)) / 1e6);
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int runs{20};
+  int first{1};
+  if ((argc > 1) && std::string_view{argv[1]}.starts_with("--runs=")) {
+    runs = std::atoi(argv[1] + std::strlen("--runs="));
+    first = 2;
+  }
+  if ((argc - first < 2) || (runs <= 0)) {
+    std::fprintf(stderr, "usage: %s [--runs=<n>] <flacplayer> <file> [<option>...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const std::string player{argv[first]};
+  const std::string file{argv[first + 1]};
+  std::vector<std::string> args{player};
+  for (int i{first + 2}; i < argc; ++i) {
+    args.emplace_back(argv[i]);
+  }
+  const std::string trace{std::format("/tmp/plac-startup-{}.trace", ::getpid())};
+
+  Samples cold{};
+  Samples warm{};
+  int failures{0};
+  for (int i{0}; i < runs; ++i) {
+    for (const bool is_cold : {true, false}) {
+      if (is_cold) {
+        DropCaches({player, file});
+      }
+      int64_t spawned{0};
+      const std::optional<plac::StartupTrace::Marks> marks{Run(args, file, trace, spawned)};
+      if (!marks) {
+        ++failures;
+        continue;
+      }
+      (is_cold ? cold : warm).Add(spawned, *marks);
+    }
+  }
+
+  Print("cold", cold);
+  std::printf("\n");
+  Print("warm", warm);
+  if (failures != 0) {
+    std::fprintf(stderr, "%d runs without a complete trace\n", failures);
+  }
+  return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
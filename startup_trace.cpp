@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MIT
+
+#include "startup_trace.h"
+#include "cache_file.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <ctime>
+#include <format>
+#include <span>
+
+namespace plac {
+
+int64_t MonotonicNs() {
+  timespec t{};
+  ::clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<int64_t>(t.tv_sec) * 1'000'000'000 + t.tv_nsec;
+}
+
+StartupTrace::StartupTrace(std::string path)
+    : path_{std::move(path)}, thread_{[this]() { Run(); }} {}
+
+StartupTrace::~StartupTrace() noexcept {
+  state_.store(2, std::memory_order_release);
+  state_.notify_one();
+  thread_.join();
+}
+
+void StartupTrace::Mark(const Phase phase, const int64_t ns) {
+  int64_t unmarked{0};
+  if (!marks_[static_cast<size_t>(phase)].compare_exchange_strong(unmarked, ns,
+                                                                  std::memory_order_acq_rel)) {
+    return;
+  }
+  if (phase == Phase::first_frame) {
+    int running{0};
+    if (state_.compare_exchange_strong(running, 1, std::memory_order_acq_rel)) {
+      state_.notify_one();
+    }
+  }
+}
+
+StartupTrace::Marks StartupTrace::Get() const {
+  Marks marks{};
+  for (size_t i{0}; i < kPhases; ++i) {
+    marks[i] = marks_[i].load(std::memory_order_acquire);
+  }
+  return marks;
+}
+
+void StartupTrace::Run() {
+  state_.wait(0, std::memory_order_acquire);
+
+  const std::string text{FormatStartupTrace(Get())};
+  WriteFileAtomically(path_, {std::as_bytes(std::span{text})});
+}
+
+std::string FormatStartupTrace(const StartupTrace::Marks &marks) {
+  std::string out{};
+  for (size_t i{0}; i < StartupTrace::kPhases; ++i) {
+    if (marks[i] != 0) {
+      out += std::format("{} {}\n", StartupTrace::kNames[i], marks[i]);
+    }
+  }
+  return out;
+}
+
+std::optional<StartupTrace::Marks> ParseStartupTrace(std::string_view text) {
+  StartupTrace::Marks marks{};
+  while (!text.empty()) {
+    const size_t end{std::min(text.find('\n'), text.size())};
+    const std::string_view line{text.substr(0, end)};
+    text.remove_prefix(std::min(end + 1, text.size()));
+
+    const size_t space{line.find(' ')};
+    if (space == std::string_view::npos) {
+      return std::nullopt;
+    }
+    const auto name{std::find(StartupTrace::kNames.begin(), StartupTrace::kNames.end(),
+                              line.substr(0, space))};
+    if (name == StartupTrace::kNames.end()) {
+      return std::nullopt;
+    }
+    int64_t &mark{marks[static_cast<size_t>(name - StartupTrace::kNames.begin())]};
+    const std::string_view value{line.substr(space + 1)};
+    const auto [ptr, ec]{std::from_chars(value.data(), value.data() + value.size(), mark)};
+    if ((ec != std::errc{}) || (ptr != value.data() + value.size())) {
+      return std::nullopt;
+    }
+  }
+  if (std::find(marks.begin(), marks.end(), 0) != marks.end()) {
+    return std::nullopt;
+  }
+  return marks;
+}
+
+int64_t Percentile(std::vector<int64_t> values, const double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  const double rank{std::ceil(p / 100.0 * static_cast<double>(values.size()))};
+  const size_t i{static_cast<size_t>(std::clamp(rank, 1.0, static_cast<double>(values.size())))
+                 - 1};
+  std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(i), values.end());
+  return values[i];
+}
+
+} // namespace plac
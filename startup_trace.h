@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef STARTUP_TRACE_H
+#define STARTUP_TRACE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace plac {
+
+// CLOCK_MONOTONIC in nanoseconds. The clock is shared by all processes, so
+// marks of the player can be compared with timestamps taken by the harness.
+int64_t MonotonicNs();
+
+// Timestamps of the startup phases of the player, from entering main() to the
+// first frame committed to the audio device.
+//
+// Each phase keeps its first mark. Mark() is lock-free and may be called from
+// the real-time thread. Once the first frame is marked, or on destruction, a
+// helper thread writes the trace to path in the format of FormatStartupTrace().
+class StartupTrace {
+public:
+  enum class Phase { main, options, device_open, file_open, metadata, device_init, first_frame };
+  static constexpr size_t kPhases{7};
+  static constexpr std::array<std::string_view, kPhases> kNames{
+      "main", "options", "device_open", "file_open", "metadata", "device_init", "first_frame"};
+  using Marks = std::array<int64_t, kPhases>;
+
+  explicit StartupTrace(std::string path);
+  StartupTrace(const StartupTrace &) = delete;
+  StartupTrace(StartupTrace &&) = delete;
+  StartupTrace &operator=(const StartupTrace &) = delete;
+  StartupTrace &operator=(StartupTrace &&) = delete;
+  ~StartupTrace() noexcept;
+
+  void Mark(const Phase phase, const int64_t ns = MonotonicNs());
+  // 0 for phases which are not marked yet
+  Marks Get() const;
+
+private:
+  void Run();
+
+  const std::string path_;
+  std::array<std::atomic<int64_t>, kPhases> marks_{};
+  // 0 while running, 1 once the first frame is marked, 2 on destruction
+  std::atomic<int> state_{0};
+  std::thread thread_;
+};
+
+// one line "<phase> <ns>" per marked phase
+std::string FormatStartupTrace(const StartupTrace::Marks &marks);
+// empty if text is not a complete trace
+std::optional<StartupTrace::Marks> ParseStartupTrace(std::string_view text);
+
+// nearest-rank percentile, p in [0, 100]. 0 if values is empty
+int64_t Percentile(std::vector<int64_t> values, double p);
+
+} // namespace plac
+
+#endif
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: MIT
+
+#include "startup_trace.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+
+namespace plac {
+namespace {
+
+TEST(StartupTraceTest, FirstMarkWins) {
+  constexpr const char *kName{"startup_trace_unit_test.trace"};
+  {
+    StartupTrace trace{kName};
+    trace.Mark(StartupTrace::Phase::options, 10);
+    trace.Mark(StartupTrace::Phase::options, 20);
+    const StartupTrace::Marks marks{trace.Get()};
+    EXPECT_EQ(10, marks[static_cast<size_t>(StartupTrace::Phase::options)]);
+    EXPECT_EQ(0, marks[static_cast<size_t>(StartupTrace::Phase::main)]);
+  }
+  // the destructor writes the trace
+  std::remove(kName);
+}
+
+TEST(StartupTraceTest, WrittenAtFirstFrame) {
+  constexpr const char *kName{"startup_trace_unit_test.trace"};
+  std::remove(kName);
+  StartupTrace::Marks expected{};
+  {
+    StartupTrace trace{kName};
+    for (size_t i{0}; i < StartupTrace::kPhases; ++i) {
+      expected[i] = static_cast<int64_t>(100 + i);
+      trace.Mark(static_cast<StartupTrace::Phase>(i), expected[i]);
+    }
+    // the helper writes the file before destruction
+    std::string text{};
+    while (text.empty()) {
+      std::ifstream file{kName};
+      text.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+    }
+    const std::optional<StartupTrace::Marks> marks{ParseStartupTrace(text)};
+    ASSERT_TRUE(marks);
+    EXPECT_EQ(expected, *marks);
+  }
+  std::remove(kName);
+}
+
+TEST(StartupTraceTest, Format) {
+  StartupTrace::Marks marks{};
+  marks[0] = 1;
+  marks[6] = 1'000'000'007;
+  EXPECT_EQ("main 1\nfirst_frame 1000000007\n", FormatStartupTrace(marks));
+}
+
+TEST(StartupTraceTest, ParseIncomplete) {
+  EXPECT_FALSE(ParseStartupTrace(""));
+  EXPECT_FALSE(ParseStartupTrace("main 1\nfirst_frame 2\n"));
+  EXPECT_FALSE(ParseStartupTrace("main x\n"));
+  EXPECT_FALSE(ParseStartupTrace("unknown 1\n"));
+}
+
+TEST(PercentileTest, NearestRank) {
+  const std::vector<int64_t> v{5, 1, 4, 2, 3, 10, 9, 8, 7, 6};
+  EXPECT_EQ(5, Percentile(v, 50));
+  EXPECT_EQ(9, Percentile(v, 90));
+  EXPECT_EQ(10, Percentile(v, 99));
+  EXPECT_EQ(10, Percentile(v, 100));
+  EXPECT_EQ(1, Percentile(v, 0));
+  EXPECT_EQ(0, Percentile({}, 50));
+}
+
+} // namespace
+} // namespace plac
@@ -1,8 +1,13 @@
 // SPDX-License-Identifier: MIT
 
 #include "stream.h"
-#include <cctype>
+#include "flac_frame.h"
+#include <algorithm>
 #include <cstring>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <unistd.h>
 
 namespace plac {
 
@@ -13,8 +18,22 @@ FLAC__StreamDecoderReadStatus read_callback(const FLAC__StreamDecoder *,
                                             void *client_data) {
     Stream *dec = static_cast<Stream *>(client_data);
 
-    if (*bytes > 0) {
-        const ssize_t r = read(dec->desc_.fd_, buffer, *bytes);
+    if ((*bytes > 0) && !dec->data_.empty()) {
+        const size_t n{std::min(*bytes, dec->data_.size() - dec->offset_)};
+        std::memcpy(buffer, &dec->data_[dec->offset_], n);
+        dec->offset_ += n;
+        dec->map_.Release(dec->offset_);
+
+        *bytes = n;
+        if (n > 0) {
+            return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+        } else {
+            return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+        }
+    } else if (*bytes > 0) {
+        const ssize_t r = (dec->input_ == Stream::Input::uring)
+                              ? dec->uring_.Read(buffer, *bytes)
+                              : read(dec->desc_.fd_, buffer, *bytes);
 
         *bytes = std::max(ssize_t{0}, r);
         if (r > 0) {
@@ -29,7 +48,97 @@ FLAC__StreamDecoderReadStatus read_callback(const FLAC__StreamDecoder *,
     }
 }
 
-FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *,
+// moves the read position of the file or the data in memory
+bool SeekTo(Stream &stream, const uint64_t offset) {
+    if (!stream.data_.empty()) {
+        if (offset > stream.data_.size()) {
+            return false;
+        }
+        stream.offset_ = offset;
+        return true;
+    }
+    if (stream.input_ == Stream::Input::uring) {
+        return stream.uring_.Seek(offset);
+    }
+    return ::lseek(stream.desc_.fd_, static_cast<off_t>(offset), SEEK_SET) >= 0;
+}
+
+FLAC__StreamDecoderSeekStatus seek_callback(const FLAC__StreamDecoder *,
+                                            FLAC__uint64 absolute_byte_offset,
+                                            void *client_data) {
+    return SeekTo(*static_cast<Stream *>(client_data), absolute_byte_offset)
+               ? FLAC__STREAM_DECODER_SEEK_STATUS_OK
+               : FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+}
+
+FLAC__StreamDecoderTellStatus tell_callback(const FLAC__StreamDecoder *,
+                                            FLAC__uint64 *absolute_byte_offset,
+                                            void *client_data) {
+    const Stream *stream = static_cast<const Stream *>(client_data);
+    if (!stream->data_.empty()) {
+        *absolute_byte_offset = stream->offset_;
+        return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+    }
+    if (stream->input_ == Stream::Input::uring) {
+        *absolute_byte_offset = stream->uring_.Tell();
+        return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+    }
+    const off_t offset{::lseek(stream->desc_.fd_, 0, SEEK_CUR)};
+    if (offset < 0) {
+        return FLAC__STREAM_DECODER_TELL_STATUS_ERROR;
+    }
+    *absolute_byte_offset = static_cast<FLAC__uint64>(offset);
+    return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+
+FLAC__StreamDecoderLengthStatus length_callback(const FLAC__StreamDecoder *,
+                                                FLAC__uint64 *stream_length,
+                                                void *client_data) {
+    *stream_length = static_cast<const Stream *>(client_data)->size_;
+    return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+
+FLAC__bool eof_callback(const FLAC__StreamDecoder *, void *client_data) {
+    const Stream *stream = static_cast<const Stream *>(client_data);
+    if (!stream->data_.empty()) {
+        return stream->offset_ >= stream->data_.size();
+    }
+    if (stream->input_ == Stream::Input::uring) {
+        return stream->uring_.Tell() >= stream->size_;
+    }
+    const off_t offset{::lseek(stream->desc_.fd_, 0, SEEK_CUR)};
+    return (offset < 0) || (static_cast<uint64_t>(offset) >= stream->size_);
+}
+
+// moves one FLAC frame into the audio buffer. waits for the output thread
+// whenever the buffer is full.
+template <typename Format>
+void WriteFrame(Stream &stream, const int *left, const int *right, size_t length) {
+    const Format format{stream.format_.rate};
+    while (length != 0) {
+        const unsigned int sequence{stream.flow_.Sequence()};
+        const ssize_t n{stream.audio_buffer_.Write(format, left, right, length)};
+        if (n == 0) {
+            // buffer is full. wait until the output thread consumed a period.
+            stream.flow_.Wait(sequence);
+            continue;
+        }
+        stream.flow_.Notify();
+
+        length -= n;
+        left += n;
+        right += n;
+    }
+}
+
+// nullptr if the format is not supported
+Stream::WriteFn SelectWriteFn(const AudioFormat format) {
+    Stream::WriteFn fn{nullptr};
+    WithFixedFormat(format, [&fn](const auto f) { fn = &WriteFrame<decltype(f)>; });
+    return fn;
+}
+
+FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *decoder,
                                               const FLAC__Frame *frame,
                                               const FLAC__int32 *const buffer[],
                                               void *client_data) {
@@ -54,50 +163,169 @@ FLAC__StreamDecoderWriteStatus write_callback(const FLAC__StreamDecoder *,
         return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
     }
 
-    const size_t length = frame->header.blocksize;
-    const int *left = buffer[0];
-    const int *right = buffer[1];
-    stream->device_.Play(left, length, right, stream->format_);
+    if (stream->metrics_ != nullptr) {
+        const auto decoded{std::chrono::steady_clock::now() - stream->decode_start_};
+        stream->metrics_->decode_ns_.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(decoded).count(),
+            std::memory_order_relaxed);
+        stream->metrics_->decoded_frames_.fetch_add(frame->header.blocksize,
+                                                    std::memory_order_relaxed);
+    }
+
+    // libFLAC converts frame numbers of fixed block size streams into sample numbers
+    const uint64_t sample{frame->header.number.sample_number};
+    const size_t blocksize{frame->header.blocksize};
+    if (stream->recording_) {
+        // the decoder has consumed the frame, its position is the start of the next one
+        FLAC__uint64 position{};
+        if ((frame->header.number_type == FLAC__FRAME_NUMBER_TYPE_SAMPLE_NUMBER)
+            && FLAC__stream_decoder_get_decode_position(decoder, &position)
+            && (position >= stream->audio_start_)) {
+            stream->index_.Add(sample + blocksize, position - stream->audio_start_);
+        } else {
+            stream->recording_ = false;
+        }
+    }
+
+    const size_t skip{(stream->skip_to_ > sample)
+                          ? static_cast<size_t>(std::min<uint64_t>(stream->skip_to_ - sample,
+                                                                   blocksize))
+                          : 0};
+    if (skip < blocksize) {
+        stream->write_(*stream, buffer[0] + skip, buffer[1] + skip, blocksize - skip);
+        if (stream->verifier_ != nullptr) {
+            stream->verifier_->Add(buffer[0] + skip, buffer[1] + skip, blocksize - skip);
+        }
+    }
 
+    // waiting for the output thread does not count as decoding
+    stream->decode_start_ = std::chrono::steady_clock::now();
     return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
 
-void error_callback(const FLAC__StreamDecoder *, FLAC__StreamDecoderErrorStatus, void *)
-{
-    ENSURES(false, "error callback");
-}
+// copies frames from memory into the audio buffer. waits for the output
+// thread whenever the buffer is full.
+void WriteBytes(Stream &stream, const u_char *data, size_t frames) {
+    while (frames != 0) {
+        const unsigned int sequence{stream.flow_.Sequence()};
+        const std::span<u_char> span{stream.audio_buffer_.GetWriteSpan(stream.format_, frames)};
+        if (span.empty()) {
+            stream.flow_.Wait(sequence);
+            continue;
+        }
+        std::memcpy(span.data(), data, span.size());
+        const size_t n{AsFrames(stream.format_, span.size())};
+        stream.audio_buffer_.CommitWrite(n);
+        stream.flow_.Notify();
 
-int tagcompare(const char *s1, const char *s2, int n) {
-  int c = 0;
-  while (c < n) {
-    if (toupper(s1[c]) != toupper(s2[c])) {
-      return !0;
+        data += span.size();
+        frames -= n;
     }
-    c++;
-  }
-  return 0;
 }
 
-const char *vorbis_comment_query(const FLAC__StreamMetadata_VorbisComment &vc,
-                                 const char *tag, int count) {
-    int found = 0;
-    int taglen = strlen(tag) + 1; /* +1 for the = we append */
-    char *fulltag = (char *) alloca(taglen + 1);
+// decodes the frames from frame_offset_ on with frame_decoder_. a frame is
+// decoded straight into the audio buffer once it has contiguous space for it.
+// frames which are split at the end of the ring or partly skipped after a seek
+// go through pcm_. a corrupt frame is dropped and decoding continues at the
+// next frame header.
+void DecodeFrames(Stream &stream) {
+    const StreamInfo &info{stream.frame_decoder_.Info()};
+    const AudioFormat format{stream.format_};
+    size_t offset{stream.frame_offset_};
+    while (offset < stream.data_.size()) {
+        const std::span<const u_char> data{stream.data_.subspan(offset)};
+        const std::optional<FrameHeader> header{ParseFrameHeader(data, info)};
+        if (!header) {
+            LOG_ERROR("lost sync at byte {}", offset);
+            ++stream.errors_;
+            offset = FindFrameHeader(stream.data_, offset + 1, info);
+            continue;
+        }
+        const size_t blocksize{header->blocksize_};
+        const uint64_t sample{header->first_sample_};
+        const size_t skip{(stream.skip_to_ > sample)
+                              ? static_cast<size_t>(std::min<uint64_t>(stream.skip_to_ - sample,
+                                                                       blocksize))
+                              : 0};
 
-    strcpy(fulltag, tag);
-    strcat(fulltag, "=");
+        std::span<u_char> span{};
+        while (skip == 0) {
+            const unsigned int sequence{stream.flow_.Sequence()};
+            span = stream.audio_buffer_.GetWriteSpan(format, blocksize);
+            if ((AsFrames(format, span.size()) == blocksize)
+                || (stream.audio_buffer_.GetFreeFrames(format) >= blocksize)) {
+                break;
+            }
+            stream.flow_.Wait(sequence);
+        }
+        const bool direct{(skip == 0) && (AsFrames(format, span.size()) == blocksize)};
 
-    for (long i = 0; i < vc.num_comments; i++) {
-        if (!tagcompare((const char *) vc.comments[i].entry, fulltag, taglen)) {
-            if (count == found)
-                /* We return a pointer to the data, not a copy */
-                return (const char *) vc.comments[i].entry + taglen;
-            else {
-                found++;
+        const auto start{std::chrono::steady_clock::now()};
+        const size_t size{
+            stream.frame_decoder_.Decode(data, *header, direct ? span.data() : stream.pcm_.data())};
+        if (size == 0) {
+            LOG_ERROR("corrupt frame at byte {}", offset);
+            ++stream.errors_;
+            offset = FindFrameHeader(stream.data_, offset + 1, info);
+            continue;
+        }
+        if (stream.metrics_ != nullptr) {
+            const auto decoded{std::chrono::steady_clock::now() - start};
+            stream.metrics_->decode_ns_.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(decoded).count(),
+                std::memory_order_relaxed);
+            stream.metrics_->decoded_frames_.fetch_add(blocksize, std::memory_order_relaxed);
+        }
+
+        if (direct) {
+            stream.audio_buffer_.CommitWrite(blocksize);
+            stream.flow_.Notify();
+            if (stream.verifier_ != nullptr) {
+                stream.verifier_->Add(span);
+            }
+        } else if (skip < blocksize) {
+            const std::span<const u_char> written{
+                std::span<const u_char>{stream.pcm_}.subspan(AsBytes(format, skip),
+                                                             AsBytes(format, blocksize - skip))};
+            WriteBytes(stream, written.data(), blocksize - skip);
+            if (stream.verifier_ != nullptr) {
+                stream.verifier_->Add(written);
             }
         }
+
+        offset += size;
+        if (stream.recording_) {
+            stream.index_.Add(sample + blocksize, offset - stream.audio_start_);
+        }
+        stream.map_.Release(offset);
+    }
+    stream.frame_offset_ = offset;
+}
+
+// libFLAC drops the frame, or writes silence for it on a CRC mismatch, and
+// continues at the next frame
+void error_callback(const FLAC__StreamDecoder *,
+                    const FLAC__StreamDecoderErrorStatus status,
+                    void *client_data)
+{
+    Stream *stream = static_cast<Stream *>(client_data);
+    ++stream->errors_;
+    LOG_ERROR("decoding error: {}", FLAC__StreamDecoderErrorStatusString[status]);
+}
+
+// first value of each tag in a single pass over the comments
+Tags vorbis_comment_tags(const FLAC__StreamMetadata_VorbisComment &vc) {
+    Tags tags{};
+    for (FLAC__uint32 i = 0; i < vc.num_comments; i++) {
+        const std::string_view comment{reinterpret_cast<const char *>(vc.comments[i].entry),
+                                       vc.comments[i].length};
+        std::string_view value{};
+        if (const std::optional<Tag> tag{MatchTag(comment, value)};
+            tag && tags[static_cast<size_t>(*tag)].empty()) {
+            tags[static_cast<size_t>(*tag)] = value;
+        }
     }
-    return "<none>"; /* didn't find anything */
+    return tags;
 }
 
 void metadata_callback(const FLAC__StreamDecoder *,
@@ -108,36 +336,82 @@ void metadata_callback(const FLAC__StreamDecoder *,
         stream->format_.rate = metadata->data.stream_info.sample_rate;
         stream->format_.bits = metadata->data.stream_info.bits_per_sample;
         stream->format_.channels = metadata->data.stream_info.channels;
+        stream->total_samples_ = metadata->data.stream_info.total_samples;
+        std::copy_n(metadata->data.stream_info.md5sum, stream->md5_.size(), stream->md5_.begin());
+        stream->write_ = SelectWriteFn(stream->format_);
+    } else if (metadata->type == FLAC__METADATA_TYPE_SEEKTABLE) {
+        Stream *stream = static_cast<Stream *>(client_data);
+        const FLAC__StreamMetadata_SeekTable &table{metadata->data.seek_table};
+        for (uint32_t i{0}; i < table.num_points; ++i) {
+            if (table.points[i].sample_number != FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER) {
+                stream->index_.Add(table.points[i].sample_number, table.points[i].stream_offset);
+            }
+        }
     } else if (metadata->type == FLAC__METADATA_TYPE_VORBIS_COMMENT) {
-        printf("%s/%s: %s - %s | %s\n",
-               vorbis_comment_query(metadata->data.vorbis_comment, "TRACKNUMBER", 0),
-               vorbis_comment_query(metadata->data.vorbis_comment, "TRACKTOTAL", 0),
-               vorbis_comment_query(metadata->data.vorbis_comment, "TITLE", 0),
-               vorbis_comment_query(metadata->data.vorbis_comment, "ARTIST", 0),
-               vorbis_comment_query(metadata->data.vorbis_comment, "ALBUM", 0));
-        fflush(stdout);
+        const Tags tags{vorbis_comment_tags(metadata->data.vorbis_comment)};
+        const auto tag{[&tags](const Tag t) {
+            const std::string_view value{tags[static_cast<size_t>(t)]};
+            return value.empty() ? std::string_view{"<none>"} : value;
+        }};
+        LOG_INFO("{}/{}: {} - {} | {}", tag(Tag::tracknumber), tag(Tag::tracktotal),
+                 tag(Tag::title), tag(Tag::artist), tag(Tag::album));
     }
 }
 
 } // namespace
 
-Stream::Stream(const AlsaAudioDevice::Output out)
+Stream::Stream(AudioBuffer<65536> &audio_buffer,
+               FlowControl &flow,
+               const Input input,
+               const size_t memory_limit,
+               const Engine engine)
     : decoder_{FLAC__stream_decoder_new()}
+    , name_{}
     , desc_{}
     , format_{}
-    , device_{out}
+    , write_{nullptr}
+    , input_{input}
+    , memory_limit_{memory_limit}
+    , memory_{}
+    , map_{}
+    , uring_{}
+    , data_{}
+    , offset_{0}
+    , size_{0}
+    , total_samples_{0}
+    , md5_{}
+    , audio_start_{0}
+    , index_{}
+    , recording_{false}
+    , skip_to_{0}
+    , index_dir_{}
+    , index_path_{}
+    , engine_{engine}
+    , frame_decoder_{}
+    , native_{false}
+    , frame_offset_{0}
+    , pcm_{}
+    , errors_{0}
+    , audio_buffer_{audio_buffer}
+    , flow_{flow}
 {
     ENSURES(decoder_ != nullptr, "cannot create FLAC decoder");
+    if ((input_ == Input::uring) && !uring_.Init()) {
+        LOG_ERROR("falling back to read");
+        input_ = Input::read;
+    }
     const FLAC__bool ret
         = FLAC__stream_decoder_set_metadata_respond(decoder_, FLAC__METADATA_TYPE_VORBIS_COMMENT);
     ENSURES(ret == true, "cannot query vorbis comment");
+    ENSURES(FLAC__stream_decoder_set_metadata_respond(decoder_, FLAC__METADATA_TYPE_SEEKTABLE),
+            "cannot query seek table");
     const FLAC__StreamDecoderInitStatus init_status
         = FLAC__stream_decoder_init_stream(decoder_,
                                            read_callback,
-                                           nullptr,
-                                           nullptr,
-                                           nullptr,
-                                           nullptr,
+                                           seek_callback,
+                                           tell_callback,
+                                           length_callback,
+                                           eof_callback,
                                            write_callback,
                                            metadata_callback,
                                            error_callback,
@@ -157,18 +431,187 @@ bool Stream::Reset(const char *name) {
     }
 
     ENSURES(FLAC__stream_decoder_reset(decoder_), "cannot reset decoder");
+    name_ = name;
+    data_ = {};
+    offset_ = 0;
+    size_ = 0;
+    total_samples_ = 0;
+    md5_ = {};
+    errors_ = 0;
+    audio_start_ = 0;
+    index_ = FrameIndex{};
+    recording_ = false;
+    skip_to_ = 0;
+    index_path_.clear();
+    native_ = false;
+    frame_offset_ = 0;
+    write_ = nullptr;
+    memory_ = LockedBuffer{};
+    map_ = MappedFile{};
     desc_ = FileDesc{name};
     if (!desc_.IsValid()) {
         LOG_ERROR("invalid file: {}", name);
         return false;
     }
+    // larger readahead for read(), best effort. mappings have MADV_SEQUENTIAL
+    ::posix_fadvise(desc_.fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+    if (startup_ != nullptr) {
+        startup_->Mark(StartupTrace::Phase::file_open);
+    }
+    const std::optional<FrameIndex::Key> key{MakeFrameIndexKey(desc_.fd_)};
+    if (!key) {
+        LOG_ERROR("cannot stat file: {}", name);
+        return false;
+    }
+    size_ = key->size_;
+    if (input_ == Input::memory) {
+        memory_ = LockedBuffer{desc_, memory_limit_};
+        if (memory_.IsValid()) {
+            data_ = {memory_.data_, memory_.size_};
+        } else {
+            LOG_ERROR("cannot load file into memory, falling back to mmap: {}", name);
+        }
+    }
+    if (data_.empty() && ((input_ == Input::mmap) || (input_ == Input::memory))) {
+        map_ = MappedFile{desc_};
+        if (map_.IsValid()) {
+            data_ = {map_.data_, map_.size_};
+        } else {
+            LOG_ERROR("cannot map file, falling back to read: {}", name);
+        }
+    }
+    if (input_ == Input::uring) {
+        uring_.metrics_ = metrics_;
+        uring_.Open(desc_.fd_, size_);
+    }
     const FLAC__bool ret{FLAC__stream_decoder_process_until_end_of_metadata(decoder_)};
-    return ret != 0;
+    if (ret == 0) {
+        return false;
+    }
+    if (startup_ != nullptr) {
+        startup_->Mark(StartupTrace::Phase::metadata);
+    }
+
+    FLAC__uint64 position{};
+    ENSURES(FLAC__stream_decoder_get_decode_position(decoder_, &position),
+            "cannot get position of the first frame");
+    audio_start_ = position;
+    index_.Add(0, 0);
+    if (!index_dir_.empty()) {
+        index_path_ = FrameIndexPath(index_dir_, name);
+        if (!index_path_.empty()) {
+            if (std::optional<FrameIndex> cached{FrameIndex::Load(index_path_, *key)};
+                cached && cached->complete_) {
+                index_ = std::move(*cached);
+            }
+        }
+    }
+    recording_ = !index_.complete_;
+
+    if ((engine_ == Engine::native) && !data_.empty() && (write_ != nullptr)) {
+        const std::optional<StreamLayout> layout{ParseStreamLayout(data_)};
+        native_ = layout && (layout->audio_start_ == audio_start_)
+                  && frame_decoder_.Reset(layout->info_);
+        if (native_) {
+            frame_offset_ = audio_start_;
+            pcm_.resize(size_t{layout->info_.max_blocksize_} * frame_decoder_.FrameBytes());
+        } else {
+            LOG_INFO("native decoder does not support {}, using libFLAC", name);
+        }
+    }
+    return true;
+}
+
+bool Stream::Seek(const uint64_t sample) {
+    if ((total_samples_ != 0) && (sample >= total_samples_)) {
+        LOG_ERROR("cannot seek to {} beyond the end at {}", sample, total_samples_);
+        return false;
+    }
+    // the index is only recorded from the start
+    recording_ = false;
+    skip_to_ = 0;
+
+    // decoding forward from an indexed frame needs no search. libFLAC bisects
+    // the file if the closest frame is too far before sample.
+    const std::optional<FrameIndex::Entry> entry{index_.Find(sample)};
+    if (entry && ((sample - entry->sample_) <= uint64_t{kMaxSkipSeconds} * format_.rate)) {
+        if (!SeekTo(*this, audio_start_ + entry->offset_)) {
+            LOG_ERROR("cannot seek to offset {}", audio_start_ + entry->offset_);
+            return false;
+        }
+        ENSURES(FLAC__stream_decoder_flush(decoder_), "cannot flush decoder");
+        frame_offset_ = audio_start_ + entry->offset_;
+        skip_to_ = sample;
+        return true;
+    }
+    // writes the frame at sample from its first sample on. the native decoder
+    // does not know where libFLAC stopped, so libFLAC decodes the rest
+    native_ = false;
+    return FLAC__stream_decoder_seek_absolute(decoder_, sample) != 0;
+}
+
+bool Stream::WarmUp() {
+    // nothing is written, recorded or accounted
+    const bool recording{recording_};
+    PlaybackMetrics *const metrics{metrics_};
+    recording_ = false;
+    metrics_ = nullptr;
+    skip_to_ = std::numeric_limits<uint64_t>::max();
+    bool decoded{};
+    if (native_) {
+        const std::span<const u_char> data{data_.subspan(frame_offset_)};
+        const std::optional<FrameHeader> header{ParseFrameHeader(data, frame_decoder_.Info())};
+        decoded = header && (frame_decoder_.Decode(data, *header, pcm_.data()) != 0);
+    } else {
+        decoded = FLAC__stream_decoder_process_single(decoder_) != 0;
+    }
+    recording_ = recording;
+    metrics_ = metrics;
+    skip_to_ = 0;
+    if (!decoded) {
+        LOG_ERROR("cannot decode the first frame of {}", name_);
+        return false;
+    }
+    // frame_offset_ of the native decoder has not moved
+    if (!SeekTo(*this, audio_start_)) {
+        LOG_ERROR("cannot seek to offset {}", audio_start_);
+        return false;
+    }
+    ENSURES(FLAC__stream_decoder_flush(decoder_), "cannot flush decoder");
+    return true;
 }
 
-void Stream::Decode() {
-    const FLAC__bool ret = FLAC__stream_decoder_process_until_end_of_stream(decoder_);
-    ENSURES(ret == true, "stream decoding error");
+bool Stream::Decode() {
+    if (verifier_ != nullptr) {
+        verifier_->Begin(name_, md5_, total_samples_, format_);
+    }
+    decode_start_ = std::chrono::steady_clock::now();
+    bool decoded{true};
+    if (native_) {
+        DecodeFrames(*this);
+    } else if (FLAC__stream_decoder_process_until_end_of_stream(decoder_) == 0) {
+        // e.g. write_callback rejects a frame whose format differs from STREAMINFO.
+        // the next Reset() recovers the decoder
+        LOG_ERROR("cannot decode {}: {}", name_,
+                  FLAC__stream_decoder_get_resolved_state_string(decoder_));
+        decoded = false;
+    }
+    if (verifier_ != nullptr) {
+        verifier_->End();
+    }
+
+    // the last entry is the end of the stream, which follows the last frame
+    if (decoded && recording_ && (total_samples_ != 0)
+        && (index_.entries_.back().sample_ == total_samples_)) {
+        index_.entries_.pop_back();
+        index_.complete_ = true;
+        recording_ = false;
+        if (const std::optional<FrameIndex::Key> key{MakeFrameIndexKey(desc_.fd_)};
+            key && !index_path_.empty()) {
+            index_.Save(index_path_, *key);
+        }
+    }
+    return decoded;
 }
 
 } // namespace plac
@@ -3,15 +3,49 @@
 #ifndef STREAM_H
 #define STREAM_H
 
-#include "alsa_audio_device.h"
+#include "audio_buffer.h"
 #include "audio_format.h"
 #include "file_desc.h"
+#include "frame_decoder.h"
+#include "frame_index.h"
+#include "flow_control.h"
+#include "locked_buffer.h"
+#include "mapped_file.h"
+#include "metrics.h"
+#include "playback_verifier.h"
+#include "startup_trace.h"
+#include "uring_reader.h"
 #include <FLAC/stream_decoder.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
 
 namespace plac {
 
 struct Stream {
-  Stream(const AlsaAudioDevice::Output out);
+  // read: read(2) per libFLAC request
+  // mmap: memcpy from a mapping of the whole file, falls back to read if mapping fails
+  // memory: Reset() loads the whole file into locked memory, falls back to mmap for
+  //         files larger than memory_limit
+  // uring: UringReader keeps reads in flight ahead of libFLAC, falls back to read
+  //        if io_uring is not available
+  enum class Input { read, mmap, memory, uring };
+  // libflac: libFLAC decodes frames into planar buffers which are interleaved
+  //          into audio_buffer_
+  // native: FrameDecoder decodes frames straight into audio_buffer_. needs the
+  //         file in data_ and a format FrameDecoder supports, falls back to
+  //         libflac otherwise
+  enum class Engine { libflac, native };
+
+  static constexpr size_t kDefaultMemoryLimit{256U << 20U};
+  // Seek() decodes at most this far forward from an indexed frame
+  static constexpr unsigned int kMaxSkipSeconds{10};
+
+  Stream(AudioBuffer<65536> &audio_buffer, FlowControl &flow, const Input input = Input::read,
+         const size_t memory_limit = kDefaultMemoryLimit, const Engine engine = Engine::libflac);
   Stream(const Stream &) = delete;
   Stream(Stream &&) = delete;
   Stream &operator=(const Stream &) = delete;
@@ -19,13 +53,72 @@ struct Stream {
   ~Stream() noexcept;
 
   bool Reset(const char *name);
-  void Decode();
+  // continues decoding at sample. call after Reset() and before Decode()
+  bool Seek(const uint64_t sample);
+  // decodes the first frame and drops it, so that the decoder allocates and
+  // touches its buffers before playback. call after Reset() and before Seek()
+  bool WarmUp();
+  // false if libFLAC gave up on the rest of the stream, which is logged
+  bool Decode();
+
+  // writes one decoded frame of length samples per channel to audio_buffer_
+  using WriteFn = void (*)(Stream &stream, const int *left, const int *right, size_t length);
 
   FLAC__StreamDecoder *decoder_;
+  // of the last Reset()
+  std::string name_;
   FileDesc desc_;
   AudioFormat format_;
+  // specialized for format_, selected when the STREAMINFO block is read
+  WriteFn write_;
+
+  Input input_;
+  size_t memory_limit_;
+  LockedBuffer memory_;
+  MappedFile map_;
+  UringReader uring_;
+  // bytes of the file in memory_ or map_. empty when reading from desc_
+  std::span<const u_char> data_;
+  size_t offset_;
+  // size of the file
+  uint64_t size_;
+
+  // from STREAMINFO, 0 if unknown
+  uint64_t total_samples_;
+  // from STREAMINFO, zeros if the encoder did not compute it
+  std::array<u_char, 16> md5_;
+  // byte offset of the first frame
+  uint64_t audio_start_;
+  // frames from the SEEKTABLE or the cache, and frames decoded while recording_
+  FrameIndex index_;
+  // every decoded frame is added to index_. true until the first seek
+  bool recording_;
+  // samples before are dropped, set by a seek to a frame of index_
+  uint64_t skip_to_;
+  // complete indexes are cached in index_dir_. empty to disable the cache
+  std::string index_dir_;
+  std::string index_path_;
+
+  Engine engine_;
+  FrameDecoder frame_decoder_;
+  // Decode() continues with frame_decoder_ at frame_offset_ in data_
+  bool native_;
+  uint64_t frame_offset_;
+  // frames which do not go straight into audio_buffer_
+  std::vector<u_char> pcm_;
+  // corrupt frames and lost syncs since Reset(). decoding skips them
+  size_t errors_;
+
+  AudioBuffer<65536> &audio_buffer_;
+  FlowControl &flow_;
 
-  ::plac::AlsaAudioDevice device_;
+  // optional. decode time is accounted from decode_start_ to each write_callback
+  PlaybackMetrics *metrics_{nullptr};
+  std::chrono::steady_clock::time_point decode_start_{};
+  // optional. marks the file_open and metadata phases
+  StartupTrace *startup_{nullptr};
+  // optional. receives a copy of every frame Decode() writes to audio_buffer_
+  PlaybackVerifier *verifier_{nullptr};
 };
 
 } // namespace plac
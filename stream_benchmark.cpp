@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: MIT
+
+#include "audio_buffer.h"
+#include "audio_sink.h"
+#include "conditions.h"
+#include "fake_audio_device.h"
+#include "flow_control.h"
+#include "parallel_decoder.h"
+#include "stream.h"
+#include <FLAC/stream_encoder.h>
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <memory>
+#include <numbers>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr unsigned int kSeconds{5};
+
+struct Config {
+  unsigned int bits;
+  unsigned int rate;
+  unsigned int blocksize;
+  unsigned int level;
+
+  auto operator<=>(const Config &) const = default;
+};
+
+// encodes kSeconds of two sines with some noise on top, so that the residual
+// coding has work to do as with music
+std::string Encode(const Config &c) {
+  const std::filesystem::path path{std::filesystem::temp_directory_path()
+                                   / std::format("plac_stream_benchmark_{}_{}_{}_{}.flac", c.bits,
+                                                 c.rate, c.blocksize, c.level)};
+
+  FLAC__StreamEncoder *encoder{FLAC__stream_encoder_new()};
+  ENSURES(encoder != nullptr, "cannot create FLAC encoder");
+  FLAC__stream_encoder_set_channels(encoder, 2);
+  FLAC__stream_encoder_set_bits_per_sample(encoder, c.bits);
+  FLAC__stream_encoder_set_sample_rate(encoder, c.rate);
+  FLAC__stream_encoder_set_compression_level(encoder, c.level);
+  FLAC__stream_encoder_set_blocksize(encoder, c.blocksize);
+  FLAC__stream_encoder_set_total_samples_estimate(encoder, FLAC__uint64{kSeconds} * c.rate);
+  ENSURES(FLAC__stream_encoder_init_file(encoder, path.c_str(), nullptr, nullptr)
+              == FLAC__STREAM_ENCODER_INIT_STATUS_OK,
+          "cannot initialize FLAC encoder for {}", path.c_str());
+
+  const double amplitude{static_cast<double>((1 << (c.bits - 1)) - 1) / 2.0};
+  const int noise{1 << (c.bits - 12)};
+  unsigned int lcg{1};
+  std::vector<FLAC__int32> interleaved(2 * c.rate);
+  for (unsigned int s{0}; s < kSeconds; ++s) {
+    for (unsigned int i{0}; i < c.rate; ++i) {
+      const double t{static_cast<double>(s * c.rate + i) / c.rate};
+      lcg = lcg * 1664525U + 1013904223U;
+      const int n{static_cast<int>(lcg >> 16U) % noise};
+      const double w{2 * std::numbers::pi * t};
+      interleaved[2 * i] = static_cast<FLAC__int32>(amplitude * std::sin(440 * w)) + n;
+      interleaved[2 * i + 1] = static_cast<FLAC__int32>(amplitude * std::sin(660 * w)) - n;
+    }
+    ENSURES(FLAC__stream_encoder_process_interleaved(encoder, interleaved.data(), c.rate),
+            "cannot encode {}", path.c_str());
+  }
+  ENSURES(FLAC__stream_encoder_finish(encoder), "cannot finish {}", path.c_str());
+  FLAC__stream_encoder_delete(encoder);
+  return path.string();
+}
+
+// encodes each configuration once and removes the files at exit
+class TestFiles {
+public:
+  TestFiles() = default;
+  TestFiles(const TestFiles &) = delete;
+  TestFiles(TestFiles &&) = delete;
+  TestFiles &operator=(const TestFiles &) = delete;
+  TestFiles &operator=(TestFiles &&) = delete;
+  ~TestFiles() noexcept {
+    for (const auto &[config, name] : names_) {
+      std::remove(name.c_str());
+    }
+  }
+
+  const std::string &Get(const Config &c) {
+    auto it{names_.find(c)};
+    if (it == names_.end()) {
+      it = names_.emplace(c, Encode(c)).first;
+    }
+    return it->second;
+  }
+
+private:
+  std::map<Config, std::string> names_;
+};
+
+TestFiles files{};
+
+// plays the audio buffer on its own thread, like the output thread of the player
+class Output {
+public:
+  Output(plac::AudioBuffer<65536> &audio_buffer, plac::FlowControl &flow,
+         const plac::AudioFormat format, const double speed)
+      : device_{format.rate, format.rate / 10, speed},
+        thread_{[this, &audio_buffer, &flow, format]() {
+          plac::Playback(device_, audio_buffer, flow, format, format.rate / 40);
+        }} {}
+  Output(const Output &) = delete;
+  Output(Output &&) = delete;
+  Output &operator=(const Output &) = delete;
+  Output &operator=(Output &&) = delete;
+  ~Output() noexcept { Join(); }
+
+  void Join() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  plac::FakeAudioDevice device_;
+
+private:
+  std::thread thread_;
+};
+
+// Stream::Reset() and Stream::Decode() of a whole file into a FakeAudioDevice
+// which discards the frames right away.
+// args: bits per sample, sample rate, block size, compression level, engine
+void Decode(benchmark::State &state) {
+  const Config config{static_cast<unsigned int>(state.range(0)),
+                      static_cast<unsigned int>(state.range(1)),
+                      static_cast<unsigned int>(state.range(2)),
+                      static_cast<unsigned int>(state.range(3))};
+  const std::string &name{files.Get(config)};
+
+  plac::FlowControl flow{};
+  auto audio_buffer{std::make_unique<plac::AudioBuffer<65536>>()};
+  // the file is read from the page cache to leave storage out of the measurement
+  plac::Stream stream{*audio_buffer, flow, plac::Stream::Input::mmap,
+                      plac::Stream::kDefaultMemoryLimit,
+                      static_cast<plac::Stream::Engine>(state.range(4))};
+  if (!stream.Reset(name.c_str())) {
+    state.SkipWithError("cannot open file");
+    return;
+  }
+  {
+    Output output{*audio_buffer, flow, stream.format_, 0.0};
+    for (auto _ : state) {
+      if (!stream.Reset(name.c_str())) {
+        state.SkipWithError("cannot open file");
+        break;
+      }
+      stream.Decode();
+    }
+    flow.Close();
+  }
+
+  // items are samples of both channels. per_frame is the wall time per stereo frame.
+  const int64_t frames{static_cast<int64_t>(state.iterations()) * kSeconds * config.rate};
+  state.SetItemsProcessed(frames * 2);
+  state.counters["per_frame"]
+      = benchmark::Counter(static_cast<double>(frames),
+                           benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+// whole pipeline against a FakeAudioDevice with a 100ms buffer which plays
+// args[4] times faster than real time. CPU time is the one of the decode thread.
+void Pipeline(benchmark::State &state) {
+  const Config config{static_cast<unsigned int>(state.range(0)),
+                      static_cast<unsigned int>(state.range(1)),
+                      static_cast<unsigned int>(state.range(2)),
+                      static_cast<unsigned int>(state.range(3))};
+  const std::string &name{files.Get(config)};
+
+  uint64_t xruns{0};
+  for (auto _ : state) {
+    plac::FlowControl flow{};
+    auto audio_buffer{std::make_unique<plac::AudioBuffer<65536>>()};
+    plac::Stream stream{*audio_buffer, flow, plac::Stream::Input::mmap};
+    if (!stream.Reset(name.c_str())) {
+      state.SkipWithError("cannot open file");
+      break;
+    }
+    Output output{*audio_buffer, flow, stream.format_, static_cast<double>(state.range(4))};
+    stream.Decode();
+    flow.Close();
+    output.Join();
+    xruns += output.device_.xruns_;
+  }
+
+  state.counters["xruns"] = static_cast<double>(xruns);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * kSeconds * config.rate * 2);
+}
+
+// ParallelDecoder of a whole file from the page cache, the PCM is discarded.
+// args: bits per sample, sample rate, threads
+void ParallelDecode(benchmark::State &state) {
+  const Config config{static_cast<unsigned int>(state.range(0)),
+                      static_cast<unsigned int>(state.range(1)), 4096, 5};
+  const std::string &name{files.Get(config)};
+
+  plac::ParallelDecoder decoder{static_cast<unsigned int>(state.range(2))};
+  for (auto _ : state) {
+    if (!decoder.Decode(name.c_str(),
+                        [](const plac::AudioFormat, std::span<const u_char> data) {
+                          benchmark::DoNotOptimize(data.data());
+                          return true;
+                        })) {
+      state.SkipWithError("cannot decode file");
+      break;
+    }
+  }
+
+  state.counters["chunks"] = static_cast<double>(decoder.stats_.chunks_);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * kSeconds * config.rate * 2);
+}
+
+BENCHMARK(Decode)
+    ->ArgNames({"bits", "rate", "blocksize", "level", "engine"})
+    ->ArgsProduct({{16, 24}, {44100, 96000, 192000}, {1152, 4096}, {0, 5, 8}, {0, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(Pipeline)
+    ->ArgNames({"bits", "rate", "blocksize", "level", "speed"})
+    ->Args({16, 44100, 4096, 5, 20})
+    ->Args({24, 192000, 4096, 5, 5})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(ParallelDecode)
+    ->ArgNames({"bits", "rate", "threads"})
+    ->ArgsProduct({{16, 24}, {44100, 192000}, {1, 2, 4, 8}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: MIT
+
+#include "uring_reader.h"
+#include "conditions.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define PLAC_IO_URING
+#endif
+
+namespace plac {
+
+namespace {
+
+#ifdef PLAC_IO_URING
+
+int Setup(const unsigned int entries, io_uring_params *params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int Enter(const int fd, const unsigned int submit, const unsigned int min_complete,
+          const unsigned int flags) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_enter, fd, submit, min_complete, flags, nullptr, 0));
+}
+
+void *MapRing(const int fd, const size_t size, const off_t offset) {
+  void *ring{::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset)};
+  return (ring == MAP_FAILED) ? nullptr : ring;
+}
+
+template <typename T> T *At(void *base, const size_t offset) {
+  return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+}
+
+#endif
+
+} // namespace
+
+UringReader::~UringReader() noexcept {
+  if (!IsValid()) {
+    return;
+  }
+  Drain();
+  if ((cq_ring_ != nullptr) && (cq_ring_ != sq_ring_)) {
+    ::munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != nullptr) {
+    ::munmap(sq_ring_, sq_ring_size_);
+  }
+  if (sqes_ != nullptr) {
+    ::munmap(sqes_, sqes_size_);
+  }
+  EXPECTS(::close(ring_fd_) == 0, "cannot close io_uring");
+}
+
+bool UringReader::Init(const size_t depth, const size_t block_size) {
+  EXPECTS(!IsValid() && (depth > 0) && (block_size > 0), "invalid io_uring setup");
+#ifdef PLAC_IO_URING
+  io_uring_params params{};
+  const int fd{Setup(static_cast<unsigned int>(depth), &params)};
+  if (fd < 0) {
+    LOG_ERROR("io_uring is not available: {}", ::strerror(errno));
+    return false;
+  }
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = MapRing(fd, sq_ring_size_, IORING_OFF_SQ_RING);
+  cq_ring_ = ((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+                 ? sq_ring_
+                 : MapRing(fd, cq_ring_size_, IORING_OFF_CQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = MapRing(fd, sqes_size_, IORING_OFF_SQES);
+  // the destructor unmaps what was mapped
+  ring_fd_ = fd;
+  if ((sq_ring_ == nullptr) || (cq_ring_ == nullptr) || (sqes_ == nullptr)) {
+    LOG_ERROR("cannot map io_uring: {}", ::strerror(errno));
+    return false;
+  }
+  sq_tail_ = At<unsigned int>(sq_ring_, params.sq_off.tail);
+  sq_mask_ = At<unsigned int>(sq_ring_, params.sq_off.ring_mask);
+  sq_array_ = At<unsigned int>(sq_ring_, params.sq_off.array);
+  cq_head_ = At<unsigned int>(cq_ring_, params.cq_off.head);
+  cq_tail_ = At<unsigned int>(cq_ring_, params.cq_off.tail);
+  cq_mask_ = At<unsigned int>(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = At<void>(cq_ring_, params.cq_off.cqes);
+
+  blocks_.resize(depth);
+  for (Block &block : blocks_) {
+    block.data_.resize(block_size);
+    block.iov_ = iovec{block.data_.data(), block.data_.size()};
+  }
+  return true;
+#else
+  LOG_ERROR("io_uring is not available: built without <linux/io_uring.h>");
+  return false;
+#endif
+}
+
+void UringReader::Open(const int fd, const uint64_t size) {
+  Drain();
+  fd_ = fd;
+  size_ = size;
+  // the head block is stale
+  blocks_[head_].result_ = 0;
+  Seek(0);
+}
+
+ssize_t UringReader::Read(u_char *buffer, const size_t bytes) {
+  if ((position_ >= size_) || (bytes == 0)) {
+    return 0;
+  }
+  Block &block{blocks_[head_]};
+  if (block.pending_) {
+    Reap(0);
+  }
+  if (block.pending_) {
+    const auto start{std::chrono::steady_clock::now()};
+    while (block.pending_) {
+      if (!Reap(1)) {
+        return -1;
+      }
+    }
+    if (metrics_ != nullptr) {
+      metrics_->read_stalls_.fetch_add(1, std::memory_order_relaxed);
+      const std::chrono::nanoseconds stalled{std::chrono::steady_clock::now() - start};
+      metrics_->read_stall_ns_.fetch_add(static_cast<uint64_t>(stalled.count()),
+                                         std::memory_order_relaxed);
+    }
+  }
+  if (block.result_ < 0) {
+    errno = -block.result_;
+    return -1;
+  }
+  // a file which grew is read up to the size it had when it was opened
+  const size_t available{static_cast<size_t>(std::min<uint64_t>(
+      static_cast<size_t>(block.result_) - consumed_, size_ - position_))};
+  if (available == 0) {
+    // the file is shorter than it was when it was opened
+    return 0;
+  }
+
+  const size_t n{std::min(bytes, available)};
+  std::memcpy(buffer, block.data_.data() + consumed_, n);
+  consumed_ += n;
+  position_ += n;
+  if (consumed_ == static_cast<size_t>(block.result_)) {
+    if ((consumed_ < block.data_.size()) && (position_ < size_)) {
+      // a short read before the end of the file, the blocks ahead are misaligned
+      Seek(position_);
+      return static_cast<ssize_t>(n);
+    }
+    Submit(block, next_offset_);
+    next_offset_ += block.data_.size();
+    head_ = (head_ + 1) % blocks_.size();
+    consumed_ = 0;
+    if (metrics_ != nullptr) {
+      Reap(0);
+      metrics_->readahead_blocks_.Add(static_cast<uint64_t>(
+          std::count_if(blocks_.begin(), blocks_.end(), [](const Block &b) {
+            return !b.pending_ && (b.result_ > 0);
+          })));
+    }
+  }
+  return static_cast<ssize_t>(n);
+}
+
+bool UringReader::Seek(const uint64_t offset) {
+  if (offset > size_) {
+    return false;
+  }
+  // libFLAC seeks back and forth within a few bytes while it searches frames
+  if (const Block &block{blocks_[head_]};
+      !block.pending_ && (block.result_ > 0) && (offset >= block.offset_)
+      && (offset < block.offset_ + static_cast<uint64_t>(block.result_))) {
+    consumed_ = static_cast<size_t>(offset - block.offset_);
+    position_ = offset;
+    return true;
+  }
+  Drain();
+  position_ = offset;
+  head_ = 0;
+  consumed_ = 0;
+  next_offset_ = offset;
+  for (Block &block : blocks_) {
+    Submit(block, next_offset_);
+    next_offset_ += block.data_.size();
+  }
+  return true;
+}
+
+void UringReader::Submit(Block &block, const uint64_t offset) {
+  block.offset_ = offset;
+  block.result_ = 0;
+  if (offset >= size_) {
+    return;
+  }
+#ifdef PLAC_IO_URING
+  // single producer, the kernel only reads the tail
+  const unsigned int tail{*sq_tail_};
+  const unsigned int index{tail & *sq_mask_};
+  io_uring_sqe *const sqe{static_cast<io_uring_sqe *>(sqes_) + index};
+  std::memset(sqe, 0, sizeof(*sqe));
+  // READV instead of READ works on every kernel with io_uring
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = fd_;
+  sqe->addr = reinterpret_cast<uint64_t>(&block.iov_);
+  sqe->len = 1;
+  sqe->off = offset;
+  sqe->user_data = static_cast<uint64_t>(&block - blocks_.data());
+  sq_array_[index] = index;
+  std::atomic_ref<unsigned int>{*sq_tail_}.store(tail + 1, std::memory_order_release);
+  int submitted{};
+  do {
+    submitted = Enter(ring_fd_, 1, 0, 0);
+  } while ((submitted < 0) && (errno == EINTR));
+  EXPECTS(submitted == 1, "cannot submit a read to io_uring: {}", ::strerror(errno));
+  block.pending_ = true;
+  ++in_flight_;
+#endif
+}
+
+bool UringReader::Reap(const unsigned int min) {
+#ifdef PLAC_IO_URING
+  if ((min != 0) && (Enter(ring_fd_, 0, min, IORING_ENTER_GETEVENTS) < 0) && (errno != EINTR)) {
+    LOG_ERROR("cannot wait for io_uring: {}", ::strerror(errno));
+    return false;
+  }
+  // single consumer, the kernel only reads the head
+  unsigned int head{*cq_head_};
+  const unsigned int tail{std::atomic_ref<unsigned int>{*cq_tail_}.load(std::memory_order_acquire)};
+  for (; head != tail; ++head) {
+    const io_uring_cqe &cqe{static_cast<const io_uring_cqe *>(cqes_)[head & *cq_mask_]};
+    Block &block{blocks_[cqe.user_data]};
+    block.result_ = cqe.res;
+    block.pending_ = false;
+    --in_flight_;
+  }
+  std::atomic_ref<unsigned int>{*cq_head_}.store(head, std::memory_order_release);
+  return true;
+#else
+  static_cast<void>(min);
+  return false;
+#endif
+}
+
+void UringReader::Drain() {
+  while (in_flight_ != 0) {
+    // the kernel writes into the blocks until the reads complete
+    EXPECTS(Reap(1), "cannot complete io_uring reads");
+  }
+}
+
+} // namespace plac
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef URING_READER_H
+#define URING_READER_H
+
+#include "metrics.h"
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+namespace plac {
+
+// Sequential reads of a file through io_uring, several blocks ahead of the
+// consumer.
+//
+// Every block of the ring has a read in flight or holds completed data. Read()
+// copies from the oldest block and, once it is used up, submits it again for
+// the block after the newest one. It only waits if the oldest block is still
+// in flight, which is counted as a stall. Seek() waits for all reads in flight
+// and starts over at the new offset.
+//
+// The ring is set up with raw system calls, liburing is not needed. Init()
+// fails on kernels without io_uring, or if it is disabled or filtered by
+// seccomp, and the caller falls back to read(2).
+class UringReader {
+public:
+  static constexpr size_t kDepth{4};
+  static constexpr size_t kBlockSize{256U << 10U};
+
+  UringReader() = default;
+  UringReader(const UringReader &) = delete;
+  UringReader(UringReader &&) = delete;
+  UringReader &operator=(const UringReader &) = delete;
+  UringReader &operator=(UringReader &&) = delete;
+  ~UringReader() noexcept;
+
+  // false if io_uring is not available
+  bool Init(size_t depth = kDepth, size_t block_size = kBlockSize);
+  bool IsValid() const { return ring_fd_ >= 0; }
+
+  // starts reading fd of size bytes from offset 0. fd stays open until the
+  // next Open() or the destruction of the reader
+  void Open(int fd, uint64_t size);
+  // like read(2), -1 with errno set on failure
+  ssize_t Read(u_char *buffer, size_t bytes);
+  bool Seek(uint64_t offset);
+  uint64_t Tell() const { return position_; }
+
+  // optional. stalls and the readahead depth
+  PlaybackMetrics *metrics_{nullptr};
+
+private:
+  struct Block {
+    std::vector<u_char> data_;
+    iovec iov_{};
+    uint64_t offset_{0};
+    // bytes read, or -errno
+    int result_{0};
+    bool pending_{false};
+  };
+
+  // submits a read of block at offset, unless offset is at the end of the file
+  void Submit(Block &block, uint64_t offset);
+  // completions which are ready. waits for at least min of them
+  bool Reap(unsigned int min);
+  // waits for all reads in flight
+  void Drain();
+
+  int ring_fd_{-1};
+  void *sq_ring_{nullptr};
+  size_t sq_ring_size_{0};
+  void *cq_ring_{nullptr};
+  size_t cq_ring_size_{0};
+  void *sqes_{nullptr};
+  size_t sqes_size_{0};
+  // pointers into the rings shared with the kernel
+  unsigned int *sq_tail_{nullptr};
+  unsigned int *sq_mask_{nullptr};
+  unsigned int *sq_array_{nullptr};
+  unsigned int *cq_head_{nullptr};
+  unsigned int *cq_tail_{nullptr};
+  unsigned int *cq_mask_{nullptr};
+  void *cqes_{nullptr};
+
+  std::vector<Block> blocks_{};
+  size_t in_flight_{0};
+  int fd_{-1};
+  uint64_t size_{0};
+  // of the consumer
+  uint64_t position_{0};
+  // block which Read() consumes, and the bytes of it which were consumed
+  size_t head_{0};
+  size_t consumed_{0};
+  // offset of the next block to submit
+  uint64_t next_offset_{0};
+};
+
+} // namespace plac
+
+#endif
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: MIT
+
+#include "file_desc.h"
+#include "uring_reader.h"
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace plac {
+namespace {
+
+class UringReaderTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    content_.resize(100'000);
+    for (size_t i{0}; i < content_.size(); ++i) {
+      content_[i] = static_cast<u_char>((i * 7919U) >> 5U);
+    }
+    std::ofstream{kName, std::ios::binary}.write(reinterpret_cast<const char *>(content_.data()),
+                                                 static_cast<std::streamsize>(content_.size()));
+    desc_ = FileDesc{kName};
+    // small blocks so that the ring wraps many times
+    if (!reader_.Init(3, 4096)) {
+      GTEST_SKIP() << "io_uring is not available";
+    }
+    reader_.metrics_ = &metrics_;
+    reader_.Open(desc_.fd_, content_.size());
+  }
+  void TearDown() override { std::remove(kName); }
+
+  // reads up to bytes in chunks of chunk
+  std::vector<u_char> ReadAll(const size_t chunk) {
+    std::vector<u_char> data{};
+    std::vector<u_char> buffer(chunk);
+    while (true) {
+      const ssize_t n{reader_.Read(buffer.data(), buffer.size())};
+      EXPECT_GE(n, 0);
+      if (n <= 0) {
+        return data;
+      }
+      data.insert(data.end(), buffer.begin(), buffer.begin() + n);
+    }
+  }
+
+  static constexpr const char *kName{"uring_reader_unit_test.bin"};
+  std::vector<u_char> content_{};
+  FileDesc desc_{};
+  PlaybackMetrics metrics_{};
+  UringReader reader_{};
+};
+
+TEST_F(UringReaderTest, Read) {
+  EXPECT_EQ(content_, ReadAll(1000));
+  EXPECT_EQ(content_.size(), reader_.Tell());
+  EXPECT_GT(metrics_.readahead_blocks_.count_.load(), 20);
+}
+
+TEST_F(UringReaderTest, Seek) {
+  std::vector<u_char> buffer(10);
+  ASSERT_TRUE(reader_.Seek(50'000));
+  EXPECT_EQ(10, reader_.Read(buffer.data(), buffer.size()));
+  EXPECT_TRUE(std::equal(buffer.begin(), buffer.end(), &content_[50'000]));
+
+  // within the current block
+  ASSERT_TRUE(reader_.Seek(50'003));
+  EXPECT_EQ(50'003, reader_.Tell());
+  EXPECT_EQ(10, reader_.Read(buffer.data(), buffer.size()));
+  EXPECT_TRUE(std::equal(buffer.begin(), buffer.end(), &content_[50'003]));
+
+  ASSERT_TRUE(reader_.Seek(5));
+  const std::vector<u_char> rest{ReadAll(4096)};
+  EXPECT_TRUE(std::equal(rest.begin(), rest.end(), content_.begin() + 5, content_.end()));
+  EXPECT_EQ(content_.size() - 5, rest.size());
+
+  EXPECT_TRUE(reader_.Seek(content_.size()));
+  EXPECT_EQ(0, reader_.Read(buffer.data(), buffer.size()));
+  EXPECT_FALSE(reader_.Seek(content_.size() + 1));
+}
+
+TEST_F(UringReaderTest, Reopen) {
+  std::vector<u_char> buffer(10);
+  EXPECT_EQ(10, reader_.Read(buffer.data(), buffer.size()));
+  reader_.Open(desc_.fd_, 20);
+  EXPECT_EQ(std::vector<u_char>(content_.begin(), content_.begin() + 20), ReadAll(7));
+}
+
+} // namespace
+} // namespace plac
@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: MIT
+
+#include "verifier.h"
+#include "conditions.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+namespace plac {
+
+namespace {
+
+// hashes what the stream commits until it is closed and drained
+void Hash(AudioBuffer<65536> &audio_buffer, FlowControl &flow, const AudioFormat format,
+          Md5 &md5, uint64_t &samples) {
+  while (true) {
+    const unsigned int sequence{flow.Sequence()};
+    const bool closed{flow.IsClosed()};
+    const uint64_t before{samples};
+    audio_buffer.Drain(format, [&md5, &samples](const AudioFormat f, const u_char *const data,
+                                                const size_t count) {
+      md5.Update({data, AsBytes(f, count)});
+      samples += count;
+      return static_cast<ssize_t>(count);
+    });
+    if (closed) {
+      return;
+    }
+    // only progress is notified, a notification of our own would wake us right away
+    if (samples != before) {
+      flow.Notify();
+    } else {
+      flow.Wait(sequence);
+    }
+  }
+}
+
+// drains the AudioBuffer of one worker into the MD5 of the file it decodes.
+// the thread lives as long as the worker and hashes every file of it
+class Hasher {
+public:
+  explicit Hasher(AudioBuffer<65536> &audio_buffer)
+      : audio_buffer_{audio_buffer}, thread_{[this]() { Run(); }} {}
+  Hasher(const Hasher &) = delete;
+  Hasher(Hasher &&) = delete;
+  Hasher &operator=(const Hasher &) = delete;
+  Hasher &operator=(Hasher &&) = delete;
+  ~Hasher() noexcept {
+    {
+      std::lock_guard lock{mutex_};
+      stopped_ = true;
+    }
+    changed_.notify_one();
+    thread_.join();
+  }
+
+  // hashes what a stream commits until flow is closed
+  void Start(FlowControl &flow, const AudioFormat format) {
+    {
+      std::lock_guard lock{mutex_};
+      md5_.Reset();
+      samples_ = 0;
+      job_ = Job{&flow, format};
+    }
+    changed_.notify_one();
+  }
+
+  // waits until the buffer is drained after flow was closed
+  void Finish(Md5::Digest &md5, uint64_t &samples) {
+    std::unique_lock lock{mutex_};
+    done_.wait(lock, [this]() { return !job_; });
+    md5 = md5_.Final();
+    samples = samples_;
+  }
+
+  AudioBuffer<65536> &audio_buffer_;
+
+private:
+  struct Job {
+    FlowControl *flow_;
+    AudioFormat format_;
+  };
+
+  void Run() {
+    std::unique_lock lock{mutex_};
+    while (true) {
+      changed_.wait(lock, [this]() { return stopped_ || job_; });
+      if (stopped_) {
+        return;
+      }
+      const Job job{*job_};
+      // md5_ and samples_ are only touched by Start() and Finish() while no job runs
+      lock.unlock();
+      Hash(audio_buffer_, *job.flow_, job.format_, md5_, samples_);
+      lock.lock();
+      job_.reset();
+      done_.notify_one();
+    }
+  }
+
+  std::mutex mutex_{};
+  std::condition_variable changed_{};
+  std::condition_variable done_{};
+  std::optional<Job> job_{};
+  bool stopped_{false};
+  Md5 md5_{};
+  uint64_t samples_{0};
+  std::thread thread_;
+};
+
+// io limits the threads which open and prefault a file. nullptr for no limit
+VerifyResult VerifyFile(const std::string &name, const Stream::Engine engine, Hasher &hasher,
+                        std::counting_semaphore<> *const io) {
+  VerifyResult result{name, VerifyResult::Status::ok, 0, 0, {}};
+  FlowControl flow{};
+  Stream stream{hasher.audio_buffer_, flow, Stream::Input::mmap, Stream::kDefaultMemoryLimit,
+                engine};
+  if (io != nullptr) {
+    io->acquire();
+  }
+  const bool opened{stream.Reset(name.c_str())};
+  if (io != nullptr) {
+    io->release();
+  }
+  if (!opened) {
+    result.status_ = VerifyResult::Status::unreadable;
+    return result;
+  }
+  if (stream.write_ == nullptr) {
+    result.status_ = VerifyResult::Status::unsupported;
+    return result;
+  }
+
+  hasher.Start(flow, stream.format_);
+  const bool decoded{stream.Decode()};
+  flow.Close();
+  hasher.Finish(result.md5_, result.samples_);
+  result.frame_errors_ = stream.errors_;
+
+  if (!decoded) {
+    result.status_ = VerifyResult::Status::decode_failed;
+  } else if (result.frame_errors_ != 0) {
+    result.status_ = VerifyResult::Status::frame_errors;
+  } else if ((stream.total_samples_ != 0) && (result.samples_ != stream.total_samples_)) {
+    result.status_ = VerifyResult::Status::truncated;
+  } else if (stream.md5_ == Md5::Digest{}) {
+    result.status_ = VerifyResult::Status::no_md5;
+  } else if (stream.md5_ != result.md5_) {
+    result.status_ = VerifyResult::Status::md5_mismatch;
+  }
+  return result;
+}
+
+} // namespace
+
+std::string FormatVerifyResult(const VerifyResult &result) {
+  std::string md5{};
+  for (const u_char c : result.md5_) {
+    md5 += std::format("{:02x}", c);
+  }
+  return std::format("{} {} {} {} {}\n", VerifyResult::kNames[static_cast<size_t>(result.status_)],
+                     result.samples_, result.frame_errors_, md5, result.name_);
+}
+
+std::optional<VerifyResult> ParseVerifyResult(std::string_view line) {
+  if (line.ends_with('\n')) {
+    line.remove_suffix(1);
+  }
+  // the next field up to a space
+  const auto field{[&line]() {
+    const size_t end{std::min(line.find(' '), line.size())};
+    const std::string_view value{line.substr(0, end)};
+    line.remove_prefix(std::min(end + 1, line.size()));
+    return value;
+  }};
+  const auto number{[](const std::string_view text, auto &value, const int base = 10) {
+    const auto [ptr, ec]{std::from_chars(text.data(), text.data() + text.size(), value, base)};
+    return (ec == std::errc{}) && (ptr == text.data() + text.size()) && !text.empty();
+  }};
+
+  VerifyResult result{};
+  const auto status{
+      std::find(VerifyResult::kNames.begin(), VerifyResult::kNames.end(), field())};
+  if (status == VerifyResult::kNames.end()) {
+    return std::nullopt;
+  }
+  result.status_ = static_cast<VerifyResult::Status>(status - VerifyResult::kNames.begin());
+  if (!number(field(), result.samples_) || !number(field(), result.frame_errors_)) {
+    return std::nullopt;
+  }
+  const std::string_view md5{field()};
+  if (md5.size() != 2 * result.md5_.size()) {
+    return std::nullopt;
+  }
+  for (size_t i{0}; i < result.md5_.size(); ++i) {
+    if (!number(md5.substr(2 * i, 2), result.md5_[i], 16)) {
+      return std::nullopt;
+    }
+  }
+  if (line.empty()) {
+    return std::nullopt;
+  }
+  result.name_ = line;
+  return result;
+}
+
+Verifier::Verifier(unsigned int threads, const unsigned int queue_depth,
+                   const Stream::Engine engine)
+    : threads_{threads}, workers_{1}, queue_depth_{std::max(1U, queue_depth)}, engine_{engine} {
+  if (threads_ == 0) {
+    threads_ = std::max(1U, std::thread::hardware_concurrency());
+  }
+  // a decoding and a hashing thread per file
+  workers_ = std::max(1U, threads_ / 2);
+}
+
+size_t Verifier::Verify(const std::span<const std::string> names, const ReportFn &report) const {
+  std::counting_semaphore<> io{static_cast<std::ptrdiff_t>(queue_depth_)};
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> failed{0};
+  std::mutex mutex{};
+
+  const auto work{[&]() {
+    // the ring of an AudioBuffer and the hasher are set up once per worker
+    auto audio_buffer{std::make_unique<AudioBuffer<65536>>()};
+    Hasher hasher{*audio_buffer};
+    while (true) {
+      const size_t k{next.fetch_add(1, std::memory_order_relaxed)};
+      if (k >= names.size()) {
+        return;
+      }
+      const VerifyResult result{VerifyFile(names[k], engine_, hasher, &io)};
+      if (result.Failed()) {
+        failed.fetch_add(1, std::memory_order_relaxed);
+      }
+      std::lock_guard lock{mutex};
+      report(result);
+    }
+  }};
+  std::vector<std::thread> threads{};
+  const size_t count{std::min<size_t>(workers_, names.size())};
+  for (size_t i{0}; i < count; ++i) {
+    threads.emplace_back(work);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  return failed.load(std::memory_order_relaxed);
+}
+
+VerifyResult Verifier::Verify(const std::string &name) const {
+  auto audio_buffer{std::make_unique<AudioBuffer<65536>>()};
+  Hasher hasher{*audio_buffer};
+  return VerifyFile(name, engine_, hasher, nullptr);
+}
+
+} // namespace plac
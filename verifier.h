@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include "md5.h"
+#include "stream.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace plac {
+
+struct VerifyResult {
+  // in the order of precedence, the first which applies is reported
+  // decode_failed: libFLAC gave up on the rest of the file
+  enum class Status {
+    ok,
+    unreadable,
+    unsupported,
+    decode_failed,
+    frame_errors,
+    truncated,
+    md5_mismatch,
+    no_md5
+  };
+  static constexpr std::array<std::string_view, 8> kNames{
+      "ok",           "unreadable", "unsupported",  "decode_failed",
+      "frame_errors", "truncated",  "md5_mismatch", "no_md5"};
+
+  // a missing MD5 only means that the samples could not be checked
+  bool Failed() const { return (status_ != Status::ok) && (status_ != Status::no_md5); }
+
+  std::string name_;
+  Status status_;
+  // decoded samples per channel
+  uint64_t samples_;
+  // corrupt frames and lost syncs, see Stream::errors_
+  size_t frame_errors_;
+  // of the decoded samples
+  Md5::Digest md5_;
+};
+
+// one line per file: <status> <samples> <frame errors> <md5> <name>, with the
+// name last so that it may contain spaces
+std::string FormatVerifyResult(const VerifyResult &result);
+std::optional<VerifyResult> ParseVerifyResult(std::string_view line);
+
+// Decodes files with Stream on a pool of threads and checks the MD5 of
+// STREAMINFO as well as the CRCs of the frames, the job of `flac -t`.
+//
+// Each worker decodes one file at a time into an AudioBuffer of its own,
+// which the hashing thread of the worker drains into the MD5. Both threads
+// live as long as the worker. Reset() maps the file and prefaults files up to
+// MappedFile::kPopulateLimit, which is where the storage is read. At most
+// queue_depth workers do so at a time, the others decode files which are
+// already in memory.
+class Verifier {
+public:
+  static constexpr unsigned int kQueueDepth{4};
+
+  // called from the worker threads, one result at a time
+  using ReportFn = std::function<void(const VerifyResult &result)>;
+
+  // threads counts the decoding and the hashing threads, i.e. threads / 2
+  // files are verified at a time, at least one. 0 means one per core
+  explicit Verifier(unsigned int threads = 0, unsigned int queue_depth = kQueueDepth,
+                    Stream::Engine engine = Stream::Engine::native);
+
+  // reports the files in the order they complete. returns the number which
+  // failed
+  size_t Verify(std::span<const std::string> names, const ReportFn &report) const;
+  // a single file on the calling thread
+  VerifyResult Verify(const std::string &name) const;
+
+  unsigned int Threads() const { return threads_; }
+
+private:
+  unsigned int threads_;
+  unsigned int workers_;
+  unsigned int queue_depth_;
+  Stream::Engine engine_;
+};
+
+} // namespace plac
+
+#endif